@@ -25,6 +25,10 @@
 
 /* if you change anything in the enum {} below you have to increase
    this HOSTFS_NFAPI_VERSION!
+
+   Exception: calls appended at the end that the drivers probe for
+   (older hosts answer them with EINVFN) keep the version, so that
+   drivers already installed keep working.
 */
 #define HOSTFS_NFAPI_VERSION    04
 
@@ -42,7 +46,11 @@ enum {
 	DEV_OPEN, DEV_WRITE, DEV_READ, DEV_LSEEK, DEV_IOCTL, DEV_DATIME,
 	DEV_CLOSE, DEV_SELECT, DEV_UNSELECT,
 	/* new from 0.04 */
-	XFS_STAT64
+	XFS_STAT64,
+	/* optional, probed for */
+	XFS_READDIRX,
+	DEV_WRITE_ASYNC,	/* like DEV_WRITE, returns a NF_ASYNC ticket */
+	DEV_READ_ASYNC		/* like DEV_READ, returns a NF_ASYNC ticket */
 };
 
 extern unsigned long nf_hostfs_id;
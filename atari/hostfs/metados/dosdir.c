@@ -19,6 +19,7 @@
 /* DOS directory functions */
 
 #include "hostfs.h"
+#include "hostfs/hostfs_xfs.h"
 #include "mint/errno.h"
 #include "mint/ctype.h"
 #include "mint/assert.h"
@@ -532,7 +533,14 @@ sys_f_snext (MetaDOSDTA0)
 	 */
 	for(;;)
 	{
-		r = xfs_readdir (fs, dirh, buf, TOS_NAMELEN+1, &fc);
+		long xr;
+		int have_fc;
+
+		/* name and attributes in one go, no cookie */
+		r = hostfs_xreaddir (dirh, buf, TOS_NAMELEN+1, &xattr, &xr);
+		have_fc = (r == ENOSYS);
+		if (have_fc)
+			r = xfs_readdir (fs, dirh, buf, TOS_NAMELEN+1, &fc);
 
 		if (r == EBADARG)
 		{
@@ -556,16 +564,18 @@ baderror:
 
 		if (!pat_match (buf, dta->dta_pat))
 		{
-			release_cookie (&fc);
+			if (have_fc)
+				release_cookie (&fc);
 			continue;	/* different patterns */
 		}
 
 		/* check for search attributes */
-		r = xfs_getxattr (fc.fs, &fc, &xattr);
+		r = have_fc ? xfs_getxattr (fc.fs, &fc, &xattr) : xr;
 		if (r)
 		{
 			DEBUG(("Fsnext: couldn't get file attributes"));
-			release_cookie (&fc);
+			if (have_fc)
+				release_cookie (&fc);
 			goto baderror;
 		}
 
@@ -573,8 +583,13 @@ baderror:
 		if (S_ISLNK(xattr.mode))
 		{
 			char linkedto[PATH_MAX];
-			r = xfs_readlink (fc.fs, &fc, linkedto, PATH_MAX);
-			release_cookie (&fc);
+			if (!have_fc)
+				r = xfs_lookup (fs, &dirh->fc, buf, &fc);
+			if (r == E_OK)
+			{
+				r = xfs_readlink (fc.fs, &fc, linkedto, PATH_MAX);
+				release_cookie (&fc);
+			}
 			if (r == E_OK)
 			{
 				/* the "1" tells relpath2cookie that we read a link */
@@ -589,7 +604,7 @@ baderror:
 			if (r)
 				DEBUG(("Fsnext: couldn't follow link: error %ld", r));
 		}
-		else
+		else if (have_fc)
 			release_cookie (&fc);
 
 		/* silly TOS rules for matching attributes */
@@ -1005,19 +1020,26 @@ sys_d_xreaddir (MetaDOSDir int len, long handle, char *buf, XATTR *xattr, long *
 	if (!dirh->fc.fs)
 		return EBADF;
 
-	r = xfs_readdir (dirh->fc.fs, dirh, buf, len, &fc);
-	if (r != E_OK)
+	r = hostfs_xreaddir (dirh, buf, len, xattr, xret);
+	if (r == ENOSYS)
+	{
+		r = xfs_readdir (dirh->fc.fs, dirh, buf, len, &fc);
+		if (r != E_OK)
+			return r;
+
+		*xret = xfs_getxattr (fc.fs, &fc, xattr);
+		release_cookie (&fc);
+	}
+	else if (r != E_OK)
 		return r;
 
-	*xret = xfs_getxattr (fc.fs, &fc, xattr);
-	if ((*xret == E_OK) && (fc.fs->fsflags & FS_EXT_3))
+	if ((*xret == E_OK) && (dirh->fc.fs->fsflags & FS_EXT_3))
 	{
 		xtime_to_local_dos(xattr, m);
 		xtime_to_local_dos(xattr, a);
 		xtime_to_local_dos(xattr, c);
 	}
 
-	release_cookie (&fc);
 	return r;
 }
 
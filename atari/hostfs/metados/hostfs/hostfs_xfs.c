@@ -33,10 +33,114 @@
 
 #include "nf_ops.h"
 
+#include "mint/string.h"
+
 
 unsigned long nf_hostfs_id = 0;
 
 
+/*
+ * Dxreaddir() and Fsnext() read an entry and then its attributes,
+ * which costs two NatFeat calls per entry. XFS_READDIRX delivers both
+ * for a whole bufferful of entries at once. The records are kept here
+ * for one directory at a time.
+ */
+#define XBUF_SIZE	4096
+#define XREC_XATTR	8		/* offset of the XATTR in a record */
+#define XREC_NAME	(XREC_XATTR + 52)	/* offset of the name */
+
+static long xbuf_space[XBUF_SIZE / sizeof(long)];	/* word aligned */
+#define xbuf	((char *)xbuf_space)
+static DIR *xbuf_dir;		/* directory the records belong to */
+static short xbuf_pos;		/* offset of the next record */
+static short xbuf_left;		/* number of records not yet consumed */
+static int have_readdirx = 1;
+
+/* forget the records of dirh, e.g. when it is rewound or closed */
+static void
+xbuf_drop (DIR *dirh)
+{
+	if (xbuf_dir == dirh)
+	{
+		xbuf_dir = NULL;
+		xbuf_left = 0;
+	}
+}
+
+/* give the records not yet consumed back to the host */
+static void
+xbuf_release (void)
+{
+	if (xbuf_dir && xbuf_left)
+		nf_call(HOSTFS(XFS_READDIRX), xbuf_dir, xbuf, 0L,
+				(long)(xbuf_dir->index - xbuf_left), 0L);
+	xbuf_dir = NULL;
+	xbuf_left = 0;
+}
+
+/*
+ * Dreaddir() and Fxattr() (not following links) in one go. Like
+ * Dxreaddir() the return value is the one of the readdir, the one of
+ * the getxattr is stored in *xret. Returns ENOSYS when the host does
+ * not provide XFS_READDIRX; the caller then does it the slow way.
+ */
+long
+hostfs_xreaddir (DIR *dirh, char *name, int namelen, XATTR *xattr, long *xret)
+{
+	char *rec;
+	char *nm;
+	long r;
+
+	if (!have_readdirx || dirh->fc.fs != &hostfs_filesys)
+		return ENOSYS;
+
+	if (xbuf_dir != dirh || !xbuf_left)
+	{
+		xbuf_release ();
+
+		r = nf_call(HOSTFS(XFS_READDIRX), dirh, xbuf, (long)XBUF_SIZE, -1L, 0L);
+		if (r == ENOSYS)
+		{
+			have_readdirx = 0;
+			return ENOSYS;
+		}
+		if (r <= 0)
+			return r ? r : ENMFILES;
+
+		xbuf_dir = dirh;
+		xbuf_pos = 0;
+		xbuf_left = r;
+	}
+
+	rec = xbuf + xbuf_pos;
+	xbuf_pos += *(unsigned short *)rec;
+	xbuf_left--;
+
+	*xret = *(long *)(rec + 4);
+	if (*xret == E_OK)
+		memcpy (xattr, rec + XREC_XATTR, sizeof (*xattr));
+
+	/* the same limits and truncation as XFS_READDIR */
+	nm = rec + XREC_NAME;
+	if (dirh->flags == 0)
+	{
+		if (namelen < strlen (nm + 4) + 4)
+			return EBADARG;
+		memcpy (name, nm, 4);
+		name += 4;
+		nm += 4;
+		namelen -= 4;
+	}
+	else if (namelen < strlen (nm))
+		return EBADARG;
+
+	strncpy (name, nm, namelen - 1);
+	name[namelen - 1] = '\0';
+
+	return E_OK;
+}
+
+
 ulong    _cdecl fs_drive_bits(void)
 {
 	return nf_call(HOSTFS(GET_DRIVE_BITS));
@@ -134,6 +238,7 @@ long     _cdecl hostfs_fs_rename     (fcookie *olddir, char *oldname,
 static
 long     _cdecl hostfs_fs_opendir    (DIR *dirh, int tosflag)
 {
+	xbuf_drop(dirh);
 	return nf_call(HOSTFS(XFS_OPENDIR), dirh, (long)tosflag);
 }
 
@@ -141,18 +246,22 @@ static
 long     _cdecl hostfs_fs_readdir    (DIR *dirh, char *name, int namelen,
 								   fcookie *fc)
 {
+	if (xbuf_dir == dirh)
+		xbuf_release();
 	return nf_call(HOSTFS(XFS_READDIR), dirh, name, (long)namelen, fc);
 }
 
 static
 long     _cdecl hostfs_fs_rewinddir  (DIR *dirh)
 {
+	xbuf_drop(dirh);
 	return nf_call(HOSTFS(XFS_REWINDDIR), dirh);
 }
 
 static
 long     _cdecl hostfs_fs_closedir   (DIR *dirh)
 {
+	xbuf_drop(dirh);
 	return nf_call(HOSTFS(XFS_CLOSEDIR), dirh);
 }
 
@@ -35,5 +35,8 @@ extern long     fs_native_init(int fs_devnum, char *mountpoint, char *hostroot,
 extern FILESYS hostfs_filesys;
 extern FILESYS *hostfs_init(void);
 
+extern long     hostfs_xreaddir(DIR *dirh, char *name, int namelen,
+				XATTR *xattr, long *xret);
+
 #endif /* _hostfs_xfs_h_ */
 
@@ -0,0 +1,55 @@
+/*
+ * ARAnyM asynchronous NatFeat jobs - header file.
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NF_ASYNC_NFAPI_H
+#define _NF_ASYNC_NFAPI_H
+
+/*
+   The asynchronous variants of other NatFeat calls (e.g. DEV_READ_ASYNC
+   of HOSTFS) return a ticket > 0 right away, or a negative error code.
+   TOS_ENOSYS means that the request can't be done asynchronously, and
+   the caller should use the synchronous call instead.
+
+   Once the job is done the host raises an interrupt at ASYNC_INTLEVEL,
+   if enabled with ASYNC_IRQ. The handler asks for the finished tickets
+   with ASYNC_COMPLETED and collects the results with ASYNC_POLL. Each
+   ticket has to be collected exactly once, either with ASYNC_POLL
+   returning 1 or with ASYNC_WAIT.
+
+   if you change anything in the enum {} below you have to increase
+   this NF_ASYNC_NFAPI_VERSION!
+*/
+#define NF_ASYNC_NFAPI_VERSION	0x00000001
+
+enum {
+	GET_VERSION = 0,	/* no parameters, return NFAPI_VERSION in d0 */
+	ASYNC_INTLEVEL,		/* no parameters, return Interrupt Level in d0 */
+	ASYNC_IRQ,			/* (enable), enable/disable the completion interrupt */
+	ASYNC_POLL,			/* (ticket, long *result), return 1 and the result when done, 0 if pending */
+	ASYNC_WAIT,			/* (ticket), wait for the job, return its result */
+	ASYNC_COMPLETED		/* no parameters, return a done ticket not returned before, or 0 */
+};
+
+#define NFASYNC(a)	(nfAsyncID + a)
+
+#endif /* _NF_ASYNC_NFAPI_H */
@@ -0,0 +1,54 @@
+/*
+ * ARAnyM bulk memory NatFeat - header file.
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NF_MEM_NFAPI_H
+#define _NF_MEM_NFAPI_H
+
+/*
+   All addresses are physical. The calls return 0 (E_OK), or TOS_EIMBA
+   if a range is not plain RAM (or not writable), and TOS_EINVAL for
+   byte swapping copies with a length that is not a multiple of the
+   element size or with partially overlapping ranges. MEM_CMP returns
+   -1, 0 or 1 like memcmp() on unsigned bytes, or one of these errors.
+
+   MEM_COPY may be given overlapping ranges as well, it then behaves
+   like MEM_MOVE.
+
+   if you change anything in the enum {} below you have to increase
+   this NF_MEM_NFAPI_VERSION!
+*/
+#define NF_MEM_NFAPI_VERSION	0x00000001
+
+enum {
+	GET_VERSION = 0,	/* no parameters, return NFAPI_VERSION in d0 */
+	MEM_COPY,			/* (dst, src, len) */
+	MEM_MOVE,			/* (dst, src, len) */
+	MEM_SET,			/* (dst, byte, len) */
+	MEM_CMP,			/* (a, b, len) */
+	MEM_COPY_SWAP16,	/* (dst, src, len), swapping the bytes of each word */
+	MEM_COPY_SWAP32		/* (dst, src, len), swapping the bytes of each long */
+};
+
+#define NFMEM(a)	(nfMemID + a)
+
+#endif /* _NF_MEM_NFAPI_H */
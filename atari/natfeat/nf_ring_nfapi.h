@@ -0,0 +1,71 @@
+/*
+ * ARAnyM shared memory ring NatFeat - header file.
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NF_RING_NFAPI_H
+#define _NF_RING_NFAPI_H
+
+/*
+   A ring is a block of guest RAM, longword aligned, that the guest
+   writes to and a host thread drains to a Unix domain socket named
+   after the ring, in the directory set by RingDir in [NATFEATS].
+   A host tool connects to the socket and reads the byte stream; as
+   long as no tool is connected the data stays in the ring.
+
+   The guest fills in size (a power of two, 256 bytes to 16 MB) and
+   zeroes head and tail before RING_OPEN. To write n bytes it checks
+   that size - (head - tail) >= n, copies them to
+   data[(head + i) & (size - 1)], and then advances head by n. Only
+   the host writes tail. If tail was equal to the old head, that is
+   the ring was empty, it calls RING_NOTIFY; otherwise the host is
+   still busy with the ring and picks the new data up by itself.
+
+   The calls are for the supervisor only, as the ring address is a
+   physical one. Rings do not belong to a process: whoever opened one
+   has to close it before the memory is reused. All rings are closed
+   on reset. If head ever gets more than size ahead of tail, the host
+   stops draining the ring without touching it again, and RING_NOTIFY
+   returns EIO.
+
+   if you change anything in the enum {} or the struct below you
+   have to increase this NF_RING_NFAPI_VERSION!
+*/
+#define NF_RING_NFAPI_VERSION	0x00000001
+
+struct nf_ring {
+	unsigned long size;				/* of data[], a power of two */
+	volatile unsigned long head;	/* bytes written, by the guest */
+	volatile unsigned long tail;	/* bytes drained, by the host */
+	unsigned long reserved;			/* zero */
+	unsigned char data[];
+};
+
+enum {
+	GET_VERSION = 0,	/* no parameters, return NFAPI_VERSION in d0 */
+	RING_OPEN,			/* (struct nf_ring *ring, const char *name), return handle > 0 or error */
+	RING_NOTIFY,		/* (handle), the ring is not empty anymore */
+	RING_CLOSE			/* (handle), the data not drained yet is lost */
+};
+
+#define NFRING(a)	(nfRingID + a)
+
+#endif /* _NF_RING_NFAPI_H */
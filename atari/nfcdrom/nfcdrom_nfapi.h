@@ -44,7 +44,9 @@ enum {
 	NFCD_GETTOC,
 	NFCD_DISCINFO,
 	
-	NFCD_DRIVESMASK
+	NFCD_DRIVESMASK,
+	/* optional, probed for (older hosts return ENOSYS), no version change */
+	NFCD_READ_ASYNC		/* like NFCD_READ, returns a NF_ASYNC ticket */
 };
 
 #define NFCDROM(a)	(nfCdRomId + a)
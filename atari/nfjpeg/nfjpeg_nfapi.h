@@ -33,7 +33,9 @@ enum {
 	NFJPEG_GETSTRUCTSIZE,
 	NFJPEG_GETIMAGEINFO,
 	NFJPEG_GETIMAGESIZE,
-	NFJPEG_DECODEIMAGE
+	NFJPEG_DECODEIMAGE,
+	/* optional, probed for (older hosts return EINVFN), no version change */
+	NFJPEG_LOADIMAGE_ASYNC	/* (jpgd), decode like NFJPEG_GETIMAGEINFO, returns a NF_ASYNC ticket */
 };
 
 #define NFJPEG(a)	(nfJpegId + a)
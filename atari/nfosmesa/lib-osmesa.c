@@ -41,6 +41,7 @@
 
 static const struct nf_ops *nfOps;
 static unsigned long nfOSMesaId=0;
+static long nfOSMesaVersion;
 
 static long do_nothing(unsigned long function_number, OSMesaContext ctx, void *first_param)
 {
@@ -85,7 +86,8 @@ static void InitNatfeat(void)
 		return;
 	}
 	ver = nfOps->call(nfOSMesaId+GET_VERSION, 0l, 0l);
-	if (ver < ARANFOSMESA_NFAPI_VERSION)
+	nfOSMesaVersion = ver;
+	if (ver < ARANFOSMESA_NFAPI_MIN_VERSION)
 	{
 		if (err_old_nfapi())
 		{
@@ -103,13 +105,95 @@ static void InitNatfeat(void)
 	}
 }
 
+/*
+ * Calls that neither return a value nor pass a pointer are queued and
+ * sent to the host in one go (NFOSMESA_BATCH, API version 5 and later)
+ * before any other call, so immediate mode rendering does not cost a
+ * NatFeat call per vertex. Each entry is the function number and the
+ * number of parameter words in one word, followed by the parameters.
+ *
+ * The queue is static, which is per process for the LDGs only. The
+ * SLBs share it between all their clients, which could interleave
+ * their calls in it, so they clear batch_allowed before glInit.
+ */
+#define BATCH_WORDS	2048
+
+static const struct {
+	unsigned short function_number;
+	unsigned short words;
+} batch_calls[] = {
+	{ NFOSMESA_GLBEGIN, 1 }, { NFOSMESA_GLEND, 0 },
+	{ NFOSMESA_GLVERTEX2F, 2 }, { NFOSMESA_GLVERTEX2I, 2 }, { NFOSMESA_GLVERTEX2S, 2 }, { NFOSMESA_GLVERTEX2D, 4 },
+	{ NFOSMESA_GLVERTEX3F, 3 }, { NFOSMESA_GLVERTEX3I, 3 }, { NFOSMESA_GLVERTEX3S, 3 }, { NFOSMESA_GLVERTEX3D, 6 },
+	{ NFOSMESA_GLVERTEX4F, 4 }, { NFOSMESA_GLVERTEX4D, 8 },
+	{ NFOSMESA_GLCOLOR3F, 3 }, { NFOSMESA_GLCOLOR3UB, 3 }, { NFOSMESA_GLCOLOR3D, 6 },
+	{ NFOSMESA_GLCOLOR4F, 4 }, { NFOSMESA_GLCOLOR4UB, 4 }, { NFOSMESA_GLCOLOR4D, 8 },
+	{ NFOSMESA_GLNORMAL3F, 3 }, { NFOSMESA_GLNORMAL3D, 6 },
+	{ NFOSMESA_GLTEXCOORD1F, 1 }, { NFOSMESA_GLTEXCOORD2F, 2 }, { NFOSMESA_GLTEXCOORD3F, 3 },
+	{ NFOSMESA_GLTEXCOORD4F, 4 }, { NFOSMESA_GLTEXCOORD2D, 4 },
+	{ NFOSMESA_GLMULTITEXCOORD2F, 3 }, { NFOSMESA_GLMULTITEXCOORD2FARB, 3 },
+	{ NFOSMESA_GLEDGEFLAG, 1 }, { NFOSMESA_GLINDEXI, 1 }, { NFOSMESA_GLINDEXF, 1 },
+	{ NFOSMESA_GLMATERIALF, 3 }, { NFOSMESA_GLMATERIALI, 3 },
+	{ NFOSMESA_GLLIGHTF, 3 }, { NFOSMESA_GLLIGHTI, 3 }, { NFOSMESA_GLLIGHTMODELF, 2 }, { NFOSMESA_GLLIGHTMODELI, 2 },
+	{ NFOSMESA_GLTRANSLATEF, 3 }, { NFOSMESA_GLTRANSLATED, 6 }, { NFOSMESA_GLROTATEF, 4 }, { NFOSMESA_GLROTATED, 8 },
+	{ NFOSMESA_GLSCALEF, 3 }, { NFOSMESA_GLSCALED, 6 },
+	{ NFOSMESA_GLPUSHMATRIX, 0 }, { NFOSMESA_GLPOPMATRIX, 0 }, { NFOSMESA_GLLOADIDENTITY, 0 }, { NFOSMESA_GLMATRIXMODE, 1 },
+	{ NFOSMESA_GLENABLE, 1 }, { NFOSMESA_GLDISABLE, 1 }, { NFOSMESA_GLBINDTEXTURE, 2 },
+	{ NFOSMESA_GLBLENDFUNC, 2 }, { NFOSMESA_GLDEPTHFUNC, 1 }, { NFOSMESA_GLDEPTHMASK, 1 }, { NFOSMESA_GLSHADEMODEL, 1 },
+	{ NFOSMESA_GLCULLFACE, 1 }, { NFOSMESA_GLFRONTFACE, 1 }, { NFOSMESA_GLCOLORMASK, 4 },
+	{ NFOSMESA_GLCLEARCOLOR, 4 }, { NFOSMESA_GLCLEAR, 1 }, { NFOSMESA_GLCLEARDEPTH, 2 }, { NFOSMESA_GLVIEWPORT, 4 },
+	{ NFOSMESA_GLLINEWIDTH, 1 }, { NFOSMESA_GLPOINTSIZE, 1 },
+	{ NFOSMESA_GLTEXPARAMETERI, 3 }, { NFOSMESA_GLTEXPARAMETERF, 3 }, { NFOSMESA_GLTEXENVI, 3 }, { NFOSMESA_GLTEXENVF, 3 },
+	{ NFOSMESA_GLFOGF, 2 }, { NFOSMESA_GLFOGI, 2 }, { NFOSMESA_GLALPHAFUNC, 2 }, { NFOSMESA_GLHINT, 2 },
+	{ NFOSMESA_GLPOLYGONMODE, 2 }, { NFOSMESA_GLCALLLIST, 1 }, { NFOSMESA_GLRECTF, 4 }, { NFOSMESA_GLRECTI, 4 }
+};
+
+/* parameter words + 1 of the calls that are queued, 0 for the others */
+static unsigned char batch_size[NFOSMESA_LAST];
+static unsigned long batch[BATCH_WORDS];
+static unsigned long batch_len;
+static OSMesaContext batch_ctx;
+int batch_allowed = 1;
+
+static void FlushBatch(void)
+{
+	unsigned long params[2];
+
+	if (batch_len == 0)
+		return;
+	params[0] = (unsigned long)batch;
+	params[1] = batch_len;
+	nfOps->call(nfOSMesaId+NFOSMESA_BATCH, batch_ctx, params);
+	batch_len = 0;
+}
+
 static long HostCall_natfeats(unsigned long function_number, OSMesaContext ctx, void *first_param)
 {
+	FlushBatch();
 	return nfOps->call(nfOSMesaId+function_number,ctx,first_param);
 }
 
+static long HostCall_batch(unsigned long function_number, OSMesaContext ctx, void *first_param)
+{
+	unsigned long words;
+	const unsigned long *params = first_param;
+
+	if (function_number >= NFOSMESA_LAST || batch_size[function_number] == 0)
+		return HostCall_natfeats(function_number, ctx, first_param);
+
+	words = batch_size[function_number] - 1;
+	if (ctx != batch_ctx || batch_len + 1 + words > BATCH_WORDS)
+		FlushBatch();
+	batch_ctx = ctx;
+	batch[batch_len++] = (function_number << 16) | words;
+	while (words--)
+		batch[batch_len++] = *params++;
+	return 0;
+}
+
 static void HostCall_natfeats64(unsigned long function_number, OSMesaContext ctx, void *first_param, GLuint64 *retvalue)
 {
+	FlushBatch();
 	nfOps->call(nfOSMesaId+function_number, ctx, first_param, retvalue);
 }
 
@@ -122,6 +206,13 @@ static int InstallHostCall(void)
 	if (nfOSMesaId!=0) {
 		HostCall_p = HostCall_natfeats;
 		HostCall64_p = HostCall_natfeats64;
+		if (nfOSMesaVersion >= 5 && batch_allowed) {
+			unsigned int i;
+
+			for (i = 0; i < sizeof(batch_calls) / sizeof(batch_calls[0]); i++)
+				batch_size[batch_calls[i].function_number] = batch_calls[i].words + 1;
+			HostCall_p = HostCall_batch;
+		}
 		return 1;
 	}
 
@@ -62,6 +62,7 @@ extern long (*HostCall_p)(unsigned long function_number, OSMesaContext ctx, void
 #ifndef TINYGL_ONLY
 extern void (*HostCall64_p)(unsigned long function_number, OSMesaContext ctx, void *first_param, GLuint64 *retvalue);
 #endif
+extern int batch_allowed;
 
 /*--- Functions prototypes ---*/
 
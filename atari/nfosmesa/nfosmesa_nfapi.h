@@ -26,12 +26,16 @@
 /* if you change anything in the enum {} below you have to increase 
    this ARANFOSMESA_NFAPI_VERSION!
 */
-#define ARANFOSMESA_NFAPI_VERSION	4
+#define ARANFOSMESA_NFAPI_VERSION	5
+
+/* NFOSMESA_BATCH is optional; the library still works with older hosts */
+#define ARANFOSMESA_NFAPI_MIN_VERSION	4
 
 enum {
 	GET_VERSION=0,	/* no parameters, return NFAPI_VERSION in d0 */
 
 #include "enum-gl.h"
+	NFOSMESA_BATCH,	/* (commands, words), since version 5; see OSMesaDriver::runBatch() */
 	NFOSMESA_LAST,
 	NFOSMESA_ENOSYS = NFOSMESA_LAST
 };
@@ -92,6 +92,8 @@ static char const slh_name[] = "tiny_gl.slb";
 
 static long __CDECL slb_libinit(BASEPAGE *__bp unused, long __fn unused, long __nwords unused, gl_private *priv)
 {
+	/* the batch queue would be shared by all clients */
+	batch_allowed = 0;
 	internal_glInit(priv);
 	return sizeof(*priv);
 }
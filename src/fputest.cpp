@@ -0,0 +1,875 @@
+/*
+ * fputest.cpp - FPU core benchmark and differential test harness
+ *
+ * Copyright (c) 2026 ARAnyM dev team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * The harness is compiled against exactly one FPU core (the one selected
+ * by FPU_IEEE, FPU_UAE, FPU_X86 or FPU_MPFR), and drives fpuop_arithmetic()
+ * directly with opcode/extension word pairs, just like the decoder in
+ * newcpu.cpp would.  Operands are passed through a small fake RAM using
+ * (An) addressing, so every core sees exactly the same bit patterns.
+ *
+ * Since the cores cannot be linked into the same binary, comparing them
+ * is done through a result file:
+ *
+ *   fputest-ieee -w ieee.dat       record results of the IEEE core
+ *   fputest-mpfr -c ieee.dat       replay and report every difference
+ *   fputest-uae -b                 ops/second per instruction
+ *
+ * All operands are generated from a fixed seed by our own PRNG, so the
+ * sequence is identical for every core and host.
+ *
+ * fputest-ieee, fputest-uae and fputest-mpfr build on every host (the
+ * last one needs MPFR). fputest-x86 is only offered on i386 hosts: the
+ * x87 core needs USE_X87_ASSEMBLY, which fpu/core.h does not set for
+ * x86-64 builds, as fpu/types.h does not select long doubles there.
+ */
+
+#include "sysdeps.h"
+
+/*
+ * The harness has no MMU, no hardware space and no bus error handling;
+ * operands live in a plain array that is addressed directly.
+ */
+#undef FULLMMU
+#undef ARAM_PAGE_CHECK
+#undef USE_JIT_FPU
+#define NOCHECKBOUNDARY 1
+
+#include "cpu_emulation.h"
+#include "hardware.h"
+
+#if defined(FPU_IEEE)
+# include "fpu/fpu_ieee.cpp"
+# define FPU_CORE_NAME "ieee"
+#elif defined(FPU_UAE)
+# include "fpu/fpu_uae.cpp"
+# define FPU_CORE_NAME "uae"
+#elif defined(FPU_X86)
+# include "fpu/fpu_x86.cpp"
+# define FPU_CORE_NAME "x86"
+#elif defined(FPU_MPFR)
+# include "fpu/fpu_mpfr.cpp"
+# define FPU_CORE_NAME "mpfr"
+#else
+# error "no FPU core selected"
+#endif
+
+#include <getopt.h>
+#include <sys/time.h>
+
+/* -------------------------------------------------------------------------- */
+/* --- Minimal CPU environment                                            --- */
+/* -------------------------------------------------------------------------- */
+
+#define RAM_SIZE		0x10000
+#define CODE_ADDR		0x1000		/* where the PC points to */
+#define SRC_ADDR		0x2000		/* operand buffers for (An) */
+#define DST_ADDR		0x2100
+#define RES_ADDR		0x2200
+#define FMOVEM_ADDR		0x3000
+#define FMOVEM_END		0x3400
+
+static uae_u8 atari_mem[RAM_SIZE];
+
+struct regstruct regs;
+uintptr MEMBaseDiff;
+int CPUType = 4;
+#ifdef EXCEPTIONS_VIA_LONGJMP
+JMP_BUF excep_env;
+#endif
+
+/* Last exception vector raised by the core, 0 if none */
+static int last_exception;
+
+void Exception(int nr, uaecptr /* oldpc */)
+{
+	last_exception = nr;
+}
+
+void REGPARAM2 op_illg(uae_u32 /* opcode */)
+{
+	last_exception = 4;
+}
+
+uae_u32 REGPARAM2 get_disp_ea_020(uae_u32, uae_u32)
+{
+	fprintf(stderr, "fputest: unexpected indexed addressing mode\n");
+	abort();
+}
+
+uae_u32 HWget_l(uaecptr addr) { fprintf(stderr, "fputest: HW access at $%08x\n", addr); abort(); }
+uae_u16 HWget_w(uaecptr addr) { return HWget_l(addr); }
+uae_u8 HWget_b(uaecptr addr) { return HWget_l(addr); }
+void HWput_l(uaecptr addr, uae_u32) { HWget_l(addr); }
+void HWput_w(uaecptr addr, uae_u16) { HWget_l(addr); }
+void HWput_b(uaecptr addr, uae_u8) { HWget_l(addr); }
+
+extern "C" void breakpt(void) { }
+
+/* -------------------------------------------------------------------------- */
+/* --- Test table                                                         --- */
+/* -------------------------------------------------------------------------- */
+
+/* Source specifiers of the general FPU instruction format */
+enum {
+	FMT_L = 0, FMT_S = 1, FMT_X = 2, FMT_P = 3, FMT_W = 4, FMT_D = 5, FMT_B = 6
+};
+
+static const int fmt_size[8] = { 4, 4, 12, 12, 2, 8, 1, 12 };
+
+enum test_kind {
+	T_DYADIC,		/* FPn = FPn op FPm */
+	T_MONADIC,		/* FPn = op FPm */
+	T_COMPARE,		/* only FPSR is affected */
+	T_STORE,		/* FMOVE.<fmt> FPm,(A0) */
+	T_LOAD,			/* FMOVE.<fmt> (A0),FPn from raw bits */
+	T_FMOVEM		/* FMOVEM.X round trip through memory */
+};
+
+struct fpu_test {
+	const char *name;
+	enum test_kind kind;
+	uae_u16 opmode;		/* bits 0-6 of the extension word */
+	int fmt;			/* for T_STORE/T_LOAD */
+	int result_reg;		/* register stored as result */
+};
+
+static const struct fpu_test tests[] = {
+	{ "fmove",    T_MONADIC, 0x00, 0, 0 },
+	{ "fint",     T_MONADIC, 0x01, 0, 0 },
+	{ "fsinh",    T_MONADIC, 0x02, 0, 0 },
+	{ "fintrz",   T_MONADIC, 0x03, 0, 0 },
+	{ "fsqrt",    T_MONADIC, 0x04, 0, 0 },
+	{ "flognp1",  T_MONADIC, 0x06, 0, 0 },
+	{ "fetoxm1",  T_MONADIC, 0x08, 0, 0 },
+	{ "ftanh",    T_MONADIC, 0x09, 0, 0 },
+	{ "fatan",    T_MONADIC, 0x0a, 0, 0 },
+	{ "fasin",    T_MONADIC, 0x0c, 0, 0 },
+	{ "fatanh",   T_MONADIC, 0x0d, 0, 0 },
+	{ "fsin",     T_MONADIC, 0x0e, 0, 0 },
+	{ "ftan",     T_MONADIC, 0x0f, 0, 0 },
+	{ "fetox",    T_MONADIC, 0x10, 0, 0 },
+	{ "ftwotox",  T_MONADIC, 0x11, 0, 0 },
+	{ "ftentox",  T_MONADIC, 0x12, 0, 0 },
+	{ "flogn",    T_MONADIC, 0x14, 0, 0 },
+	{ "flog10",   T_MONADIC, 0x15, 0, 0 },
+	{ "flog2",    T_MONADIC, 0x16, 0, 0 },
+	{ "fabs",     T_MONADIC, 0x18, 0, 0 },
+	{ "fcosh",    T_MONADIC, 0x19, 0, 0 },
+	{ "fneg",     T_MONADIC, 0x1a, 0, 0 },
+	{ "facos",    T_MONADIC, 0x1c, 0, 0 },
+	{ "fcos",     T_MONADIC, 0x1d, 0, 0 },
+	{ "fgetexp",  T_MONADIC, 0x1e, 0, 0 },
+	{ "fgetman",  T_MONADIC, 0x1f, 0, 0 },
+	{ "fdiv",     T_DYADIC,  0x20, 0, 0 },
+	{ "fmod",     T_DYADIC,  0x21, 0, 0 },
+	{ "fadd",     T_DYADIC,  0x22, 0, 0 },
+	{ "fmul",     T_DYADIC,  0x23, 0, 0 },
+	{ "fsgldiv",  T_DYADIC,  0x24, 0, 0 },
+	{ "frem",     T_DYADIC,  0x25, 0, 0 },
+	{ "fscale",   T_DYADIC,  0x26, 0, 0 },
+	{ "fsglmul",  T_DYADIC,  0x27, 0, 0 },
+	{ "fsub",     T_DYADIC,  0x28, 0, 0 },
+	{ "fsincos.s",T_MONADIC, 0x32, 0, 0 },	/* cosine goes to FP2 */
+	{ "fsincos.c",T_MONADIC, 0x32, 0, 2 },
+	{ "fcmp",     T_COMPARE, 0x38, 0, 0 },
+	{ "ftst",     T_COMPARE, 0x3a, 0, 0 },
+	{ "fsmove",   T_MONADIC, 0x40, 0, 0 },
+	{ "fssqrt",   T_MONADIC, 0x41, 0, 0 },
+	{ "fdmove",   T_MONADIC, 0x44, 0, 0 },
+	{ "fdsqrt",   T_MONADIC, 0x45, 0, 0 },
+	{ "fsabs",    T_MONADIC, 0x58, 0, 0 },
+	{ "fsneg",    T_MONADIC, 0x5a, 0, 0 },
+	{ "fdabs",    T_MONADIC, 0x5c, 0, 0 },
+	{ "fdneg",    T_MONADIC, 0x5e, 0, 0 },
+	{ "fsdiv",    T_DYADIC,  0x60, 0, 0 },
+	{ "fsadd",    T_DYADIC,  0x62, 0, 0 },
+	{ "fsmul",    T_DYADIC,  0x63, 0, 0 },
+	{ "fddiv",    T_DYADIC,  0x64, 0, 0 },
+	{ "fdadd",    T_DYADIC,  0x66, 0, 0 },
+	{ "fdmul",    T_DYADIC,  0x67, 0, 0 },
+	{ "fssub",    T_DYADIC,  0x68, 0, 0 },
+	{ "fdsub",    T_DYADIC,  0x6c, 0, 0 },
+	{ "fmove.l>", T_STORE,   0x00, FMT_L, 0 },
+	{ "fmove.w>", T_STORE,   0x00, FMT_W, 0 },
+	{ "fmove.b>", T_STORE,   0x00, FMT_B, 0 },
+	{ "fmove.s>", T_STORE,   0x00, FMT_S, 0 },
+	{ "fmove.d>", T_STORE,   0x00, FMT_D, 0 },
+	{ "fmove.p>", T_STORE,   0x11, FMT_P, 0 },	/* static k-factor 17 */
+	{ "fmove.l<", T_LOAD,    0x00, FMT_L, 0 },
+	{ "fmove.w<", T_LOAD,    0x00, FMT_W, 0 },
+	{ "fmove.b<", T_LOAD,    0x00, FMT_B, 0 },
+	{ "fmove.s<", T_LOAD,    0x00, FMT_S, 0 },
+	{ "fmove.d<", T_LOAD,    0x00, FMT_D, 0 },
+	{ "fmove.p<", T_LOAD,    0x00, FMT_P, 0 },
+	{ "fmove.x<", T_LOAD,    0x00, FMT_X, 0 },
+	{ "fmovem",   T_FMOVEM,  0x00, FMT_X, 0 },
+};
+#define NUM_TESTS ((int)(sizeof(tests) / sizeof(tests[0])))
+
+/* All combinations of rounding precision and rounding mode */
+static const uae_u16 fpcr_modes[] = {
+	FPCR_PRECISION_EXTENDED | FPCR_ROUND_NEAR,
+	FPCR_PRECISION_EXTENDED | FPCR_ROUND_ZERO,
+	FPCR_PRECISION_EXTENDED | FPCR_ROUND_MINF,
+	FPCR_PRECISION_EXTENDED | FPCR_ROUND_PINF,
+	FPCR_PRECISION_DOUBLE | FPCR_ROUND_NEAR,
+	FPCR_PRECISION_DOUBLE | FPCR_ROUND_ZERO,
+	FPCR_PRECISION_DOUBLE | FPCR_ROUND_MINF,
+	FPCR_PRECISION_DOUBLE | FPCR_ROUND_PINF,
+	FPCR_PRECISION_SINGLE | FPCR_ROUND_NEAR,
+	FPCR_PRECISION_SINGLE | FPCR_ROUND_ZERO,
+	FPCR_PRECISION_SINGLE | FPCR_ROUND_MINF,
+	FPCR_PRECISION_SINGLE | FPCR_ROUND_PINF,
+};
+#define NUM_MODES ((int)(sizeof(fpcr_modes) / sizeof(fpcr_modes[0])))
+
+/* -------------------------------------------------------------------------- */
+/* --- Operands                                                           --- */
+/* -------------------------------------------------------------------------- */
+
+/* An operand in the memory layout of the 68881 extended format */
+struct ext_operand {
+	uae_u16 exp;		/* sign and exponent */
+	uae_u32 hi, lo;		/* mantissa, including the explicit integer bit */
+};
+
+static const struct ext_operand edge_operands[] = {
+	{ 0x0000, 0x00000000, 0x00000000 },	/* +0 */
+	{ 0x8000, 0x00000000, 0x00000000 },	/* -0 */
+	{ 0x3fff, 0x80000000, 0x00000000 },	/* +1 */
+	{ 0xbfff, 0x80000000, 0x00000000 },	/* -1 */
+	{ 0x4000, 0x80000000, 0x00000000 },	/* 2 */
+	{ 0x3ffe, 0x80000000, 0x00000000 },	/* 0.5 */
+	{ 0x3fff, 0xc0000000, 0x00000000 },	/* 1.5 */
+	{ 0x4000, 0xa0000000, 0x00000000 },	/* 2.5 */
+	{ 0xbfff, 0xc0000000, 0x00000000 },	/* -1.5 */
+	{ 0x4000, 0xc90fdaa2, 0x2168c235 },	/* pi */
+	{ 0x3fff, 0xffffffff, 0xffffffff },	/* 2 - ulp */
+	{ 0x3ffe, 0xffffffff, 0xffffffff },	/* 1 - ulp */
+	{ 0x3fff, 0x80000000, 0x00000001 },	/* 1 + ulp */
+	{ 0x403e, 0xffffffff, 0xffffffff },	/* 2^64 - 1 */
+	{ 0x401d, 0xffffffff, 0x00000000 },	/* 2^31 - 0.5 */
+	{ 0xc01e, 0x80000000, 0x00000000 },	/* -2^31 */
+	{ 0x407e, 0xffffff00, 0x00000000 },	/* FLT_MAX */
+	{ 0x3f81, 0x80000000, 0x00000000 },	/* FLT_MIN */
+	{ 0x3f6a, 0x80000000, 0x00000000 },	/* smallest single denormal */
+	{ 0x43fe, 0xffffffff, 0xfffff800 },	/* DBL_MAX */
+	{ 0x3c01, 0x80000000, 0x00000000 },	/* DBL_MIN */
+	{ 0x3bcd, 0x80000000, 0x00000000 },	/* smallest double denormal */
+	{ 0x7ffe, 0xffffffff, 0xffffffff },	/* largest extended */
+	{ 0x0001, 0x80000000, 0x00000000 },	/* smallest normal extended */
+	{ 0x0000, 0x40000000, 0x00000000 },	/* denormal */
+	{ 0x0000, 0x00000000, 0x00000001 },	/* smallest denormal */
+	{ 0x8000, 0x7fffffff, 0xffffffff },	/* largest negative denormal */
+	{ 0x3fff, 0x00000000, 0x00000001 },	/* unnormal */
+	{ 0x7fff, 0x00000000, 0x00000000 },	/* +inf */
+	{ 0xffff, 0x00000000, 0x00000000 },	/* -inf */
+	{ 0x7fff, 0xc0000000, 0x00000000 },	/* quiet NaN */
+	{ 0xffff, 0xffffffff, 0xffffffff },	/* negative quiet NaN */
+	{ 0x7fff, 0xa0000000, 0x00000000 },	/* signaling NaN */
+	{ 0x7fff, 0x80000000, 0x00000001 },	/* signaling NaN, low payload */
+};
+#define NUM_EDGE_OPERANDS ((int)(sizeof(edge_operands) / sizeof(edge_operands[0])))
+
+static uae_u64 rng_state;
+
+static uae_u32 rng(void)
+{
+	/* xorshift64*, identical on all hosts */
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (uae_u32)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void random_operand(struct ext_operand *op)
+{
+	uae_u32 r = rng();
+
+	switch (r & 7) {
+	case 0:
+		/* raw bit pattern, anything goes */
+		op->exp = rng() & 0xffff;
+		op->hi = rng();
+		op->lo = rng();
+		break;
+	case 1:
+		/* small integers, exercises fint/fmod/frem/fscale */
+		op->exp = 0x3fff + (rng() % 24);
+		op->hi = rng() | 0x80000000;
+		op->lo = 0;
+		break;
+	case 2:
+		/* tiny numbers around the single/double/extended limits */
+		op->exp = (rng() % 3 == 0 ? 0x3f81 : rng() % 2 ? 0x3c01 : 0x0001) + (rng() % 64) - 32;
+		op->hi = rng() | 0x80000000;
+		op->lo = rng();
+		break;
+	case 3:
+		/* huge numbers */
+		op->exp = (rng() % 3 == 0 ? 0x407e : rng() % 2 ? 0x43fe : 0x7ffe) - (rng() % 32);
+		op->hi = rng() | 0x80000000;
+		op->lo = rng();
+		break;
+	default:
+		/* ordinary normalized numbers */
+		op->exp = 0x3fff + (int)(rng() % 128) - 64;
+		op->hi = rng() | 0x80000000;
+		op->lo = rng();
+		break;
+	}
+	if (r & 0x100)
+		op->exp |= 0x8000;
+}
+
+static struct ext_operand *operands;
+static int num_operands;
+
+static void make_operands(int nrandom)
+{
+	num_operands = NUM_EDGE_OPERANDS + nrandom;
+	operands = (struct ext_operand *)malloc(num_operands * sizeof(*operands));
+	if (operands == NULL) {
+		fprintf(stderr, "fputest: out of memory\n");
+		exit(1);
+	}
+	memcpy(operands, edge_operands, sizeof(edge_operands));
+	for (int i = NUM_EDGE_OPERANDS; i < num_operands; i++)
+		random_operand(&operands[i]);
+}
+
+static void poke_operand(uaecptr addr, const struct ext_operand *op)
+{
+	put_word(addr, op->exp);
+	put_word(addr + 2, 0);
+	put_long(addr + 4, op->hi);
+	put_long(addr + 8, op->lo);
+}
+
+/*
+ * Raw bit patterns for the conversion tests are derived from the extended
+ * operands; packed decimal is massaged into valid BCD digits.
+ */
+static void poke_raw(uaecptr addr, int fmt, const struct ext_operand *op)
+{
+	poke_operand(addr, op);
+	if (fmt == FMT_P) {
+		uae_u8 *p = atari_mem + addr;
+
+		/* SM, SE, YY, 3 exponent digits, integer digit, 16 fraction digits */
+		p[0] = (p[0] & 0xf0) | ((p[0] & 0x0f) % 10);
+		p[2] = 0;
+		p[3] = (p[3] & 0x0f) % 10;
+		p[1] = (((p[1] >> 4) % 10) << 4) | ((p[1] & 0x0f) % 10);
+		for (int i = 4; i < 12; i++)
+			p[i] = (((p[i] >> 4) % 10) << 4) | ((p[i] & 0x0f) % 10);
+	}
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- Instruction execution                                              --- */
+/* -------------------------------------------------------------------------- */
+
+#define OP_FPU_A0		0xf210		/* cpid 1, general, (A0) */
+#define OP_FPU_A0_PI	0xf218		/* cpid 1, general, (A0)+ */
+#define OP_FPU_A1_PD	0xf221		/* cpid 1, general, -(A1) */
+#define OP_FPU_REG		0xf200		/* cpid 1, general, D0 */
+
+static inline void fpu_exec(uae_u32 opcode, uae_u32 extra)
+{
+	/* the decoder has already fetched the opcode and the extension word */
+	m68k_setpc(CODE_ADDR + 4);
+	fpuop_arithmetic(opcode, extra);
+}
+
+/* FMOVE.X (A0),FPn */
+static inline void load_reg(int reg, uaecptr addr)
+{
+	m68k_areg(regs, 0) = addr;
+	fpu_exec(OP_FPU_A0, 0x4000 | (FMT_X << 10) | (reg << 7));
+}
+
+/* FMOVE.X FPn,(A0) */
+static inline void store_reg(int reg, uaecptr addr)
+{
+	m68k_areg(regs, 0) = addr;
+	fpu_exec(OP_FPU_A0, 0x6000 | (FMT_X << 10) | (reg << 7));
+}
+
+struct test_result {
+	uae_u8 result[12];
+	uae_u32 fpsr;
+	uae_u32 aux;
+};
+
+/*
+ * Execute one test.  FP0 is the destination, FP1 the source;
+ * T_LOAD/T_STORE use the source buffer directly.
+ */
+static void run_test(const struct fpu_test *t, uae_u16 fpcr,
+	const struct ext_operand *src, const struct ext_operand *dst,
+	struct test_result *res)
+{
+	fpu_set_fpcr(fpcr);
+	fpu_set_fpsr(0);
+	last_exception = 0;
+	memset(atari_mem + RES_ADDR, 0, 12);
+
+	switch (t->kind) {
+	case T_DYADIC:
+	case T_MONADIC:
+	case T_COMPARE:
+		poke_operand(SRC_ADDR, src);
+		poke_operand(DST_ADDR, dst);
+		load_reg(1, SRC_ADDR);
+		load_reg(0, DST_ADDR);
+		fpu_set_fpsr(0);
+		fpu_exec(OP_FPU_REG, (1 << 10) | (0 << 7) | t->opmode);
+		res->fpsr = fpu_get_fpsr();
+		fpu_set_fpcr(0);
+		store_reg(t->result_reg, RES_ADDR);
+		break;
+	case T_STORE:
+		poke_operand(SRC_ADDR, src);
+		load_reg(1, SRC_ADDR);
+		fpu_set_fpsr(0);
+		m68k_areg(regs, 0) = RES_ADDR;
+		fpu_exec(OP_FPU_A0, 0x6000 | (t->fmt << 10) | (1 << 7) | t->opmode);
+		res->fpsr = fpu_get_fpsr();
+		break;
+	case T_LOAD:
+		poke_raw(SRC_ADDR, t->fmt, src);
+		m68k_areg(regs, 0) = SRC_ADDR;
+		fpu_exec(OP_FPU_A0, 0x4000 | (t->fmt << 10) | (0 << 7));
+		res->fpsr = fpu_get_fpsr();
+		fpu_set_fpcr(0);
+		store_reg(0, RES_ADDR);
+		break;
+	case T_FMOVEM:
+		/*
+		 * Load FP0 from "src" and FP1-FP7 from "dst" with (A0)+,
+		 * write them back with -(A1) and return the slot of FP0,
+		 * so a wrong register order shows up as a difference.
+		 */
+		for (int i = 0; i < 8; i++)
+			poke_operand(FMOVEM_ADDR + i * 12, i == 0 ? src : dst);
+		m68k_areg(regs, 0) = FMOVEM_ADDR;
+		fpu_exec(OP_FPU_A0_PI, 0xc000 | 0x1000 | 0xff);
+		m68k_areg(regs, 1) = FMOVEM_END;
+		fpu_exec(OP_FPU_A1_PD, 0xe000 | 0x0000 | 0xff);
+		res->fpsr = fpu_get_fpsr();
+		memcpy(atari_mem + RES_ADDR, atari_mem + FMOVEM_END - 8 * 12, 12);
+		res->aux = ((m68k_areg(regs, 0) - FMOVEM_ADDR) << 16) | (FMOVEM_END - m68k_areg(regs, 1));
+		memcpy(res->result, atari_mem + RES_ADDR, 12);
+		return;
+	}
+	memcpy(res->result, atari_mem + RES_ADDR, 12);
+	res->aux = last_exception;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- Result file                                                        --- */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Each record is stored big-endian, so files can be compared
+ * across hosts:
+ *   2 test index, 2 fpcr, 12 src, 12 dst, 12 result, 4 fpsr, 4 aux
+ */
+#define RECORD_SIZE 48
+#define FILE_MAGIC "ARAFPU01"
+
+static void put_be(uae_u8 *p, uae_u32 v, int n)
+{
+	while (--n >= 0) {
+		p[n] = v & 0xff;
+		v >>= 8;
+	}
+}
+
+static uae_u32 get_be(const uae_u8 *p, int n)
+{
+	uae_u32 v = 0;
+	while (--n >= 0)
+		v = (v << 8) | *p++;
+	return v;
+}
+
+static void encode_operand(uae_u8 *p, const struct ext_operand *op)
+{
+	put_be(p, op->exp, 2);
+	put_be(p + 2, 0, 2);
+	put_be(p + 4, op->hi, 4);
+	put_be(p + 8, op->lo, 4);
+}
+
+static void encode_record(uae_u8 *rec, int test, uae_u16 fpcr,
+	const struct ext_operand *src, const struct ext_operand *dst,
+	const struct test_result *res)
+{
+	put_be(rec, test, 2);
+	put_be(rec + 2, fpcr, 2);
+	encode_operand(rec + 4, src);
+	encode_operand(rec + 16, dst);
+	memcpy(rec + 28, res->result, 12);
+	put_be(rec + 40, res->fpsr, 4);
+	put_be(rec + 44, res->aux, 4);
+}
+
+static void print_bytes(const uae_u8 *p, int n)
+{
+	for (int i = 0; i < n; i++)
+		printf("%02x", p[i]);
+}
+
+static const char *mode_name(uae_u16 fpcr)
+{
+	static char buf[16];
+	static const char *const prec[4] = { "x", "s", "d", "?" };
+	static const char *const rnd[4] = { "rn", "rz", "rm", "rp" };
+	snprintf(buf, sizeof(buf), "%s.%s", prec[(fpcr >> 6) & 3], rnd[(fpcr >> 4) & 3]);
+	return buf;
+}
+
+static void report_diff(const uae_u8 *expected, const uae_u8 *got)
+{
+	const struct fpu_test *t = &tests[get_be(expected, 2)];
+	int size = t->kind == T_STORE ? fmt_size[t->fmt] : 12;
+
+	printf("%-10s %s src=", t->name, mode_name(get_be(expected + 2, 2)));
+	print_bytes(expected + 4, 12);
+	printf(" dst=");
+	print_bytes(expected + 16, 12);
+	printf("\n    expected ");
+	print_bytes(expected + 28, size);
+	printf(" fpsr=%08x aux=%08x\n", get_be(expected + 40, 4), get_be(expected + 44, 4));
+	printf("    got      ");
+	print_bytes(got + 28, size);
+	printf(" fpsr=%08x aux=%08x\n", get_be(got + 40, 4), get_be(got + 44, 4));
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- Drivers                                                            --- */
+/* -------------------------------------------------------------------------- */
+
+static bool test_selected(int test, const char *only)
+{
+	return only == NULL || strcmp(tests[test].name, only) == 0;
+}
+
+/* dyadic operations get the full cross product of the edge cases */
+static bool uses_pairs(const struct fpu_test *t)
+{
+	return t->kind == T_DYADIC || (t->kind == T_COMPARE && t->opmode == 0x38);
+}
+
+static int num_pairs(const struct fpu_test *t)
+{
+	if (uses_pairs(t))
+		return NUM_EDGE_OPERANDS * NUM_EDGE_OPERANDS + (num_operands - NUM_EDGE_OPERANDS);
+	return num_operands;
+}
+
+static void get_pair(int i, const struct ext_operand **src, const struct ext_operand **dst)
+{
+	int nedge = NUM_EDGE_OPERANDS * NUM_EDGE_OPERANDS;
+
+	if (i < nedge) {
+		*src = &edge_operands[i % NUM_EDGE_OPERANDS];
+		*dst = &edge_operands[i / NUM_EDGE_OPERANDS];
+	} else {
+		i -= nedge;
+		*src = &operands[NUM_EDGE_OPERANDS + i];
+		*dst = &operands[NUM_EDGE_OPERANDS + (i * 7 + 3) % (num_operands - NUM_EDGE_OPERANDS)];
+	}
+}
+
+static void get_single(int i, const struct ext_operand **src, const struct ext_operand **dst)
+{
+	*src = &operands[i];
+	*dst = &operands[(i * 7 + 3) % num_operands];
+}
+
+/*
+ * Fetch the next reference record for the given test; records of
+ * tests that are not selected in this run are skipped.
+ */
+static bool read_record(FILE *ref, int test, uae_u8 *rec)
+{
+	for (;;) {
+		if (fread(rec, RECORD_SIZE, 1, ref) != 1) {
+			fprintf(stderr, "fputest: no reference results for %s\n", tests[test].name);
+			return false;
+		}
+		if ((int)get_be(rec, 2) == test)
+			return true;
+		if ((int)get_be(rec, 2) > test) {
+			fprintf(stderr, "fputest: no reference results for %s\n", tests[test].name);
+			return false;
+		}
+	}
+}
+
+static long run_all(FILE *out, FILE *ref, const char *only, long maxdiffs)
+{
+	uae_u8 rec[RECORD_SIZE], expected[RECORD_SIZE];
+	long diffs = 0;
+	long count = 0;
+	struct test_result res;
+
+	for (int test = 0; test < NUM_TESTS; test++) {
+		const struct fpu_test *t = &tests[test];
+		int n = num_pairs(t);
+		long test_diffs = 0;
+
+		if (!test_selected(test, only))
+			continue;
+
+		for (int mode = 0; mode < NUM_MODES; mode++) {
+			for (int i = 0; i < n; i++) {
+				const struct ext_operand *src, *dst;
+
+				if (uses_pairs(t))
+					get_pair(i, &src, &dst);
+				else
+					get_single(i, &src, &dst);
+				if (ref != NULL && !read_record(ref, test, expected))
+					return -1;
+				memset(&res, 0, sizeof(res));
+				run_test(t, fpcr_modes[mode], src, dst, &res);
+				encode_record(rec, test, fpcr_modes[mode], src, dst, &res);
+				count++;
+				if (out != NULL)
+					fwrite(rec, RECORD_SIZE, 1, out);
+				if (ref != NULL && memcmp(rec, expected, RECORD_SIZE) != 0) {
+					if (memcmp(rec, expected, 28) != 0) {
+						fprintf(stderr, "fputest: reference file was generated with different operands\n");
+						return -1;
+					}
+					if (maxdiffs < 0 || diffs < maxdiffs)
+						report_diff(expected, rec);
+					diffs++;
+					test_diffs++;
+				}
+			}
+		}
+		if (ref != NULL && test_diffs != 0)
+			printf("%-10s: %ld differences\n", t->name, test_diffs);
+	}
+	if (ref != NULL)
+		printf("%ld results compared, %ld differences\n", count, diffs);
+	return diffs;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * Measure every instruction against a baseline that performs
+ * the same operand loads, so only the instruction itself is timed.
+ */
+static void benchmark(const char *only, int repeat)
+{
+	struct test_result res;
+	const struct ext_operand *src, *dst;
+	int n = num_operands;
+
+	printf("fpu core: %s, %d operands x %d modes x %d repeats\n", FPU_CORE_NAME, n, NUM_MODES, repeat);
+
+	double base = now();
+	for (int r = 0; r < repeat; r++) {
+		for (int mode = 0; mode < NUM_MODES; mode++) {
+			fpu_set_fpcr(fpcr_modes[mode]);
+			for (int i = 0; i < n; i++) {
+				get_single(i, &src, &dst);
+				poke_operand(SRC_ADDR, src);
+				poke_operand(DST_ADDR, dst);
+				load_reg(1, SRC_ADDR);
+				load_reg(0, DST_ADDR);
+			}
+		}
+	}
+	base = now() - base;
+
+	for (int test = 0; test < NUM_TESTS; test++) {
+		const struct fpu_test *t = &tests[test];
+
+		if (!test_selected(test, only))
+			continue;
+		double elapsed = now();
+		if (t->kind == T_DYADIC || t->kind == T_MONADIC || t->kind == T_COMPARE) {
+			uae_u32 extra = (1 << 10) | (0 << 7) | t->opmode;
+			for (int r = 0; r < repeat; r++) {
+				for (int mode = 0; mode < NUM_MODES; mode++) {
+					fpu_set_fpcr(fpcr_modes[mode]);
+					for (int i = 0; i < n; i++) {
+						get_single(i, &src, &dst);
+						poke_operand(SRC_ADDR, src);
+						poke_operand(DST_ADDR, dst);
+						load_reg(1, SRC_ADDR);
+						load_reg(0, DST_ADDR);
+						fpu_exec(OP_FPU_REG, extra);
+					}
+				}
+			}
+			elapsed = now() - elapsed - base;
+		} else {
+			/* conversions and FMOVEM include their own setup */
+			for (int r = 0; r < repeat; r++) {
+				for (int mode = 0; mode < NUM_MODES; mode++) {
+					for (int i = 0; i < n; i++) {
+						get_single(i, &src, &dst);
+						run_test(t, fpcr_modes[mode], src, dst, &res);
+					}
+				}
+			}
+			elapsed = now() - elapsed;
+		}
+		double ops = (double)repeat * NUM_MODES * n;
+		if (elapsed <= 0)
+			printf("%-10s: below timer resolution\n", t->name);
+		else
+			printf("%-10s: %12.0f ops/s\n", t->name, ops / elapsed);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: fputest [options]\n"
+		"  -w file   write results to file\n"
+		"  -c file   compare results against file\n"
+		"  -b        benchmark, report ops/second per instruction\n"
+		"  -n count  number of random operands (default 10000)\n"
+		"  -s seed   random seed (default 1)\n"
+		"  -r count  benchmark repetitions (default 10)\n"
+		"  -t name   run only the named test\n"
+		"  -m count  print at most count differences\n"
+		"  -l        list tests\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *write_file = NULL;
+	const char *compare_file = NULL;
+	const char *only = NULL;
+	bool bench = false;
+	int nrandom = 10000;
+	int repeat = 10;
+	long maxdiffs = -1;
+	int c;
+
+	rng_state = 1;
+	while ((c = getopt(argc, argv, "w:c:bn:s:r:t:m:l")) != -1) {
+		switch (c) {
+		case 'w':
+			write_file = optarg;
+			break;
+		case 'c':
+			compare_file = optarg;
+			break;
+		case 'b':
+			bench = true;
+			break;
+		case 'n':
+			nrandom = atoi(optarg);
+			break;
+		case 's':
+			rng_state = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			repeat = atoi(optarg);
+			break;
+		case 't':
+			only = optarg;
+			break;
+		case 'm':
+			maxdiffs = atol(optarg);
+			break;
+		case 'l':
+			for (int i = 0; i < NUM_TESTS; i++)
+				printf("%s\n", tests[i].name);
+			return 0;
+		default:
+			usage();
+		}
+	}
+	if (rng_state == 0 || nrandom < 8 || repeat < 1 || optind != argc)
+		usage();
+	if (write_file == NULL && compare_file == NULL && !bench)
+		bench = true;
+
+	MEMBaseDiff = (uintptr)atari_mem;
+	regs.s = 1;
+	fpu_init(false);
+	fpu_reset();
+	make_operands(nrandom);
+
+	int ret = 0;
+	if (write_file != NULL || compare_file != NULL) {
+		FILE *out = NULL;
+		FILE *ref = NULL;
+		char magic[16];
+
+		if (write_file != NULL) {
+			out = fopen(write_file, "wb");
+			if (out == NULL) {
+				perror(write_file);
+				return 1;
+			}
+			fprintf(out, "%-8s%-8s", FILE_MAGIC, FPU_CORE_NAME);
+		}
+		if (compare_file != NULL) {
+			ref = fopen(compare_file, "rb");
+			if (ref == NULL) {
+				perror(compare_file);
+				return 1;
+			}
+			if (fread(magic, 16, 1, ref) != 1 || memcmp(magic, FILE_MAGIC, 8) != 0) {
+				fprintf(stderr, "%s: not a fputest result file\n", compare_file);
+				return 1;
+			}
+			char *core = magic + 8;
+			magic[15] = '\0';
+			core[strcspn(core, " ")] = '\0';
+			printf("comparing %s core against %s core\n", FPU_CORE_NAME, core);
+		}
+		long diffs = run_all(out, ref, only, maxdiffs);
+		if (out != NULL)
+			fclose(out);
+		if (ref != NULL)
+			fclose(ref);
+		ret = diffs != 0;
+	}
+	if (bench)
+		benchmark(only, repeat);
+
+	fpu_exit();
+	return ret;
+}
@@ -33,6 +33,8 @@ extern int32 nf_call(memptr, bool);
 
 // NatFeats call for getting parameters
 extern uint32 nf_getparameter(int);
+// take the parameters from elsewhere, returns where they were taken from
+extern memptr nf_setparameters(memptr);
 
 // should NatFeats work with physical (not MMU mapped) addresses
 #define NATFEAT_PHYS_ADDR	1
@@ -0,0 +1,52 @@
+/*
+ * nftrace.h - NatFeat call statistics and trace
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NFTRACE_H
+#define NFTRACE_H
+
+#include "sysdeps.h"
+#include <cstdio>
+#include <csignal>
+
+class NF_Base;
+
+/*
+ * nf_call() takes the slow path through NFTraceCall() whenever
+ * nftrace_flags is nonzero, that is while statistics are collected,
+ * and once after SIGUSR1 set nftrace_dump_request. The signal handler
+ * only sets the request; the emulation thread clears it.
+ */
+#define NFTRACE_ON		1
+
+extern volatile int nftrace_flags;
+extern volatile sig_atomic_t nftrace_dump_request;
+
+extern bool NFTraceInit(void);
+extern void NFTraceExit(void);
+extern int32 NFTraceCall(NF_Base *obj, unsigned int idx, uint32 fncode);
+
+extern void NFTraceEnable(bool enable);
+extern void NFTraceReset(void);
+extern void NFTraceDump(FILE *f);
+
+#endif /* NFTRACE_H */
@@ -69,6 +69,7 @@ typedef struct {
 } bx_aranymfs_drive_t;
 typedef struct {
 	char symlinks[20];
+	bool buffered;
 	bx_aranymfs_drive_t drive[HOSTFS_MAX_DRIVES];
 } bx_aranymfs_options_t;
 
@@ -186,6 +187,22 @@ typedef struct {
 	int32	eps_max;		/* Maximum tolerated eps before shutdown */
 } bx_cpu_options_t;
 
+// Guest code profiler options
+typedef struct {
+	bool	enabled;		/* Sample the guest PC while running ? */
+	int32	rate;			/* Samples per second */
+	char	output[512];	/* File written on exit */
+	char	format[16];		/* "collapsed" or "histogram" */
+	char	symbols[512];	/* nm style symbol file */
+} bx_profiler_options_t;
+
+// NatFeat call statistics options
+typedef struct {
+	bool	enabled;		/* Collect call statistics from the start ? */
+	char	output[512];	/* Statistics written on exit, stderr if empty */
+	char	tracefile[512];	/* Binary record of every call, none if empty */
+} bx_nftrace_options_t;
+
 // Autozoom options
 typedef struct {
   bool enabled;		// Autozoom enabled
@@ -200,6 +217,8 @@ typedef struct {
 	uint32 channel_size;    /* If using libOSMesa[16|32], size of channel */
 	char libgl[1024];		/* Pathname to libGL */
 	char libosmesa[1024];	/* Pathname to libOSMesa */
+	bool direct_render;		/* Render straight into atari memory when possible */
+	bool threaded;			/* Run the GL calls of OSMesa contexts on threads */
 } bx_nfosmesa_options_t;
 
 // NatFeats options
@@ -207,11 +226,13 @@ typedef struct {
 	char cdrom_driver[256];	/* CD-ROM driver */
 	char vdi_driver[256];	/* VDI driver */
 	bool hostexec_enabled;
+	char ring_dir[512];		/* Directory of the NF_RING sockets */
 } bx_natfeat_options_t;
 
 // NFvdi options
 typedef struct {
 	bool use_host_mouse_cursor; /* Use host mouse cursor */
+	int blit_cache;			/* MB of converted guest bitmaps kept, 0 = off */
 } bx_nfvdi_options_t;
 
 // Parallel port options
@@ -305,6 +326,8 @@ typedef struct {
   bx_ikbd_options_t		ikbd;
   bx_nfcdrom_options_t	nfcdroms[ CD_MAX_DRIVES ];
   bx_cpu_options_t  cpu;
+  bx_profiler_options_t	profiler;
+  bx_nftrace_options_t	nftrace;
   bx_autozoom_options_t	autozoom;
   bx_nfosmesa_options_t	osmesa;
   bx_parallel_options_t parallel;
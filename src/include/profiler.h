@@ -0,0 +1,41 @@
+/*
+ * profiler.h - sampling profiler for guest code
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "sysdeps.h"
+
+/*
+ * A host timer raises SPCFLAG_PROFILE at the configured rate; the CPU
+ * thread then records the guest PC in m68k_do_specialties(). This works
+ * for the interpreter and for compiled code alike, as the JIT leaves a
+ * block whenever a special flag is set; with the JIT samples therefore
+ * have block granularity.
+ */
+
+extern bool ProfilerInit(void);
+extern void ProfilerExit(void);
+extern void ProfilerSample(uaecptr pc, bool super, bool stopped);
+
+#endif /* PROFILER_H */
@@ -26,6 +26,9 @@
 #include "sysdeps.h"
 
 # include <map>
+# include <vector>
+# include <cstdio>
+# include <cstdlib>
 
 
 // minimun and maximum macros
@@ -93,62 +96,155 @@ extern "C" {
  *
  * Also the filedescriptor number is int (which is not always 32bit)
  * and therefore we need to handle them this way.
+ *
+ * The 32bit values are handles into a table of slots: the low SLOT_BITS
+ * are the slot index + 1, the rest is the generation of the slot, which
+ * is bumped whenever the slot is freed. A handle kept by the emulated
+ * side after its value was removed therefore maps to nativeType()
+ * instead of to whatever reuses the slot. Handle 0 is never issued.
+ *
+ * The way back (native -> handle) is an open addressing hash table.
+ * Both directions are O(1) and no memory is allocated per entry.
  */
 template <class nativeType>
 class NativeTypeMapper
 {
-	std::map<uint32,nativeType> a2n;
-	std::map<nativeType,uint32> n2a;
+	static const int SLOT_BITS = 20;
+	static const uint32 SLOT_MASK = (1UL << SLOT_BITS) - 1;
+
+	// hash bucket states (other values are slot indices)
+	static const uint32 EMPTY = 0xffffffffUL;
+	static const uint32 DELETED = 0xfffffffeUL;
+
+	struct Slot {
+		nativeType value;
+		uint32     handle;	// current handle, 0 when free
+		uint32     nextFree;
+	};
+
+	std::vector<Slot> slots;
+	uint32 freeSlot;		// first free slot + 1, or 0
+	std::vector<uint32> buckets;	// native value -> slot index
+	uint32 used;			// buckets that are not EMPTY
+	uint32 count;			// values mapped
+
+	static uint32 hash( nativeType value ) {
+		uint64 x = (uint64)(uintptr)value;
+		x ^= x >> 29;
+		x *= 0x9e3779b97f4a7c15ULL;
+		return (uint32)(x >> 32);
+	}
+
+	// bucket of value, or the one to put it into when not present
+	uint32 findBucket( nativeType value ) const {
+		uint32 mask = buckets.size() - 1;
+		uint32 i = hash( value ) & mask;
+		uint32 insertAt = EMPTY;
+		for (;;) {
+			uint32 b = buckets[i];
+			if ( b == EMPTY )
+				return insertAt != EMPTY ? insertAt : i;
+			if ( b == DELETED ) {
+				if ( insertAt == EMPTY )
+					insertAt = i;
+			} else if ( slots[b].value == value )
+				return i;
+			i = (i + 1) & mask;
+		}
+	}
+
+	void rehash( uint32 size ) {
+		std::vector<uint32> old;
+		old.swap( buckets );
+		buckets.assign( size, (uint32)EMPTY );
+		used = 0;
+		for ( size_t i = 0; i < old.size(); i++ )
+			if ( old[i] != EMPTY && old[i] != DELETED ) {
+				buckets[findBucket( slots[old[i]].value )] = old[i];
+				used++;
+			}
+	}
 
   public:
+	NativeTypeMapper() : freeSlot(0), used(0), count(0) {
+		buckets.assign( 64, (uint32)EMPTY );
+	}
+
 	void putNative( nativeType value ) {
 		// test if present
-		if ( n2a.find( value ) != n2a.end() )
+		uint32 b = findBucket( value );
+		if ( buckets[b] != EMPTY && buckets[b] != DELETED )
 			return;
 
-		// cast to the number (not a pointer) type
-		// of the same size as the void*. Then cut the lowest
-		// 32bits as the default hash value
-		uint32 aValue = (uintptr)value & 0xffffffffUL;
-
-#if DEBUG_FORCE_NON32BIT
-		// easier NativeTypeMapper functionality debugging
-		aValue &= 0x1fL;
-#endif
-		// make the aValue unique (test if present and increase if positive)
-		while ( a2n.find( aValue ) != a2n.end() ) {
-#if DEBUG_FORCE_NON32BIT
-			fprintf(stderr,"NTM: Conflicting mapping %x [%d]\n", aValue, a2n.size());
-#endif
-			aValue+=7;
+		uint32 index;
+		if ( freeSlot ) {
+			index = freeSlot - 1;
+			freeSlot = slots[index].nextFree;
+		} else {
+			index = slots.size();
+			if ( index >= SLOT_MASK ) {
+				fprintf(stderr, "NTM: out of handles [%u]\n", count);
+				abort();
+			}
+			Slot slot;
+			slot.handle = index + 1;
+			slots.push_back( slot );
 		}
 
+		Slot &slot = slots[index];
+		slot.value = value;
+		slot.handle = (slot.handle & ~SLOT_MASK) | (index + 1);
+		slot.nextFree = 0;
+
 #if DEBUG_FORCE_NON32BIT
-		fprintf(stderr,"NTM: mapping %x [%d]\n", aValue, a2n.size());
+		fprintf(stderr,"NTM: mapping %x [%u]\n", slot.handle, count);
 #endif
-		// put the values into maps (both direction search possible)
-		a2n.insert( std::make_pair( aValue, value ) );
-		n2a.insert( std::make_pair( value, aValue ) );
+		if ( buckets[b] == EMPTY )
+			used++;
+		buckets[b] = index;
+		count++;
+
+		// keep at least a quarter of the buckets empty
+		if ( used * 4 >= buckets.size() * 3 )
+			rehash( count * 2 >= buckets.size() / 2 ? buckets.size() * 2 : buckets.size() );
 	}
 
 	void removeNative( nativeType value ) {
-		typename std::map<nativeType,uint32>::iterator it = n2a.find( value );
+		uint32 b = findBucket( value );
 
 		// remove if present
-		if ( it != n2a.end() ) {
-			// remove the 32bit -> native mapping
-			a2n.erase( it->second );
-			// and now the native -> 32bit
-			n2a.erase( value );
-		}
+		if ( buckets[b] == EMPTY || buckets[b] == DELETED )
+			return;
+
+		uint32 index = buckets[b];
+		buckets[b] = DELETED;
+
+		Slot &slot = slots[index];
+		slot.value = nativeType();
+		// next generation, so that the old handle goes stale
+		slot.handle = (slot.handle + (1UL << SLOT_BITS)) & ~SLOT_MASK;
+		slot.nextFree = freeSlot;
+		freeSlot = index + 1;
+		count--;
 	}
 
-	nativeType getNative( uint32 from ) {
-		return a2n.find( from )->second;
+	nativeType getNative( uint32 from ) const {
+		uint32 index = (from & SLOT_MASK) - 1;
+		if ( index >= slots.size() || slots[index].handle != from ) {
+#if DEBUG_FORCE_NON32BIT
+			if ( from )
+				fprintf(stderr,"NTM: stale handle %x\n", from);
+#endif
+			return nativeType();
+		}
+		return slots[index].value;
 	}
 
-	uint32 get32bit( nativeType from ) {
-		return n2a.find( from )->second;
+	uint32 get32bit( nativeType from ) const {
+		uint32 b = buckets[findBucket( from )];
+		if ( b == EMPTY || b == DELETED )
+			return 0;
+		return slots[b].handle;
 	}
 };
 
@@ -38,6 +38,8 @@
 #include "bootos_linux.h"
 #include "aranym_exception.h"
 #include "disasm-glue.h"
+#include "profiler.h"
+#include "nftrace.h"
 
 #define DEBUG 0
 #include "debug.h"
@@ -410,6 +412,12 @@ bool InitAll(void)
 	if (!Init680x0())
 		return false;
 
+	if (!ProfilerInit())
+		return false;
+
+	if (!NFTraceInit())
+		return false;
+
 #ifdef DEBUGGER
 	if (bx_options.startup.debugger && !startupGUI) {
 		D(bug("Activate debugger..."));
@@ -495,6 +503,9 @@ void ExitAll(void)
 
 	InputExit();
 
+	ProfilerExit();
+	NFTraceExit();
+
 	// Exit Time Manager
 	KillRTCTimer();
 	if (my_timer_id) {
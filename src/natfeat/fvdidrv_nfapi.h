@@ -34,12 +34,23 @@ enum {
 	FVDI_CLOSEWK = 16,
 	FVDI_GETBPP = 17,
 	FVDI_EVENT = 18,
-	FVDI_TEXT_AREA = 19
+	FVDI_TEXT_AREA = 19,
+	FVDI_BATCH = 21		/* optional, probed for with a count of 0 */
 #if 0
 	, FVDI_GETCOMPONENT = 20
 #endif
 };
 
+/* FVDI_BATCH(commands*, count) runs count drawing calls in one go,
+   each a word function code, a word parameter count and then the
+   longword parameters of the call. Only PUT_PIXEL, EXPAND_AREA,
+   FILL_AREA, BLIT_AREA, LINE, FILL_POLYGON and TEXT_AREA may be
+   batched. The calls are done in order until one of them does not
+   return 1; the result is the number of calls done. The caller then
+   has to repeat that call alone to get its result, e.g. the request
+   for a fallback, and submit the remaining ones again. */
+#define FVDI_BATCH_MAX_PARAMS	16
+
 extern unsigned long nfFvdiDrvId;
 
 #endif /* _FVDIDRV_NFAPI_H */
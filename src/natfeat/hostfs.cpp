@@ -32,6 +32,8 @@
 #include "host_filesys.h"
 #include "toserror.h"
 #include "hostfs.h"
+#include "hostfs_filebuf.h"
+#include "nf_async.h"
 #include "tools.h"
 #include "win32_supp.h"
 
@@ -262,6 +264,23 @@ int32 HostFs::dispatch(uint32 fncode)
 
     D(bug("HOSTFS: calling %d", fncode));
 
+	// calls by path have to see the data still in the file buffers
+	switch (fncode) {
+		case DEV_WRITE:
+		case DEV_READ:
+		case DEV_LSEEK:
+		case DEV_IOCTL:
+		case DEV_DATIME:
+		case DEV_CLOSE:
+		case DEV_SELECT:
+		case DEV_UNSELECT:
+		case DEV_WRITE_ASYNC:
+		case DEV_READ_ASYNC:
+			break;
+		default:
+			flushFileBuffers();
+	}
+
     int32 ret = 0;
     switch (fncode) {
     	case GET_VERSION:
@@ -434,6 +453,17 @@ int32 HostFs::dispatch(uint32 fncode)
 			flushXFSD( &dirh, getParameter(0) );
 			break;
 
+		case XFS_READDIRX:
+			D(bug("%s", "fs_readdirx"));
+			fetchXFSD( &dirh, getParameter(0) );
+			ret = xfs_readdirx( &dirh,
+								(memptr)getParameter(1) /* buff */,
+								getParameter(2) /* size */,
+								getParameter(3) /* position */,
+								getParameter(4) != 0 /* stat64 */ );
+			flushXFSD( &dirh, getParameter(0) );
+			break;
+
 		case XFS_CLOSEDIR:
 			D(bug("%s", "fs_closedir"));
 			fetchXFSD( &dirh, getParameter(0) );
@@ -545,20 +575,25 @@ int32 HostFs::dispatch(uint32 fncode)
 			fetchXFSF( &extFile, getParameter(0) );
 			ret = xfs_dev_open( &extFile );
 			flushXFSF( &extFile, getParameter(0) );
+			if ( flagsMint2Host(extFile.flags) & (O_CREAT|O_TRUNC) )
+				invalidateStat( &extFile.fc );
 			break;
 
 		case DEV_WRITE:
 			D(bug("%s", "fs_dev_write"));
 			fetchXFSF( &extFile, getParameter(0) );
+			drainAsync( fdChannel( extFile.hostFd ) );
 			ret = xfs_dev_write( &extFile,
 								 (memptr)getParameter(1) /* buffer */,
 								 getParameter(2) /* bytes */ );
 			flushXFSF( &extFile, getParameter(0) );
+			invalidateStat( &extFile.fc );
 			break;
 
 		case DEV_READ:
 			D(bug("%s", "fs_dev_read"));
 			fetchXFSF( &extFile, getParameter(0) );
+			drainAsync( fdChannel( extFile.hostFd ) );
 			ret = xfs_dev_read( &extFile,
 								(memptr)getParameter(1) /* buffer */,
 								getParameter(2) /* bytes */ );
@@ -568,6 +603,7 @@ int32 HostFs::dispatch(uint32 fncode)
 		case DEV_LSEEK:
 			D(bug("%s", "fs_dev_lseek"));
 			fetchXFSF( &extFile, getParameter(0) );
+			drainAsync( fdChannel( extFile.hostFd ) );
 			ret = xfs_dev_lseek( &extFile,
 								 getParameter(1),		  // offset
 								 getParameter(2) );		  // seekmode
@@ -576,25 +612,39 @@ int32 HostFs::dispatch(uint32 fncode)
 
 		case DEV_IOCTL:
 			fetchXFSF( &extFile, getParameter(0) );
+			drainAsync( fdChannel( extFile.hostFd ) );
+			releaseFileBuffer( extFile.hostFd );
 			D(bug("fs_dev_ioctl '%c'<<8|%d", (getParameter(1)>>8)&0xff ? (char)(getParameter(1)>>8)&0xff : 0x20, (char)(getParameter(1)&0xff)));
 			ret = xfs_dev_ioctl(&extFile, getParameter(1), (memptr)getParameter(2));
 			flushXFSF( &extFile, getParameter(0) );
+			invalidateStat( &extFile.fc );
 			break;
 
 		case DEV_DATIME:
 			D(bug("%s", "fs_dev_datime"));
 			fetchXFSF( &extFile, getParameter(0) );
+			drainAsync( fdChannel( extFile.hostFd ) );
+			releaseFileBuffer( extFile.hostFd );
 			ret = xfs_dev_datime( &extFile,
 								  (memptr)getParameter(1), // datetimep
 								  getParameter(2) );// wflag
 			flushXFSF( &extFile, getParameter(0) );
+			if ( getParameter(2) )
+				invalidateStat( &extFile.fc );
 			break;
 
 		case DEV_CLOSE:
 			D(bug("%s", "fs_dev_close"));
 			fetchXFSF( &extFile, getParameter(0) );
-			ret = xfs_dev_close( &extFile,
-								 0 ); // pid
+			drainAsync( fdChannel( extFile.hostFd ) );
+			{
+				// report the failure of a delayed write
+				int32 flushRet = releaseFileBuffer( extFile.hostFd );
+				ret = xfs_dev_close( &extFile,
+									 0 ); // pid
+				if ( ret == TOS_E_OK )
+					ret = flushRet;
+			}
 			flushXFSF( &extFile, getParameter(0) );
 			break;
 
@@ -610,13 +660,124 @@ int32 HostFs::dispatch(uint32 fncode)
 			ret = TOS_E_OK;
 			break;
 
+		case DEV_WRITE_ASYNC:
+		case DEV_READ_ASYNC:
+			D(bug("%s", fncode == DEV_WRITE_ASYNC ? "fs_dev_write_async" : "fs_dev_read_async"));
+			fetchXFSF( &extFile, getParameter(0) );
+			releaseFileBuffer( extFile.hostFd );
+			ret = xfs_dev_rw_async( &extFile,
+									(memptr)getParameter(1) /* buffer */,
+									getParameter(2) /* bytes */,
+									fncode == DEV_WRITE_ASYNC );
+			break;
+
 		default:
 			panicbug("Unknown HOSTFS subID %d", fncode);
 			ret = TOS_EINVFN;
 	}
+
+	// the inotify watcher would notice our own changes too late
+	switch (fncode) {
+		case XFS_CREATE:
+		case XFS_CHATTR:
+		case XFS_CHMOD:
+		case XFS_MKDIR:
+		case XFS_RMDIR:
+		case XFS_REMOVE:
+		case XFS_RENAME:
+		case XFS_WRITELABEL:
+		case XFS_SYMLINK:
+		case XFS_HARDLINK:
+		case XFS_FSCNTL:
+		case XFS_MKNOD:
+			statCache.flush();
+			break;
+	}
+
 	return ret;
 }
 
+/*
+ * The buffer of a host file, created on its first read or write.
+ */
+HostFileBuffer *HostFs::getFileBuffer( int fd, bool writing )
+{
+	if ( !bx_options.aranymfs.buffered )
+		return NULL;
+
+	FileBufferMap::iterator it = fileBuffers.find( fd );
+	HostFileBuffer *fb;
+	if ( it != fileBuffers.end() )
+		fb = it->second;
+	else
+		fb = fileBuffers[fd] = HostFileBuffer::create( fd );
+
+	// keep the other descriptors of the same file coherent
+	if ( fb && fileBuffers.size() > 1 ) {
+		for ( it = fileBuffers.begin(); it != fileBuffers.end(); ++it ) {
+			HostFileBuffer *other = it->second;
+			if ( other && other != fb && other->isFile( fb->getDev(), fb->getIno() ) ) {
+				other->flush();
+				if ( writing )
+					other->invalidate();
+			}
+		}
+	}
+
+	return fb;
+}
+
+/*
+ * Drop the buffer of a host file, before its descriptor is used otherwise.
+ */
+int32 HostFs::releaseFileBuffer( int fd )
+{
+	FileBufferMap::iterator it = fileBuffers.find( fd );
+	if ( it == fileBuffers.end() )
+		return TOS_E_OK;
+
+	HostFileBuffer *fb = it->second;
+	fileBuffers.erase( it );
+	if ( fb == NULL )
+		return TOS_E_OK;
+
+	int res = fb->release();
+	int err = errno;
+	delete fb;
+
+	return res ? errnoHost2Mint(err,TOS_EIO) : TOS_E_OK;
+}
+
+/*
+ * Write out all pending data, and forget what was read ahead,
+ * as the call may change any file.
+ */
+void HostFs::flushFileBuffers()
+{
+	for ( FileBufferMap::iterator it = fileBuffers.begin(); it != fileBuffers.end(); ++it ) {
+		if ( it->second ) {
+			it->second->flush();
+			it->second->invalidate();
+		}
+	}
+}
+
+void HostFs::freeFileBuffers()
+{
+	while ( !fileBuffers.empty() )
+		releaseFileBuffer( fileBuffers.begin()->first );
+}
+
+void HostFs::invalidateStat( XfsCookie *fc )
+{
+	if ( !fc->drv || !fc->index )
+		return;
+
+	char fpathName[MAXPATHNAMELEN];
+	cookie2Pathname( fc, NULL, fpathName );
+	statCache.invalidate( fpathName );
+}
+
 void HostFs::fetchXFSC( XfsCookie *fc, memptr filep )
 {
 	fc->xfs	  = ReadInt32( filep );	 // fs
@@ -1016,6 +1177,83 @@ void HostFs::transformFileName( char* dest, const char* source )
 }
 
 
+/*
+ * Get the name index of a host directory, (re)building it if the directory
+ * changed since. A directory modified in the same second the index was
+ * built might have changed unnoticed, so its index is rebuilt until the
+ * mtime is older than the index.
+ */
+HostFs::DirNameCache *HostFs::getDirNameCache( const char *pathName )
+{
+	struct stat statBuf;
+
+	if ( stat( pathName, &statBuf ) )
+		return NULL;
+
+	DirCacheMap::iterator it = dirCache.find( pathName );
+	DirNameCache *dc = ( it != dirCache.end() ) ? it->second : NULL;
+	if ( dc && dc->dev == statBuf.st_dev && dc->ino == statBuf.st_ino &&
+		 dc->mtime == statBuf.st_mtime && dc->mtime < dc->built )
+	{
+		DFNAME(bug("HOSTFS: getDirNameCache(%s) hit", pathName));
+		dc->lastUse = ++dirCacheClock;
+		return dc;
+	}
+
+	DIR *dh = host_opendir( pathName );
+	if ( dh == NULL ) {
+		DFNAME(bug("HOSTFS: getDirNameCache dopendir(%s) failed.", pathName));
+		return NULL;
+	}
+
+	if ( dc == NULL ) {
+		// make room for the new one
+		if ( dirCache.size() >= DIRCACHE_SIZE ) {
+			DirCacheMap::iterator oldest = dirCache.begin();
+			for( it = dirCache.begin(); it != dirCache.end(); ++it )
+				if ( it->second->lastUse < oldest->second->lastUse )
+					oldest = it;
+			delete oldest->second;
+			dirCache.erase( oldest );
+		}
+		dc = new DirNameCache;
+		dirCache[ pathName ] = dc;
+	}
+	dc->caseNames.clear();
+	dc->tosNames.clear();
+	dc->dev = statBuf.st_dev;
+	dc->ino = statBuf.st_ino;
+	dc->mtime = statBuf.st_mtime;
+	dc->built = time( NULL );
+	dc->lastUse = ++dirCacheClock;
+
+	DFNAME(bug("HOSTFS: getDirNameCache(%s) rebuild", pathName));
+
+	char testName[MAXPATHNAMELEN];
+	struct dirent *dirEntry;
+	while ( (dirEntry = readdir( dh )) != NULL ) {
+		std::string lowerName( dirEntry->d_name );
+		for( std::string::iterator c = lowerName.begin(); c != lowerName.end(); ++c )
+			*c = tolower( *c );
+		// insert() keeps the first one of several colliding entries
+		dc->caseNames.insert( std::make_pair( lowerName, dirEntry->d_name ) );
+
+		transformFileName( testName, dirEntry->d_name );
+		dc->tosNames.insert( std::make_pair( testName, dirEntry->d_name ) );
+	}
+	closedir( dh );
+
+	return dc;
+}
+
+void HostFs::freeDirCache()
+{
+	for( DirCacheMap::iterator it = dirCache.begin(); it != dirCache.end(); ++it )
+		delete it->second;
+	dirCache.clear();
+	dirCacheClock = 0;
+}
+
 bool HostFs::getHostFileName( char* result, ExtDrive* drv, const char* pathName, const char* name )
 {
 	struct stat statBuf;
@@ -1027,52 +1265,46 @@ bool HostFs::getHostFileName( char* result, ExtDrive* drv, const char* pathName,
 	strcpy( result, name );
 
 	if ( ! strpbrk( name, "*?" ) && // if is it NOT a mask
-		 stat(pathName, &statBuf) ) // and if such file NOT really exists
+		 statCache.stat(pathName, &statBuf) ) // and if such file NOT really exists
 	{
 		// the TOS filename was adjusted (lettercase, length, ..)
-		char testName[MAXPATHNAMELEN];
 		const char *finalName = name;
-		struct dirent *dirEntry;
 		bool nonexisting = false;
+		std::map<std::string,std::string>::const_iterator it;
 
 		DFNAME(bug(" (stat failed)"));
 
 		// shorten the name from the pathName;
 		*result = '\0';
 
-		DIR *dh = host_opendir( pathName );
-		if ( dh == NULL ) {
-			DFNAME(bug("HOSTFS: getHostFileName dopendir(%s) failed.", pathName));
+		DirNameCache *dc = getDirNameCache( pathName );
+		if ( dc == NULL )
 			goto lbl_final;	 // should never happen
-		}
 
-		while ( true ) {
-			if ((dirEntry = readdir( dh )) == NULL) {
-				DFNAME(bug("HOSTFS: getHostFileName dreaddir: no more files."));
-				nonexisting = true;
+		if ( !drv || drv->halfSensitive ) {
+			std::string lowerName( name );
+			for( std::string::iterator c = lowerName.begin(); c != lowerName.end(); ++c )
+				*c = tolower( *c );
+			it = dc->caseNames.find( lowerName );
+			if ( it != dc->caseNames.end() ) {
+				finalName = it->second.c_str();
+				DFNAME(bug("HOSTFS: getHostFileName found final file."));
 				goto lbl_final;
 			}
+		}
 
-			if ( !drv || drv->halfSensitive )
-				if ( ! strcasecmp( name, dirEntry->d_name ) ) {
-					finalName = dirEntry->d_name;
-					DFNAME(bug("HOSTFS: getHostFileName found final file."));
-					goto lbl_final;
-				}
-
-			transformFileName( testName, dirEntry->d_name );
-
-			DFNAME(bug("HOSTFS: getHostFileName (%s,%s,%s)", name, testName, dirEntry->d_name));
-
-			if ( ! strcmp( testName, name ) ) {
-				// FIXME isFile test (maybe?)
-				// this follows one more argument to be passed
+		it = dc->tosNames.find( name );
+		if ( it != dc->tosNames.end() ) {
+			// FIXME isFile test (maybe?)
+			// this follows one more argument to be passed
 
-				finalName = dirEntry->d_name;
-				goto lbl_final;
-			}
+			finalName = it->second.c_str();
+			goto lbl_final;
 		}
 
+		DFNAME(bug("HOSTFS: getHostFileName: no such file."));
+		nonexisting = true;
+
 	lbl_final:
 		DFNAME(bug("HOSTFS: getHostFileName final (%s,%s)", name, finalName));
 
@@ -1093,8 +1325,6 @@ bool HostFs::getHostFileName( char* result, ExtDrive* drv, const char* pathName,
 				strapply( result, strapply_tolower );
 			}
 		}
-		if ( dh != NULL )
-			closedir( dh );
 	}
 	else {
 		DFNAME(bug(" (stat OK)"));
@@ -1403,11 +1633,30 @@ int32 HostFs::xfs_dev_read(ExtFile *fp, memptr buffer, uint32 count)
 	ssize_t toRead = count;
 	ssize_t toReadNow;
 
+	uint8 *hostBuff = NULL;
+
 	D(bug("HOSTFS:  dev_read (fd = %d, %d)", fp->hostFd, count));
 
+	HostFileBuffer *fb = getFileBuffer( fp->hostFd, false );
+
+#if NATFEAT_LIBC_MEMCPY && NATFEAT_PHYS_ADDR
+	// read straight into the guest buffer if it is all plain RAM
+	hostBuff = Atari2HostBlock( buffer, count, true );
+#endif
+
 	while ( toRead > 0 ) {
+		if ( hostBuff != NULL ) {
+			readCount = fb ? fb->read( hostBuff, toRead ) : read( fp->hostFd, hostBuff, toRead );
+			if ( readCount <= 0 )
+				break;
+
+			hostBuff += readCount;
+			toRead -= readCount;
+			continue;
+		}
+
 		toReadNow = ( toRead > FRDWR_BUFFER_LENGTH ) ? FRDWR_BUFFER_LENGTH : toRead;
-		readCount = read( fp->hostFd, fBuff, toReadNow );
+		readCount = fb ? fb->read( fBuff, toReadNow ) : read( fp->hostFd, fBuff, toReadNow );
 		if ( readCount <= 0 )
 			break;
 
@@ -1432,12 +1681,31 @@ int32 HostFs::xfs_dev_write(ExtFile *fp, memptr buffer, uint32 count)
 	ssize_t toWriteNow;
 	ssize_t writeCount = 0;
 
+	const uint8 *hostBuff = NULL;
+
 	D(bug("HOSTFS:  dev_write (fd = %d, %d)", fp->hostFd, count));
 
+	HostFileBuffer *fb = getFileBuffer( fp->hostFd, true );
+
+#if NATFEAT_LIBC_MEMCPY && NATFEAT_PHYS_ADDR
+	// write straight from the guest buffer if it is all plain RAM
+	hostBuff = Atari2HostBlock( buffer, count, false );
+#endif
+
 	while ( toWrite > 0 ) {
+		if ( hostBuff != NULL ) {
+			writeCount = fb ? fb->write( hostBuff, toWrite ) : write( fp->hostFd, hostBuff, toWrite );
+			if ( writeCount <= 0 )
+				break;
+
+			hostBuff += writeCount;
+			toWrite -= writeCount;
+			continue;
+		}
+
 		toWriteNow = ( toWrite > FRDWR_BUFFER_LENGTH ) ? FRDWR_BUFFER_LENGTH : toWrite;
 		Atari2Host_memcpy( fBuff, sourceBuff, toWriteNow );
-		writeCount = write( fp->hostFd, fBuff, toWriteNow );
+		writeCount = fb ? fb->write( fBuff, toWriteNow ) : write( fp->hostFd, fBuff, toWriteNow );
 		if ( writeCount <= 0 )
 			break;
 
@@ -1453,6 +1721,98 @@ int32 HostFs::xfs_dev_write(ExtFile *fp, memptr buffer, uint32 count)
 }
 
 
+/*
+ * A DEV_READ or DEV_WRITE run on a worker thread. It uses the host file
+ * position from when it was submitted, and the position is advanced by
+ * the full count right away, so that the guest can queue the next
+ * transfer; on a short transfer complete() moves it back.
+ */
+class HostFs::AsyncIO : public NFAsyncJob
+{
+	HostFs *fs;
+	int fd;
+	XfsCookie fc;
+	bool writing;
+	uint8 *hostBuff;
+	uint32 count;
+	off_t offset;
+	int err;
+
+  public:
+	AsyncIO( HostFs *_fs, ExtFile *fp, bool _writing, uint8 *_hostBuff, uint32 _count, off_t _offset )
+		: NFAsyncJob( _fs->fdChannel( fp->hostFd ) ), fs(_fs), fd(fp->hostFd), fc(fp->fc),
+		  writing(_writing), hostBuff(_hostBuff), count(_count), offset(_offset), err(0)
+	{
+	}
+
+	int32 run()
+	{
+		uint32 done = 0;
+
+		while ( done < count ) {
+			ssize_t res;
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+			if ( writing )
+				res = pwrite( fd, hostBuff + done, count - done, offset + done );
+			else
+				res = pread( fd, hostBuff + done, count - done, offset + done );
+#else
+			res = -1;
+			errno = ENOSYS;
+#endif
+			if ( res <= 0 ) {
+				if ( res < 0 )
+					err = errno;
+				break;
+			}
+			done += res;
+		}
+		return done;
+	}
+
+	int32 complete( int32 res )
+	{
+		D(bug("HOSTFS: /dev_%s_async (fd = %d, %d)", writing ? "write" : "read", fd, res));
+
+		if ( (uint32)res < count && lseek( fd, 0, SEEK_CUR ) == offset + (off_t)count )
+			lseek( fd, offset + res, SEEK_SET );
+		if ( writing )
+			fs->invalidateStat( &fc );
+		if ( err )
+			return fs->errnoHost2Mint( err, TOS_EINTRN );
+		return res;
+	}
+};
+
+int32 HostFs::xfs_dev_rw_async(ExtFile *fp, memptr buffer, uint32 count, bool writing)
+{
+	D(bug("HOSTFS:  dev_%s_async (fd = %d, %d)", writing ? "write" : "read", fp->hostFd, count));
+
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE) && NATFEAT_LIBC_MEMCPY && NATFEAT_PHYS_ADDR
+	// the worker can't access the guest memory through the CPU
+	uint8 *hostBuff = Atari2HostBlock( buffer, count, !writing );
+	if ( hostBuff == NULL || count == 0 || count > 0x7fffffff )
+		return TOS_ENOSYS;
+
+	// appends and pipes have no position to hand over to the job
+	off_t offset = lseek( fp->hostFd, 0, SEEK_CUR );
+	if ( offset < 0 || ( writing && ( fcntl( fp->hostFd, F_GETFL ) & O_APPEND ) ) )
+		return TOS_ENOSYS;
+
+	int32 ticket = submitAsync( new AsyncIO( this, fp, writing, hostBuff, count, offset ) );
+	if ( ticket > 0 )
+		lseek( fp->hostFd, offset + count, SEEK_SET );
+	return ticket;
+#else
+	DUNUSED(fp);
+	DUNUSED(buffer);
+	DUNUSED(count);
+	DUNUSED(writing);
+	return TOS_ENOSYS;
+#endif
+}
+
+
 int32 HostFs::xfs_dev_lseek(ExtFile *fp, int32 offset, int16 seekmode)
 {
 	int whence;
@@ -1466,6 +1826,21 @@ int32 HostFs::xfs_dev_lseek(ExtFile *fp, int32 offset, int16 seekmode)
 		default: return TOS_EINVFN;
 	}
 
+	FileBufferMap::iterator it = fileBuffers.find( fp->hostFd );
+	if ( it != fileBuffers.end() && it->second != NULL ) {
+		if ( whence != SEEK_END ) {
+			HostFileBuffer *fb = it->second;
+			off_t bufoff = ( whence == SEEK_SET ? 0 : fb->tell() ) + offset;
+			if ( fb->seek( bufoff ) != 0 )
+				return errnoHost2Mint(errno,TOS_EIO);
+			return bufoff;
+		}
+		// the size of the file is the host's business
+		int32 res = releaseFileBuffer( fp->hostFd );
+		if ( res != TOS_E_OK )
+			return res;
+	}
+
 	off_t newoff = lseek( fp->hostFd, offset, whence);
 
 	D(bug("HOSTFS: /dev_lseek (offset = %d,mode = %d,resoffset = %d)", offset, seekmode, (int32)newoff));
@@ -1862,6 +2237,7 @@ int32 HostFs::xfs_opendir( XfsDir *dirh, uint16 flags )
 	dirh->hostDir = host_opendir( fpathName );
 	if ( dirh->hostDir == NULL )
 		return errnoHost2Mint(errno,TOS_EPTHNF);
+	readdirxMarks.erase( dirh->hostDir );
 
 	return TOS_E_OK;
 }
@@ -1870,6 +2246,7 @@ int32 HostFs::xfs_opendir( XfsDir *dirh, uint16 flags )
 
 int32 HostFs::xfs_closedir( XfsDir *dirh )
 {
+	readdirxMarks.erase( dirh->hostDir );
 	if ( closedir( dirh->hostDir ) )
 		return errnoHost2Mint(errno,TOS_EPTHNF);
 
@@ -1877,6 +2254,22 @@ int32 HostFs::xfs_closedir( XfsDir *dirh )
 }
 
 
+struct dirent *HostFs::host_readdir( XfsDir *dirh )
+{
+	struct dirent *dirEntry;
+
+	// the root directory has no "." and ".." entries in MiNT
+	do {
+		if ((void*)(dirEntry = readdir( dirh->hostDir )) == NULL)
+			return NULL;
+	} while ( !dirh->fc.index->parent &&
+			  ( dirEntry->d_name[0] == '.' &&
+				( !dirEntry->d_name[1] ||
+				  ( dirEntry->d_name[1] == '.' && !dirEntry->d_name[2] ) ) ) );
+
+	return dirEntry;
+}
+
 int32 HostFs::xfs_readdir( XfsDir *dirh, memptr buff, int16 len, XfsCookie *fc )
 {
 	struct dirent *dirEntry;
@@ -1888,13 +2281,8 @@ int32 HostFs::xfs_readdir( XfsDir *dirh, memptr buff, int16 len, XfsCookie *fc )
 	fc->aux = 0;
 	fc->index = 0;
 
-	do {
-		if ((void*)(dirEntry = readdir( dirh->hostDir )) == NULL)
-			return TOS_ENMFIL;
-	} while ( !dirh->fc.index->parent &&
-			  ( dirEntry->d_name[0] == '.' &&
-				( !dirEntry->d_name[1] ||
-				  ( dirEntry->d_name[1] == '.' && !dirEntry->d_name[2] ) ) ) );
+	if ((dirEntry = host_readdir( dirh )) == NULL)
+		return TOS_ENMFIL;
 
 	XfsFsFile *newFsFile = new XfsFsFile();
 	newFsFile->name = strdup( dirEntry->d_name );
@@ -1958,27 +2346,132 @@ int32 HostFs::xfs_rewinddir( XfsDir *dirh )
 	return TOS_E_OK;
 }
 
-#ifdef __CYGWIN__
-static int cyg_lstat(const char *fpathName, struct stat *statBuf)
+/*
+ * Bulk xfs_readdir() + xfs_getxattr()/xfs_stat64() for Dxreaddir()
+ * and Fsnext() loops. Fills buff with as many records as fit:
+ *
+ *   uint16 reclen    length of the whole record, always even
+ *   uint16 reserved
+ *   int32  xret      result of the stat for this entry
+ *   XATTR or STAT    52 or 128 bytes, no links followed
+ *   char   name[]    as xfs_readdir() would return it, NUL terminated
+ *
+ * No cookies are created; the caller looks a name up when it needs one.
+ * With position >= 0 the directory is first set back to that entry
+ * index, so that the caller can give back records it did not consume.
+ * Without a size that is all. Returns the number of records, or ENMFIL
+ * at the end.
+ */
+#if defined(HAVE_FSTATAT) && defined(HAVE_DIRFD) && defined(AT_SYMLINK_NOFOLLOW) && !defined(__CYGWIN__)
+#define READDIRX_FSTATAT 1
+#endif
+
+int32 HostFs::xfs_readdirx( XfsDir *dirh, memptr buff, uint32 size, int32 position, bool stat64 )
 {
-	char path[1024];
+	D(bug("HOSTFS: fs_readdirx (%d bytes, pos %d)", size, position));
 
-	/*
-	 * Be sure to use a posix path for the actual stat call,
-	 * otherwise cygwin does not translate all attributes.
-	 * Should fix #22.
-	 */
-	safe_strncpy(path, fpathName, sizeof(path));
-	return lstat(cygwin_path_to_posix(path, sizeof(path)), statBuf);
-}
+	ReaddirxMarks &marks = readdirxMarks[dirh->hostDir];
+	if ( position >= 0 ) {
+		if ( position >= marks.first && position - marks.first < (int32)marks.pos.size() ) {
+			seekdir( dirh->hostDir, marks.pos[position - marks.first] );
+			dirh->index = position;
+		} else {
+			rewinddir( dirh->hostDir );
+			dirh->index = 0;
+			while ( dirh->index < position && host_readdir( dirh ) != NULL )
+				dirh->index++;
+		}
+	}
+	if ( size == 0 )
+		return 0;
+	marks.first = dirh->index;
+	marks.pos.clear();
+
+	char fpathName[MAXPATHNAMELEN];
+	cookie2Pathname(&dirh->fc, NULL, fpathName);
+	size_t pathLen = strlen( fpathName );
+	if ( pathLen > 0 && pathLen < sizeof(fpathName) - 1 && fpathName[pathLen-1] != *DIRSEPARATOR )
+		fpathName[pathLen++] = *DIRSEPARATOR;
+
+#ifdef READDIRX_FSTATAT
+	int dirFd = dirfd( dirh->hostDir );
+#endif
+
+	uint32 attrSize = stat64 ? 128 : 52;
+	uint32 used = 0;
+	int32 count = 0;
+	bool full = false;
+
+	for (;;) {
+		long hostPos = telldir( dirh->hostDir );
+		marks.pos.push_back( hostPos );
+		struct dirent *dirEntry = host_readdir( dirh );
+		if ( dirEntry == NULL )
+			break;
+
+		char truncFileName[MAXPATHNAMELEN];
+		const char *name = dirEntry->d_name;
+		uint32 nameOffs = 8 + attrSize;
+		if ( dirh->flags == 0 ) {
+			nameOffs += 4;
+		} else {
+			transformFileName( truncFileName, dirEntry->d_name );
+			name = truncFileName;
+		}
+
+		// the conversion to the Atari charset never makes a name longer
+		if ( used + nameOffs + strlen( name ) + 1 > size ) {
+			seekdir( dirh->hostDir, hostPos );
+			full = true;
+			break;
+		}
+
+		memptr rec = buff + used;
+		struct stat statBuf;
+		int32 xret;
+#ifdef READDIRX_FSTATAT
+		if ( fstatat( dirFd, dirEntry->d_name, &statBuf, AT_SYMLINK_NOFOLLOW ) )
+			xret = errnoHost2Mint(errno,TOS_EFILNF);
+		else
+			xret = TOS_E_OK;
 #else
-#define cyg_lstat lstat
+		safe_strncpy( fpathName + pathLen, dirEntry->d_name, sizeof(fpathName) - pathLen );
+		xret = host_stat64( &dirh->fc, fpathName, &statBuf );
 #endif
+		if ( xret == TOS_E_OK ) {
+			if ( stat64 )
+				convert_to_stat64( dirh->fc.drv, &statBuf, rec + 8 );
+			else
+				convert_to_xattr( dirh->fc.drv, &statBuf, rec + 8 );
+		}
+
+		if ( dirh->flags == 0 )
+			WriteInt32( rec + nameOffs - 4, dirEntry->d_ino );
+		Host2AtariUtf8Copy( rec + nameOffs, name, size - used - nameOffs );
+
+		uint32 reclen = nameOffs + Atari2HostSafeStrlen( rec + nameOffs );
+		reclen = (reclen + 1) & ~1;
+		WriteInt16( rec, reclen );
+		WriteInt16( rec + 2, 0 );
+		WriteInt32( rec + 4, xret );
+
+		used += reclen;
+		dirh->index++;
+		count++;
+	}
+
+	D(bug("HOSTFS: fs_readdirx %d entries, %d bytes", count, used));
+
+	if ( count == 0 && size > 0 )
+		return full ? TOS_ERANGE : TOS_ENMFIL;
+
+	return count;
+}
 
 int32 HostFs::host_stat64( XfsCookie *fc, const char *fpathName, struct stat *statBuf ) {
 
 	(void) fc;
-	if ( cyg_lstat(fpathName, statBuf) )
+	if ( statCache.lstat(fpathName, statBuf) )
 		return errnoHost2Mint(errno,TOS_EFILNF);
 
 	return TOS_E_OK;
@@ -2156,7 +2649,7 @@ int32 HostFs::xfs_chattr( XfsCookie *fc, int16 attr )
 
 	// perform the link stat itself
 	struct stat statBuf;
-    if ( cyg_lstat( fpathName, &statBuf ) )
+    if ( hostfs_lstat( fpathName, &statBuf ) )
 		return errnoHost2Mint( errno, TOS_EACCDN );
 
     mode_t newmode;
@@ -2317,7 +2810,7 @@ int32 HostFs::xfs_lookup( XfsCookie *dir, memptr name, XfsCookie *fc )
 		D(bug( "HOSTFS: fs_lookup stat: %s", fpathName ));
 
 		struct stat statBuf;
-		if ( cyg_lstat( fpathName, &statBuf ) ) {
+		if ( statCache.lstat( fpathName, &statBuf ) ) {
 			delete newFsFile;
 			return errnoHost2Mint( errno, TOS_EFILNF );
 		}
@@ -2999,16 +3492,22 @@ void HostFs::freeMounts()
 HostFs::HostFs()
 {
 	mounts.clear();
+	dirCacheClock = 0;
 }
 
 void HostFs::reset()
 {
+	freeFileBuffers();
 	freeMounts();
+	freeDirCache();
+	statCache.reset();
 }
 
 HostFs::~HostFs()
 {
+	freeFileBuffers();
 	freeMounts();
+	freeDirCache();
 }
 
 #endif /* HOSTFS_SUPPORT */
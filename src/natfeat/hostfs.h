@@ -29,8 +29,12 @@
 #include "nf_base.h"
 #include "tools.h"
 #include "win32_supp.h"
+#include "hostfs_statcache.h"
+#include "hostfs_filebuf.h"
 
 #include <map>
+#include <string>
+#include <vector>
 
 class HostFs : public NF_Base
 {
@@ -106,6 +110,43 @@ class HostFs : public NF_Base
 	typedef std::map<int16,ExtDrive*> MountMap;
 	MountMap mounts;
 
+	// name index of one host directory for getHostFileName()
+	struct DirNameCache {
+		dev_t     dev;
+		ino_t     ino;
+		time_t    mtime;        // directory mtime the index was built for
+		time_t    built;        // when the index was built
+		uint32    lastUse;
+
+		std::map<std::string,std::string> caseNames;  // lower case name -> host name
+		std::map<std::string,std::string> tosNames;   // 8+3 TOS name -> host name
+	};
+
+	// the number of directories indexed at once
+	static const unsigned int DIRCACHE_SIZE = 64;
+
+	typedef std::map<std::string,DirNameCache*> DirCacheMap;
+	DirCacheMap dirCache;
+	uint32 dirCacheClock;
+
+	// lstat() results of recently used host paths
+	HostStatCache statCache;
+
+	// telldir() of each record xfs_readdirx() last returned for a
+	// directory, starting with entry index first, so that records
+	// given back need a seekdir() instead of reading the directory
+	// again; the guest driver buffers one directory at a time
+	struct ReaddirxMarks {
+		int32 first;
+		std::vector<long> pos;
+	};
+	typedef std::map<DIR*,ReaddirxMarks> ReaddirxMarksMap;
+	ReaddirxMarksMap readdirxMarks;
+
+	// read-ahead/write-behind of the open files, by host fd (NULL if not buffered)
+	typedef std::map<int,HostFileBuffer*> FileBufferMap;
+	FileBufferMap fileBuffers;
+
 	#if SIZEOF_INT != 4 || DEBUG_NON32BIT
 		// host filedescriptor mapper
 		NativeTypeMapper<int> fdMapper;
@@ -115,6 +156,9 @@ class HostFs : public NF_Base
 
   private:
 	void freeMounts();
+	void freeDirCache();
+	DirNameCache *getDirNameCache( const char *pathName );
+	void invalidateStat( XfsCookie *fc );
 
   protected:
     void convert_to_xattr( ExtDrive *drv, const struct stat *statBuf, memptr xattrp );
@@ -166,6 +210,7 @@ class HostFs : public NF_Base
 	int32 host_statvfs ( const char *fpathName, void *buff );
 	char *host_readlink( const char *pathname, char *target, int len );
 	DIR  *host_opendir(  const char *name );
+	struct dirent *host_readdir( XfsDir *dirh );
 
 	void xfs_freefs( XfsFsFile *fs );
 
@@ -191,6 +236,7 @@ class HostFs : public NF_Base
 	int32 xfs_closedir( XfsDir *dirh );
 	int32 xfs_readdir( XfsDir *dirh, memptr buff, int16 len, XfsCookie *fc );
 	int32 xfs_rewinddir( XfsDir *dirh );
+	int32 xfs_readdirx( XfsDir *dirh, memptr buff, uint32 size, int32 position, bool stat64 );
 	int32 xfs_mkdir( XfsCookie *dir, memptr name, uint16 mode );
 	int32 xfs_rmdir( XfsCookie *dir, memptr name );
 	int32 xfs_dfree( XfsCookie *dir, memptr buff );
@@ -206,7 +252,18 @@ class HostFs : public NF_Base
 	int32 xfs_dev_read( ExtFile *fp, memptr buffer, uint32 count);
 	int32 xfs_dev_write(ExtFile *fp, memptr buffer, uint32 count);
 	int32 xfs_dev_lseek(ExtFile *fp, int32 offset, int16 seekmode);
-
+	int32 xfs_dev_rw_async(ExtFile *fp, memptr buffer, uint32 count, bool writing);
+
+	HostFileBuffer *getFileBuffer( int fd, bool writing );
+	int32 releaseFileBuffer( int fd );
+	void flushFileBuffers();
+	void freeFileBuffers();
+
+	class AsyncIO;
+	// the async job channel of a host file is the address of its
+	// entry here, jobs on it run in order
+	std::map<int,char> fdChannels;
+	const void *fdChannel( int fd ) { return &fdChannels[fd]; }
 };
 
 #endif // HOSTFS_SUPPORT
@@ -0,0 +1,250 @@
+/*
+ * hostfs_filebuf.cpp - HostFS file read-ahead and write-behind
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+
+#ifdef HOSTFS_SUPPORT
+
+#include "hostfs_filebuf.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#define DEBUG 0
+#include "debug.h"
+
+
+HostFileBuffer *HostFileBuffer::create( int fd )
+{
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+	struct stat statBuf;
+	if ( fstat( fd, &statBuf ) != 0 || !S_ISREG( statBuf.st_mode ) )
+		return NULL;
+
+	// pwrite() ignores the offset in append mode
+	int flags = fcntl( fd, F_GETFL );
+	if ( flags < 0 || ( flags & O_APPEND ) )
+		return NULL;
+
+	off_t pos = lseek( fd, 0, SEEK_CUR );
+	if ( pos < 0 )
+		return NULL;
+
+	D(bug("HOSTFS: buffering fd %d at %ld", fd, (long)pos));
+	return new HostFileBuffer( fd, statBuf, pos );
+#else
+	DUNUSED(fd);
+	return NULL;
+#endif
+}
+
+HostFileBuffer::HostFileBuffer( int _fd, const struct stat &statBuf, off_t _pos )
+	: fd(_fd), dev(statBuf.st_dev), ino(statBuf.st_ino), pos(_pos),
+	  start(0), len(0), dirty(false), writeError(0), seqEnd(-1), sequential(false)
+{
+	data = new uint8[CHUNK_SIZE];
+}
+
+HostFileBuffer::~HostFileBuffer()
+{
+	delete [] data;
+}
+
+
+/*
+ * Read a chunk at the current position into the empty buffer.
+ */
+ssize_t HostFileBuffer::fill( size_t count )
+{
+	size_t want = sequential ? CHUNK_SIZE : std::min( (size_t)CHUNK_SIZE, std::max( count, (size_t)MIN_FILL ) );
+
+	len = 0;
+	ssize_t res = pread( fd, data, want, pos );
+	if ( res < 0 )
+		return res;
+	start = pos;
+	len = res;
+
+#ifdef HAVE_POSIX_FADVISE
+	// let the kernel read the next chunk while the guest works on this one
+	if ( sequential && (size_t)res == want )
+		posix_fadvise( fd, pos + res, CHUNK_SIZE, POSIX_FADV_WILLNEED );
+#endif
+
+	return res;
+}
+
+ssize_t HostFileBuffer::read( void *buf, size_t count )
+{
+	if ( dirty && flush() != 0 )
+		return takeError();
+
+	uint8 *dst = (uint8 *)buf;
+	size_t done = 0;
+
+	sequential = ( pos == seqEnd );
+	while ( done < count ) {
+		if ( pos >= start && pos < start + (off_t)len ) {
+			size_t n = std::min( count - done, (size_t)( start + (off_t)len - pos ) );
+			memcpy( dst + done, data + ( pos - start ), n );
+			done += n;
+			pos += n;
+			continue;
+		}
+
+		ssize_t res;
+		if ( count - done >= CHUNK_SIZE ) {
+			// large reads go straight to the destination
+			res = pread( fd, dst + done, count - done, pos );
+			if ( res > 0 ) {
+				done += res;
+				pos += res;
+			}
+		} else {
+			res = fill( count - done );
+		}
+		if ( res < 0 && done == 0 )
+			return res;
+		if ( res <= 0 )
+			break;
+	}
+	seqEnd = pos;
+
+	return done;
+}
+
+ssize_t HostFileBuffer::write( const void *buf, size_t count )
+{
+	if ( !dirty ) {
+		// the read buffer is dropped, not updated
+		start = pos;
+		len = 0;
+	} else if ( pos != start + (off_t)len || len + count > CHUNK_SIZE ) {
+		if ( flush() != 0 )
+			return takeError();
+		start = pos;
+		len = 0;
+	}
+	seqEnd = -1;
+
+	if ( count >= CHUNK_SIZE ) {
+		const uint8 *src = (const uint8 *)buf;
+		size_t done = 0;
+		while ( done < count ) {
+			ssize_t res = pwrite( fd, src + done, count - done, pos );
+			if ( res <= 0 ) {
+				if ( done == 0 )
+					return -1;
+				break;
+			}
+			done += res;
+			pos += res;
+		}
+		return done;
+	}
+
+	memcpy( data + len, buf, count );
+	len += count;
+	pos += count;
+	dirty = len > 0;
+
+	return count;
+}
+
+int HostFileBuffer::seek( off_t newPos )
+{
+	if ( newPos < 0 ) {
+		errno = EINVAL;
+		return -1;
+	}
+	flush();
+	pos = newPos;
+	return takeError();
+}
+
+int HostFileBuffer::takeError()
+{
+	if ( writeError == 0 )
+		return 0;
+	errno = writeError;
+	writeError = 0;
+	return -1;
+}
+
+
+/*
+ * Write out the pending data. The data stays as read buffer.
+ */
+int HostFileBuffer::flush()
+{
+	if ( !dirty )
+		return 0;
+
+	D(bug("HOSTFS: flushing %lu bytes at %ld to fd %d", (unsigned long)len, (long)start, fd));
+
+	dirty = false;
+	size_t done = 0;
+	while ( done < len ) {
+		ssize_t res = pwrite( fd, data + done, len - done, start + done );
+		if ( res <= 0 ) {
+			// the data is lost, as it would be by a failing write()
+			len = 0;
+			if ( res == 0 )
+				errno = ENOSPC;
+			writeError = errno;
+			return -1;
+		}
+		done += res;
+	}
+
+	return 0;
+}
+
+/*
+ * Forget what was read, as the file was changed through another descriptor.
+ */
+void HostFileBuffer::invalidate()
+{
+	if ( !dirty )
+		len = 0;
+}
+
+/*
+ * Flush and hand the guest position back to the descriptor.
+ */
+int HostFileBuffer::release()
+{
+	flush();
+	if ( lseek( fd, pos, SEEK_SET ) < 0 )
+		return -1;
+	return takeError();
+}
+
+#endif /* HOSTFS_SUPPORT */
+
+/*
+vim:ts=4:sw=4:
+*/
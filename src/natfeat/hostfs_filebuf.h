@@ -0,0 +1,94 @@
+/*
+ * hostfs_filebuf.h - HostFS file read-ahead and write-behind - declaration
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _HOSTFS_FILEBUF_H
+#define _HOSTFS_FILEBUF_H
+
+#ifdef HOSTFS_SUPPORT
+
+#include <sys/types.h>
+
+/*
+ * Buffers the small reads and writes of the guest on a regular host file.
+ *
+ * While the buffer exists it keeps the file position of the guest and
+ * does all I/O with pread()/pwrite(), so the position of the host file
+ * descriptor is meaningless; release() writes out pending data and sets
+ * the descriptor to the guest position again, before the descriptor
+ * is used otherwise.
+ *
+ * Reads fill a chunk at a time; once the reads are found to be
+ * sequential, the kernel is asked to prefetch the next chunk too.
+ * Writes are collected until they aren't contiguous anymore, the chunk
+ * is full, or the buffer is flushed; errors of the delayed writes are
+ * reported by the next seek() or release().
+ */
+class HostFileBuffer
+{
+	// the size of a read or write chunk
+	static const size_t CHUNK_SIZE = 65536;
+	// reads smaller than this are rounded up before the access is known to be sequential
+	static const size_t MIN_FILL = 4096;
+
+	int fd;
+	dev_t dev;
+	ino_t ino;
+	off_t pos;          // the file position of the guest
+
+	uint8 *data;
+	off_t start;        // the file offset of data[0]
+	size_t len;         // valid or, if dirty, pending bytes in data
+	bool dirty;
+	int writeError;     // errno of a failed delayed write not reported yet
+
+	off_t seqEnd;       // where the previous read ended
+	bool sequential;
+
+	HostFileBuffer( int fd, const struct stat &statBuf, off_t pos );
+
+	ssize_t fill( size_t count );
+	int takeError();
+
+  public:
+	// returns NULL if the file can't be buffered (not regular, append mode)
+	static HostFileBuffer *create( int fd );
+	~HostFileBuffer();
+
+	bool isFile( dev_t _dev, ino_t _ino ) const { return dev == _dev && ino == _ino; }
+	bool isDirty() const { return dirty; }
+	dev_t getDev() const { return dev; }
+	ino_t getIno() const { return ino; }
+	off_t tell() const { return pos; }
+
+	ssize_t read( void *buf, size_t count );
+	ssize_t write( const void *buf, size_t count );
+	int seek( off_t newPos );
+
+	int flush();
+	void invalidate();
+	int release();
+};
+
+#endif // HOSTFS_SUPPORT
+
+#endif // _HOSTFS_FILEBUF_H
@@ -0,0 +1,374 @@
+/*
+ * hostfs_statcache.cpp - HostFS lstat() cache
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+
+#ifdef HOSTFS_SUPPORT
+
+#include "hostfs_statcache.h"
+#include "tools.h"
+#include "win32_supp.h"
+#include "SDL_compat.h"
+#include <SDL_thread.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+# include <poll.h>
+#endif
+
+#include <algorithm>
+
+#define DEBUG 0
+#include "debug.h"
+
+
+#ifdef __CYGWIN__
+int hostfs_lstat(const char *fpathName, struct stat *statBuf)
+{
+	char path[1024];
+
+	/*
+	 * Be sure to use a posix path for the actual stat call,
+	 * otherwise cygwin does not translate all attributes.
+	 * Should fix #22.
+	 */
+	safe_strncpy(path, fpathName, sizeof(path));
+	return ::lstat(cygwin_path_to_posix(path, sizeof(path)), statBuf);
+}
+#else
+int hostfs_lstat(const char *fpathName, struct stat *statBuf)
+{
+	return ::lstat(fpathName, statBuf);
+}
+#endif
+
+
+HostStatCache::HostStatCache()
+{
+	clock = 0;
+	hits = 0;
+	misses = 0;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	watchThread = NULL;
+	lock = NULL;
+	quit = false;
+	flushPending = false;
+	pending = false;
+
+	inotifyFd = inotify_init();
+	if ( inotifyFd < 0 ) {
+		D(bug("HOSTFS: inotify not available, stat cache uses timeouts"));
+		return;
+	}
+	lock = SDL_CreateMutex();
+	watchThread = SDL_CreateNamedThread( watchFunc, "HostFS inotify", this );
+	if ( watchThread == NULL ) {
+		D(bug("HOSTFS: can't start the inotify thread"));
+		close( inotifyFd );
+		inotifyFd = -1;
+	}
+#endif
+}
+
+HostStatCache::~HostStatCache()
+{
+	D(bug("HOSTFS: stat cache %u hits, %u misses", hits, misses));
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if ( watchThread ) {
+		quit = true;
+		SDL_WaitThread( watchThread, NULL );
+	}
+	if ( inotifyFd >= 0 )
+		close( inotifyFd );
+	if ( lock )
+		SDL_DestroyMutex( lock );
+#endif
+}
+
+void HostStatCache::reset()
+{
+	D(bug("HOSTFS: stat cache %u hits, %u misses", hits, misses));
+
+	entries.clear();
+	hits = misses = 0;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if ( watchThread == NULL )
+		return;
+	SDL_LockMutex( lock );
+	for ( std::map<int,std::string>::iterator it = watchDirs.begin(); it != watchDirs.end(); ++it )
+		inotify_rm_watch( inotifyFd, it->first );
+	watchDirs.clear();
+	changed.clear();
+	unwatched.clear();
+	flushPending = false;
+	pending = false;
+	SDL_UnlockMutex( lock );
+	watches.clear();
+#endif
+}
+
+
+/*
+ * Drop the least recently used half of the entries.
+ */
+void HostStatCache::evict()
+{
+	std::vector<uint32> uses;
+	uses.reserve( entries.size() );
+	for ( EntryMap::const_iterator it = entries.begin(); it != entries.end(); ++it )
+		uses.push_back( it->second.lastUse );
+
+	std::nth_element( uses.begin(), uses.begin() + uses.size() / 2, uses.end() );
+	uint32 limit = uses[uses.size() / 2];
+
+	for ( EntryMap::iterator it = entries.begin(); it != entries.end(); ) {
+		if ( it->second.lastUse < limit )
+			entries.erase( it++ );
+		else
+			++it;
+	}
+}
+
+/*
+ * Forget a path and its directory, whose times change with it.
+ */
+void HostStatCache::invalidateEntry( const std::string &pathName )
+{
+	entries.erase( pathName );
+
+	std::string::size_type sep = pathName.find_last_of( DIRSEPARATOR );
+	if ( sep != std::string::npos && sep > 0 )
+		entries.erase( pathName.substr( 0, sep ) );
+}
+
+void HostStatCache::invalidate( const char *pathName )
+{
+	if ( !entries.empty() )
+		invalidateEntry( pathName );
+}
+
+void HostStatCache::flush()
+{
+	entries.clear();
+}
+
+int HostStatCache::lstat( const char *pathName, struct stat *statBuf )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	if ( pending )
+		processChanges();
+#endif
+
+	uint32 now = SDL_GetTicks();
+	EntryMap::iterator it = entries.find( pathName );
+	if ( it != entries.end() && (int32)(it->second.expires - now) > 0 ) {
+		Entry &e = it->second;
+		e.lastUse = ++clock;
+		hits++;
+		if ( e.err ) {
+			errno = e.err;
+			return -1;
+		}
+		*statBuf = e.statBuf;
+		return 0;
+	}
+
+	if ( (++misses & 0xfff) == 0 ) {
+		D(bug("HOSTFS: stat cache %u hits, %u misses", hits, misses));
+	}
+
+	// watch before the lstat() so that no change gets lost in between
+	uint32 ttl = TTL;
+#ifdef HAVE_SYS_INOTIFY_H
+	if ( watch( pathName ) )
+		ttl = TTL_WATCHED;
+#endif
+
+	Entry e;
+	int res = hostfs_lstat( pathName, &e.statBuf );
+	e.err = res ? errno : 0;
+
+	// don't remember transient errors
+	if ( e.err && e.err != ENOENT && e.err != ENOTDIR )
+		return res;
+
+	if ( it == entries.end() && entries.size() >= CACHE_SIZE )
+		evict();
+
+	e.expires = now + ttl;
+	e.lastUse = ++clock;
+	entries[pathName] = e;
+
+	if ( res == 0 )
+		*statBuf = e.statBuf;
+	else
+		errno = e.err;
+	return res;
+}
+
+/*
+ * Like stat(): symlinks are followed uncached.
+ */
+int HostStatCache::stat( const char *pathName, struct stat *statBuf )
+{
+	int res = lstat( pathName, statBuf );
+	if ( res == 0 && S_ISLNK( statBuf->st_mode ) )
+		return ::stat( pathName, statBuf );
+	return res;
+}
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+/*
+ * Watch the directory of a path and every directory above it, as the
+ * rename or removal of any of them changes the path too. Returns
+ * whether they are all watched; otherwise the entry must expire soon.
+ */
+bool HostStatCache::watch( const std::string &pathName )
+{
+	if ( watchThread == NULL )
+		return false;
+
+	std::string dir = pathName;
+	for (;;) {
+		std::string::size_type sep = dir.find_last_of( DIRSEPARATOR );
+		if ( sep == std::string::npos )
+			return false;
+		dir = dir.substr( 0, sep > 0 ? sep : 1 );
+		if ( !watchDir( dir ) )
+			return false;
+		if ( sep == 0 )
+			return true;
+	}
+}
+
+bool HostStatCache::watchDir( const std::string &dir )
+{
+	if ( watches.find( dir ) != watches.end() )
+		return true;
+	if ( watches.size() >= MAX_WATCHES )
+		return false;
+
+	int wd = inotify_add_watch( inotifyFd, dir.c_str(),
+								IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE |
+								IN_MOVED_FROM | IN_MOVED_TO |
+								IN_DELETE_SELF | IN_MOVE_SELF );
+	if ( wd < 0 )
+		return false;
+
+	SDL_LockMutex( lock );
+	watchDirs[wd] = dir;
+	SDL_UnlockMutex( lock );
+	watches[dir] = wd;
+
+	D(bug("HOSTFS: watching %s", dir.c_str()));
+	return true;
+}
+
+/*
+ * Apply what the watcher thread reported.
+ */
+void HostStatCache::processChanges()
+{
+	SDL_LockMutex( lock );
+	if ( flushPending ) {
+		D(bug("HOSTFS: stat cache flushed by inotify"));
+		entries.clear();
+		flushPending = false;
+	} else {
+		for ( std::vector<std::string>::const_iterator it = changed.begin(); it != changed.end(); ++it )
+			invalidateEntry( *it );
+	}
+	for ( std::vector<std::string>::const_iterator it = unwatched.begin(); it != unwatched.end(); ++it )
+		watches.erase( *it );
+	changed.clear();
+	unwatched.clear();
+	pending = false;
+	SDL_UnlockMutex( lock );
+}
+
+int HostStatCache::watchFunc( void *arg )
+{
+	HostStatCache *cache = (HostStatCache *)arg;
+	union {
+		struct inotify_event event;
+		char buf[4096];
+	} u;
+
+	while ( !cache->quit ) {
+		// wake up now and then to notice the quit request
+		struct pollfd pfd;
+		pfd.fd = cache->inotifyFd;
+		pfd.events = POLLIN;
+		if ( poll( &pfd, 1, 250 ) <= 0 )
+			continue;
+
+		ssize_t len = read( cache->inotifyFd, u.buf, sizeof(u.buf) );
+		if ( len <= 0 )
+			continue;
+
+		SDL_LockMutex( cache->lock );
+		for ( char *p = u.buf; p < u.buf + len; ) {
+			struct inotify_event *ev = (struct inotify_event *)p;
+			p += sizeof(struct inotify_event) + ev->len;
+
+			// lost events, or paths below a directory that changed
+			if ( (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF)) ||
+				 ( (ev->mask & IN_ISDIR) && (ev->mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE)) ) )
+				cache->flushPending = true;
+			// the watch of a moved directory would report for its old path
+			if ( ev->mask & IN_MOVE_SELF )
+				inotify_rm_watch( cache->inotifyFd, ev->wd );
+
+			std::map<int,std::string>::iterator it = cache->watchDirs.find( ev->wd );
+			if ( it == cache->watchDirs.end() )
+				continue;
+
+			if ( ev->mask & IN_IGNORED ) {
+				cache->unwatched.push_back( it->second );
+				cache->watchDirs.erase( it );
+				cache->flushPending = true;
+			} else if ( ev->len && ev->name[0] ) {
+				cache->changed.push_back( it->second + DIRSEPARATOR + ev->name );
+			} else {
+				cache->changed.push_back( it->second );
+			}
+		}
+		cache->pending = true;
+		SDL_UnlockMutex( cache->lock );
+	}
+
+	return 0;
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
+
+#endif /* HOSTFS_SUPPORT */
+
+/*
+vim:ts=4:sw=4:
+*/
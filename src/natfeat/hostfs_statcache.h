@@ -0,0 +1,115 @@
+/*
+ * hostfs_statcache.h - HostFS lstat() cache - declaration
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _HOSTFS_STATCACHE_H
+#define _HOSTFS_STATCACHE_H
+
+#ifdef HOSTFS_SUPPORT
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_mutex;
+
+// lstat() of the host, with the path conversion needed on Cygwin
+extern int hostfs_lstat( const char *pathName, struct stat *statBuf );
+
+/*
+ * Caches lstat() results of host paths, failed lookups included.
+ *
+ * On Linux the directories of the cached paths, and all their ancestors,
+ * are watched with inotify and entries are dropped as soon as the watcher
+ * thread reports a change.
+ * Elsewhere, or once too many directories are watched, entries simply
+ * expire after a short time. Changes done by HostFs itself must be
+ * reported with invalidate() or flush(), as the watcher is asynchronous.
+ */
+class HostStatCache
+{
+	struct Entry {
+		struct stat statBuf;
+		int       err;          // errno of a failed lstat(), or 0
+		uint32    expires;      // SDL_GetTicks() the entry is stale at
+		uint32    lastUse;
+	};
+
+	// the number of paths cached at once
+	static const unsigned int CACHE_SIZE = 2048;
+	// the lifetime of an entry in ms, with and without a watch
+	static const uint32 TTL_WATCHED = 60000;
+	static const uint32 TTL = 1000;
+
+	typedef std::map<std::string,Entry> EntryMap;
+	EntryMap entries;
+	uint32 clock;
+	uint32 hits;
+	uint32 misses;
+
+	void evict();
+	void invalidateEntry( const std::string &pathName );
+
+#ifdef HAVE_SYS_INOTIFY_H
+	// the number of directories watched at once
+	static const unsigned int MAX_WATCHES = 512;
+
+	int inotifyFd;
+	SDL_Thread *watchThread;
+	volatile bool quit;
+
+	// directory -> watch, used by the emulation thread only
+	std::map<std::string,int> watches;
+
+	// shared with the watcher thread, guarded by lock
+	SDL_mutex *lock;
+	std::map<int,std::string> watchDirs;    // watch -> directory
+	std::vector<std::string> changed;       // paths reported changed
+	std::vector<std::string> unwatched;     // directories not watched anymore
+	bool flushPending;
+	volatile bool pending;
+
+	static int watchFunc( void *arg );
+	bool watch( const std::string &pathName );
+	bool watchDir( const std::string &dir );
+	void processChanges();
+#endif
+
+  public:
+	HostStatCache();
+	~HostStatCache();
+
+	int lstat( const char *pathName, struct stat *statBuf );
+	int stat( const char *pathName, struct stat *statBuf );
+
+	void invalidate( const char *pathName );
+	void flush();
+	void reset();
+};
+
+#endif // HOSTFS_SUPPORT
+
+#endif // _HOSTFS_STATCACHE_H
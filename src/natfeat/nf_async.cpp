@@ -0,0 +1,313 @@
+/*
+ * nf_async.cpp - asynchronous NatFeat jobs
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "cpu_emulation.h"
+#include "nf_async.h"
+#include "toserror.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#include "SDL_compat.h"
+#include <SDL_thread.h>
+
+#include "../../atari/natfeat/nf_async_nfapi.h"
+
+#define INTLEVEL	3
+
+NFAsync *NFAsync::instance = NULL;
+
+NFAsync::NFAsync()
+{
+	quit = false;
+	lastTicket = 0;
+	irqEnabled = false;
+
+	lock = SDL_CreateMutex();
+	workCond = SDL_CreateCond();
+	doneCond = SDL_CreateCond();
+	for (int i = 0; i < NUM_WORKERS; i++)
+		workers[i] = SDL_CreateNamedThread(workerFunc, "NatFeat async", this);
+
+	if (workers[0] == NULL) {
+		panicbug("NatFeat: can't start the async workers, asynchronous calls disabled");
+		return;
+	}
+	instance = this;
+}
+
+NFAsync::~NFAsync()
+{
+	stop();
+	SDL_DestroyCond(doneCond);
+	SDL_DestroyCond(workCond);
+	SDL_DestroyMutex(lock);
+}
+
+/*
+ * Let the workers finish the jobs they are running and throw away
+ * all jobs. None is completed: this happens on shutdown, when guest
+ * memory must not be written anymore.
+ */
+void NFAsync::stop()
+{
+	if (instance == this)
+		instance = NULL;
+
+	SDL_LockMutex(lock);
+	quit = true;
+	SDL_CondBroadcast(workCond);
+	SDL_UnlockMutex(lock);
+	for (int i = 0; i < NUM_WORKERS; i++) {
+		if (workers[i]) {
+			SDL_WaitThread(workers[i], NULL);
+			workers[i] = NULL;
+		}
+	}
+
+	for (std::map<int32,NFAsyncJob *>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+		delete it->second;
+	jobs.clear();
+	queue.clear();
+	busy.clear();
+}
+
+void NFAsync::reset()
+{
+	drainAll();
+	for (std::map<int32,NFAsyncJob *>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+		delete it->second;
+	jobs.clear();
+	irqEnabled = false;
+}
+
+
+/*
+ * The first queued job whose channel is idle; called with the lock held.
+ */
+NFAsyncJob *NFAsync::nextJob()
+{
+	for (std::list<NFAsyncJob *>::iterator it = queue.begin(); it != queue.end(); ++it) {
+		NFAsyncJob *job = *it;
+		const void *ch = job->channel;
+		if (ch != NULL) {
+			bool isBusy = false;
+			for (std::list<const void *>::const_iterator b = busy.begin(); b != busy.end(); ++b)
+				if (*b == ch) {
+					isBusy = true;
+					break;
+				}
+			if (isBusy)
+				continue;
+			busy.push_back(ch);
+		}
+		queue.erase(it);
+		return job;
+	}
+	return NULL;
+}
+
+int NFAsync::workerFunc(void *arg)
+{
+	NFAsync *self = (NFAsync *)arg;
+
+	SDL_LockMutex(self->lock);
+	while (!self->quit) {
+		NFAsyncJob *job = self->nextJob();
+		if (job == NULL) {
+			SDL_CondWait(self->workCond, self->lock);
+			continue;
+		}
+		SDL_UnlockMutex(self->lock);
+
+		int32 res = job->run();
+
+		SDL_LockMutex(self->lock);
+		job->result = res;
+		job->done = true;
+		if (job->channel != NULL) {
+			self->busy.remove(job->channel);
+			// a job queued behind this one may run now
+			SDL_CondBroadcast(self->workCond);
+		}
+		SDL_CondBroadcast(self->doneCond);
+		if (self->irqEnabled)
+			TriggerInt3();
+	}
+	SDL_UnlockMutex(self->lock);
+
+	return 0;
+}
+
+
+bool NFAsync::isDone(NFAsyncJob *job)
+{
+	SDL_LockMutex(lock);
+	bool done = job->done;
+	SDL_UnlockMutex(lock);
+	return done;
+}
+
+void NFAsync::waitDone(NFAsyncJob *job)
+{
+	SDL_LockMutex(lock);
+	while (!job->done)
+		SDL_CondWait(doneCond, lock);
+	SDL_UnlockMutex(lock);
+}
+
+void NFAsync::finish(NFAsyncJob *job)
+{
+	if (!job->finished) {
+		job->result = job->complete(job->result);
+		job->finished = true;
+	}
+}
+
+
+/*
+ * Queue a job. Returns its ticket, or TOS_ENOSYS when
+ * the job was not accepted; it is deleted then.
+ */
+int32 NFAsync::submit(NFAsyncJob *job)
+{
+	NFAsync *self = instance;
+	if (self == NULL || self->jobs.size() >= MAX_JOBS) {
+		D(bug("NatFeat: async job refused"));
+		delete job;
+		return TOS_ENOSYS;
+	}
+
+	do {
+		self->lastTicket = (self->lastTicket & 0x7fffffff) + 1;
+	} while (self->jobs.find(self->lastTicket) != self->jobs.end());
+	job->ticket = self->lastTicket;
+	self->jobs[job->ticket] = job;
+
+	SDL_LockMutex(self->lock);
+	self->queue.push_back(job);
+	SDL_CondSignal(self->workCond);
+	SDL_UnlockMutex(self->lock);
+
+	D(bug("NatFeat: async job %d queued", job->ticket));
+	return job->ticket;
+}
+
+/*
+ * Wait for and complete all jobs of a channel, so that a synchronous
+ * call sees their effects. The guest still collects their results.
+ */
+void NFAsync::drain(const void *channel)
+{
+	NFAsync *self = instance;
+	if (self == NULL)
+		return;
+
+	for (std::map<int32,NFAsyncJob *>::iterator it = self->jobs.begin(); it != self->jobs.end(); ++it) {
+		NFAsyncJob *job = it->second;
+		if (job->channel == channel && !job->finished) {
+			self->waitDone(job);
+			self->finish(job);
+		}
+	}
+}
+
+void NFAsync::drainAll()
+{
+	NFAsync *self = instance;
+	if (self == NULL)
+		return;
+
+	for (std::map<int32,NFAsyncJob *>::iterator it = self->jobs.begin(); it != self->jobs.end(); ++it) {
+		self->waitDone(it->second);
+		self->finish(it->second);
+	}
+}
+
+
+int32 NFAsync::dispatch(uint32 fncode)
+{
+	D(bug("NatFeat: async dispatch %d", fncode));
+
+	switch (fncode) {
+		case GET_VERSION:
+			return NF_ASYNC_NFAPI_VERSION;
+
+		case ASYNC_INTLEVEL:
+			return INTLEVEL;
+
+		case ASYNC_IRQ:
+			irqEnabled = getParameter(0) != 0;
+			return TOS_E_OK;
+
+		case ASYNC_POLL:
+		case ASYNC_WAIT:
+			{
+				std::map<int32,NFAsyncJob *>::iterator it = jobs.find((int32)getParameter(0));
+				if (it == jobs.end())
+					return TOS_EINVAL;
+
+				NFAsyncJob *job = it->second;
+				if (fncode == ASYNC_WAIT)
+					waitDone(job);
+				else if (!isDone(job))
+					return 0;
+
+				finish(job);
+				int32 res = job->result;
+				jobs.erase(it);
+				delete job;
+
+				if (fncode == ASYNC_WAIT)
+					return res;
+				memptr resultp = getParameter(1);
+				if (resultp)
+					WriteInt32(resultp, res);
+				return 1;
+			}
+
+		case ASYNC_COMPLETED:
+			{
+				int32 ticket = 0;
+				SDL_LockMutex(lock);
+				for (std::map<int32,NFAsyncJob *>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+					NFAsyncJob *job = it->second;
+					if (job->done && !job->reported) {
+						job->reported = true;
+						ticket = job->ticket;
+						break;
+					}
+				}
+				SDL_UnlockMutex(lock);
+				return ticket;
+			}
+	}
+
+	D(bug("NatFeat: async unknown function %d", fncode));
+	return TOS_EINVFN;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
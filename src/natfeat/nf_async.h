@@ -0,0 +1,121 @@
+/*
+ * nf_async.h - asynchronous NatFeat jobs - declaration
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NF_ASYNC_H
+#define _NF_ASYNC_H
+
+#include "nf_base.h"
+
+#include <list>
+#include <map>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+/*
+ * A job started by a NatFeat call that completes later.
+ *
+ * run() is called on a worker thread: it must neither touch guest
+ * memory through the CPU macros nor call getParameter(). Anything
+ * the job needs has to be copied, or converted to host pointers with
+ * Atari2HostBlock(), before it is submitted. complete() is called
+ * on the CPU thread once run() is done, when the guest collects the
+ * job or when the NatFeat drains its channel; it may update guest
+ * visible state and returns what the guest gets as result. Jobs
+ * still there on shutdown are deleted without complete().
+ *
+ * Jobs with the same channel run one after another, in the order
+ * they were submitted; jobs with distinct channels run in parallel.
+ */
+class NFAsyncJob
+{
+	friend class NFAsync;
+
+	int32 ticket;
+	int32 result;
+	bool done;          // run() returned, guarded by the pool lock
+	bool finished;      // complete() was called
+	bool reported;      // returned by ASYNC_COMPLETED
+
+  protected:
+	const void *channel;
+
+  public:
+	NFAsyncJob(const void *ch) : ticket(0), result(0), done(false), finished(false), reported(false), channel(ch) {}
+	virtual ~NFAsyncJob() {}
+
+	virtual int32 run() = 0;
+	virtual int32 complete(int32 res) { return res; }
+};
+
+/*
+ * The worker pool, and the NatFeat the guest polls and
+ * acknowledges the completion interrupt with.
+ */
+class NFAsync : public NF_Base
+{
+	// the number of worker threads
+	static const int NUM_WORKERS = 2;
+	// the number of jobs queued or not yet collected by the guest
+	static const unsigned int MAX_JOBS = 256;
+
+	static NFAsync *instance;
+
+	SDL_Thread *workers[NUM_WORKERS];
+	SDL_mutex *lock;
+	SDL_cond *workCond;
+	SDL_cond *doneCond;
+	volatile bool quit;
+
+	// guarded by lock
+	std::list<NFAsyncJob *> queue;
+	std::list<const void *> busy;
+
+	// used by the CPU thread only
+	std::map<int32,NFAsyncJob *> jobs;
+	int32 lastTicket;
+	bool irqEnabled;
+
+	static int workerFunc(void *arg);
+	NFAsyncJob *nextJob();
+	bool isDone(NFAsyncJob *job);
+	void waitDone(NFAsyncJob *job);
+	void finish(NFAsyncJob *job);
+	void stop();
+
+  public:
+	NFAsync();
+	virtual ~NFAsync();
+	const char *name() { return "ASYNC"; }
+	bool isSuperOnly() { return false; }
+	int32 dispatch(uint32 fncode);
+	void reset();
+
+	// the CPU thread interface for the other NatFeats
+	static int32 submit(NFAsyncJob *job);
+	static void drain(const void *channel);
+	static void drainAll();
+};
+
+#endif /* _NF_ASYNC_H */
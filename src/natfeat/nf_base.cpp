@@ -22,6 +22,7 @@
  */
 
 #include "nf_base.h"
+#include "nf_async.h"
 #include <errno.h>
 #include "toserror.h"
 #include "debug.h"
@@ -60,3 +61,13 @@ uint32 NF_Base::errnoHost2Mint(int unixerrno,int defaulttoserrno) const
 
 	return retval;
 }
+
+int32 NF_Base::submitAsync(NFAsyncJob *job)
+{
+	return NFAsync::submit(job);
+}
+
+void NF_Base::drainAsync(const void *channel)
+{
+	NFAsync::drain(channel);
+}
@@ -33,6 +33,8 @@
 	 -1)
 #define DriveToLetter(d) ((d) < 26 ? 'A' + (d) : (d) - 26 + '1')
 
+class NFAsyncJob;	/* see nf_async.h */
+
 class NF_Base
 {
 public:
@@ -44,6 +46,11 @@ public:
 	virtual int32 dispatch(uint32 fncode) = 0;
 	uint32 getParameter(int i) { return nf_getparameter(i); }
 	uint32 errnoHost2Mint( int unixerrno,int defaulttoserrno ) const;
+
+	/* run a job on the worker threads; returns its ticket or TOS_ENOSYS */
+	int32 submitAsync(NFAsyncJob *job);
+	/* complete the pending jobs of a channel */
+	void drainAsync(const void *channel);
 };
 
 #endif /* _NF_BASE_H */
@@ -0,0 +1,141 @@
+/*
+ * nf_mem.cpp - bulk memory operations NatFeat
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "cpu_emulation.h"
+#include "nf_mem.h"
+#include "toserror.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#include "../../atari/natfeat/nf_mem_nfapi.h"
+
+/*
+ * Host address of a guest range, or NULL if it is not all in ST-RAM,
+ * FastRAM or VideoRAM; Atari2HostBlock() checks that in every build.
+ */
+uint8 *NF_Mem::hostBlock(memptr addr, uint32 len, bool write)
+{
+	uint8 *p = Atari2HostBlock(addr, len, write);
+	if (p == NULL) {
+		D(bug("NF_MEM: invalid %s range %08x, %u bytes", write ? "write" : "read", addr, len));
+	}
+	return p;
+}
+
+int32 NF_Mem::copySwapped(memptr dst, memptr src, uint32 len, int size)
+{
+	if (len % size != 0)
+		return TOS_EINVAL;
+	if (len == 0)
+		return TOS_E_OK;
+
+	uint8 *d = hostBlock(dst, len, true);
+	uint8 *s = hostBlock(src, len, false);
+	if (d == NULL || s == NULL)
+		return TOS_EIMBA;
+	// in place is fine, as each element is read before it is written
+	if (d != s && d < s + len && s < d + len)
+		return TOS_EINVAL;
+
+	if (size == 2) {
+		for (uint32 i = 0; i < len; i += 2) {
+			uint8 b0 = s[i], b1 = s[i + 1];
+			d[i] = b1;
+			d[i + 1] = b0;
+		}
+	} else {
+		for (uint32 i = 0; i < len; i += 4) {
+			uint8 b0 = s[i], b1 = s[i + 1], b2 = s[i + 2], b3 = s[i + 3];
+			d[i] = b3;
+			d[i + 1] = b2;
+			d[i + 2] = b1;
+			d[i + 3] = b0;
+		}
+	}
+	return TOS_E_OK;
+}
+
+int32 NF_Mem::dispatch(uint32 fncode)
+{
+	memptr dst = getParameter(0);
+	memptr src = getParameter(1);
+	uint32 len = getParameter(2);
+	uint8 *d, *s;
+
+	D(bug("NF_MEM(%d): %08x %08x %u", fncode, dst, src, len));
+
+	switch (fncode) {
+		case GET_VERSION:
+			return NF_MEM_NFAPI_VERSION;
+
+		case MEM_COPY:
+		case MEM_MOVE:
+			if (len == 0)
+				return TOS_E_OK;
+			d = hostBlock(dst, len, true);
+			s = hostBlock(src, len, false);
+			if (d == NULL || s == NULL)
+				return TOS_EIMBA;
+			if (fncode == MEM_COPY && (d + len <= s || s + len <= d))
+				memcpy(d, s, len);
+			else
+				memmove(d, s, len);
+			return TOS_E_OK;
+
+		case MEM_SET:
+			if (len == 0)
+				return TOS_E_OK;
+			d = hostBlock(dst, len, true);
+			if (d == NULL)
+				return TOS_EIMBA;
+			memset(d, (uint8)src, len);
+			return TOS_E_OK;
+
+		case MEM_CMP:
+			{
+				if (len == 0)
+					return 0;
+				d = hostBlock(dst, len, false);
+				s = hostBlock(src, len, false);
+				if (d == NULL || s == NULL)
+					return TOS_EIMBA;
+				int res = memcmp(d, s, len);
+				return res < 0 ? -1 : res > 0;
+			}
+
+		case MEM_COPY_SWAP16:
+			return copySwapped(dst, src, len, 2);
+
+		case MEM_COPY_SWAP32:
+			return copySwapped(dst, src, len, 4);
+	}
+
+	D(bug("NF_MEM: unimplemented function #%d", fncode));
+	return TOS_ENOSYS;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,45 @@
+/*
+ * nf_mem.h - bulk memory operations NatFeat
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NF_MEM_H
+#define _NF_MEM_H
+
+#include "nf_base.h"
+
+/*
+ * memcpy(), memmove(), memset() and memcmp() on guest RAM, done by
+ * the host C library instead of a 68k loop. The addresses are
+ * physical ones, so the calls are for the supervisor only.
+ */
+class NF_Mem : public NF_Base
+{
+	uint8 *hostBlock(memptr addr, uint32 len, bool write);
+	int32 copySwapped(memptr dst, memptr src, uint32 len, int size);
+
+  public:
+	const char *name() { return "NF_MEM"; }
+	bool isSuperOnly() { return true; }
+	int32 dispatch(uint32 fncode);
+};
+
+#endif /* _NF_MEM_H */
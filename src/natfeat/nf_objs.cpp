@@ -22,6 +22,7 @@
 
 #include "nf_objs.h"
 #include "nf_basicset.h"
+#include "nf_async.h"
 
 #include "xhdi.h"
 #include "nfaudio.h"
@@ -29,6 +30,8 @@
 #include "hostfs.h"
 #include "ethernet.h"
 #include "debugprintf.h"
+#include "nf_mem.h"
+#include "nf_ring.h"
 #ifdef NFVDI_SUPPORT
 # include "nfvdi.h"
 # include "nfvdi_soft.h"
@@ -102,10 +105,14 @@ void NFCreate(void)
 	NFAdd(new NF_Shutdown);
 	NFAdd(new NF_StdErr);
 
+	/* first, so that its reset completes and its destruction cancels the jobs of the others */
+	NFAdd(new NFAsync);
+
 	/* additional NF */
 	NFAdd(new NF_Exit);
 	NFAdd(new BootstrapNatFeat);
 	NFAdd(new DebugPrintf);
+	NFAdd(new NF_Mem);
 	NFAdd(new XHDIDriver);
 	NFAdd(new AUDIODriver);
 
@@ -174,6 +181,10 @@ void NFCreate(void)
 	NFAdd(new HostExec);
 #endif
 
+#ifdef NFRING_SUPPORT
+	NFAdd(new NF_Ring);
+#endif
+
 #ifdef NFCONFIG_SUPPORT
 	NFAdd(NF_Config::GetNFConfig());
 #endif
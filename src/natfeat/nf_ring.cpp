@@ -0,0 +1,324 @@
+/*
+ * nf_ring.cpp - shared memory ring NatFeat
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "cpu_emulation.h"
+#include "parameters.h"
+#include "nf_ring.h"
+
+#ifdef NFRING_SUPPORT
+
+#include "toserror.h"
+#include "SDL_compat.h"
+#include <SDL_thread.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define DEBUG 0
+#include "debug.h"
+
+#include "../../atari/natfeat/nf_ring_nfapi.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+NF_Ring::NF_Ring()
+{
+	for (int i = 0; i < MAX_RINGS; i++)
+		rings[i] = NULL;
+}
+
+NF_Ring::~NF_Ring()
+{
+	reset();
+}
+
+/*
+ * The rings are not tied to a guest process, so they all go away here
+ * at the latest.
+ */
+void NF_Ring::reset()
+{
+	for (int i = 0; i < MAX_RINGS; i++)
+		closeRing(i + 1);
+}
+
+int32 NF_Ring::dispatch(uint32 fncode)
+{
+	int handle;
+
+	switch (fncode) {
+		case GET_VERSION:
+			return NF_RING_NFAPI_VERSION;
+
+		case RING_OPEN:
+			return openRing(getParameter(0), getParameter(1));
+
+		case RING_NOTIFY:
+			handle = getParameter(0);
+			if (handle < 1 || handle > MAX_RINGS || rings[handle - 1] == NULL)
+				return TOS_EIHNDL;
+			if (rings[handle - 1]->stopped)
+				return TOS_EIO;
+			if (write(rings[handle - 1]->wakeFd[1], "", 1) < 0 && errno != EAGAIN) {
+				D(bug("NF_RING: notify %d: %s", handle, strerror(errno)));
+			}
+			return TOS_E_OK;
+
+		case RING_CLOSE:
+			handle = getParameter(0);
+			if (handle < 1 || handle > MAX_RINGS || rings[handle - 1] == NULL)
+				return TOS_EIHNDL;
+			closeRing(handle);
+			return TOS_E_OK;
+	}
+
+	D(bug("NF_RING: unimplemented function #%d", fncode));
+	return TOS_ENOSYS;
+}
+
+int32 NF_Ring::openRing(memptr addr, memptr nameAddr)
+{
+	const char *dir = bx_options.natfeats.ring_dir;
+	if (dir[0] == '\0')
+		return TOS_ENOSYS;
+
+	int handle;
+	for (handle = 1; handle <= MAX_RINGS; handle++)
+		if (rings[handle - 1] == NULL)
+			break;
+	if (handle > MAX_RINGS)
+		return TOS_ENHNDL;
+
+	// the socket is created in RingDir only
+	char name[64];
+	Atari2HostSafeStrncpy(name, nameAddr, sizeof(name));
+	if (name[0] == '\0' || name[0] == '.')
+		return TOS_EINVAL;
+	for (const char *p = name; *p; p++)
+		if (!isalnum((unsigned char)*p) && *p != '_' && *p != '-' && *p != '.')
+			return TOS_EINVAL;
+
+	// the drain thread uses the host pointer for the life of the ring,
+	// so the whole ring must be in RAM, whatever the memory checks are
+	if ((addr & 3) != 0 || Atari2HostBlock(addr, RING_DATA, true) == NULL)
+		return TOS_EIMBA;
+	uint32 size = ReadInt32(addr + RING_SIZE);
+	if (size < MIN_SIZE || size > MAX_SIZE || (size & (size - 1)) != 0)
+		return TOS_EINVAL;
+	uint8 *host = Atari2HostBlock(addr, RING_DATA + size, true);
+	if (host == NULL)
+		return TOS_EIMBA;
+
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	std::string path = std::string(dir) + "/" + name;
+	if (path.size() >= sizeof(sa.sun_path))
+		return TOS_ERANGE;
+	strcpy(sa.sun_path, path.c_str());
+
+	Ring *ring = new Ring;
+	ring->owner = this;
+	ring->host = host;
+	ring->size = size;
+	ring->tail = do_get_mem_long((uae_u32 *)(host + RING_TAIL));
+	ring->path = path;
+	ring->clientFd = -1;
+	ring->wakeFd[0] = ring->wakeFd[1] = -1;
+	ring->thread = NULL;
+	ring->quit = false;
+	ring->stopped = false;
+
+	// a socket left over from a previous run would make bind() fail
+	unlink(sa.sun_path);
+	ring->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ring->listenFd < 0 ||
+		bind(ring->listenFd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+		listen(ring->listenFd, 1) < 0 ||
+		pipe(ring->wakeFd) < 0) {
+		int err = errno;
+		panicbug("NF_RING: can't create %s: %s", sa.sun_path, strerror(err));
+		if (ring->listenFd >= 0)
+			close(ring->listenFd);
+		unlink(sa.sun_path);
+		delete ring;
+		return errnoHost2Mint(err, TOS_EACCES);
+	}
+	fcntl(ring->listenFd, F_SETFL, O_NONBLOCK);
+	fcntl(ring->wakeFd[0], F_SETFL, O_NONBLOCK);
+	fcntl(ring->wakeFd[1], F_SETFL, O_NONBLOCK);
+
+	rings[handle - 1] = ring;
+	ring->thread = SDL_CreateNamedThread(drainFunc, "NatFeat ring", ring);
+	if (ring->thread == NULL) {
+		panicbug("NF_RING: can't start the drain thread");
+		closeRing(handle);
+		return TOS_ENHNDL;
+	}
+
+	D(bug("NF_RING: %d: %u bytes at %08x, %s", handle, size, addr, sa.sun_path));
+	return handle;
+}
+
+void NF_Ring::closeRing(int handle)
+{
+	Ring *ring = rings[handle - 1];
+	if (ring == NULL)
+		return;
+
+	if (ring->thread) {
+		ring->quit = true;
+		if (write(ring->wakeFd[1], "", 1) < 0) {
+			D(bug("NF_RING: close %d: %s", handle, strerror(errno)));
+		}
+		SDL_WaitThread(ring->thread, NULL);
+	}
+	if (ring->clientFd >= 0)
+		close(ring->clientFd);
+	close(ring->listenFd);
+	if (ring->wakeFd[0] >= 0) {
+		close(ring->wakeFd[0]);
+		close(ring->wakeFd[1]);
+	}
+	unlink(ring->path.c_str());
+	D(bug("NF_RING: %d closed", handle));
+
+	delete ring;
+	rings[handle - 1] = NULL;
+}
+
+/*
+ * Sleep until fd is ready, or until RING_NOTIFY or close wake us up.
+ * A client that hangs up or sends anything is disconnected; the data
+ * not sent yet then goes to the next one.
+ */
+void NF_Ring::waitFor(Ring *ring, int fd, short events)
+{
+	struct pollfd pfd[3];
+	int n = 0;
+
+	pfd[n].fd = ring->wakeFd[0];
+	pfd[n++].events = POLLIN;
+	if (fd >= 0) {
+		pfd[n].fd = fd;
+		pfd[n++].events = events;
+	}
+	if (ring->clientFd >= 0 && fd != ring->clientFd) {
+		pfd[n].fd = ring->clientFd;
+		pfd[n++].events = POLLIN;
+	}
+	if (poll(pfd, n, -1) <= 0)
+		return;
+
+	if (pfd[0].revents) {
+		char buf[64];
+		while (read(ring->wakeFd[0], buf, sizeof(buf)) > 0)
+			;
+	}
+	if (ring->clientFd >= 0) {
+		for (int i = 1; i < n; i++) {
+			if (pfd[i].fd == ring->clientFd && (pfd[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+				D(bug("NF_RING: %s: client gone", ring->path.c_str()));
+				close(ring->clientFd);
+				ring->clientFd = -1;
+			}
+		}
+	}
+}
+
+/*
+ * The guest writes data[] before it advances head; the fence after
+ * reading head keeps the data reads from being done before it.
+ * A head that is out of sync with tail means the guest does not use
+ * the ring the way it was opened anymore (or reused its memory), so
+ * the thread stops without reading or writing it again.
+ */
+int NF_Ring::drainFunc(void *arg)
+{
+	Ring *ring = (Ring *)arg;
+	uint8 *data = ring->host + RING_DATA;
+	uint32 mask = ring->size - 1;
+
+	while (!ring->quit) {
+		if (ring->clientFd < 0) {
+			ring->clientFd = accept(ring->listenFd, NULL, NULL);
+			if (ring->clientFd < 0) {
+				waitFor(ring, ring->listenFd, POLLIN);
+				continue;
+			}
+			fcntl(ring->clientFd, F_SETFL, O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+			int on = 1;
+			setsockopt(ring->clientFd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+			D(bug("NF_RING: %s: client connected", ring->path.c_str()));
+		}
+
+		uint32 head = do_get_mem_long((uae_u32 *)(ring->host + RING_HEAD));
+		__sync_synchronize();
+		uint32 used = head - ring->tail;
+		if (used == 0) {
+			waitFor(ring, -1, 0);
+			continue;
+		}
+		if (used > ring->size) {
+			panicbug("NF_RING: %s: head %u and tail %u out of sync, ring stopped", ring->path.c_str(), head, ring->tail);
+			ring->stopped = true;
+			break;
+		}
+
+		uint32 offset = ring->tail & mask;
+		uint32 len = used < ring->size - offset ? used : ring->size - offset;
+		ssize_t sent = send(ring->clientFd, data + offset, len, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				waitFor(ring, ring->clientFd, POLLOUT);
+			else if (errno != EINTR) {
+				D(bug("NF_RING: %s: %s", ring->path.c_str(), strerror(errno)));
+				close(ring->clientFd);
+				ring->clientFd = -1;
+			}
+			continue;
+		}
+
+		// the data must have been read before the guest may reuse the space
+		ring->tail += sent;
+		__sync_synchronize();
+		do_put_mem_long((uae_u32 *)(ring->host + RING_TAIL), ring->tail);
+	}
+
+	return 0;
+}
+
+#endif /* NFRING_SUPPORT */
+
+/*
+vim:ts=4:sw=4:
+*/
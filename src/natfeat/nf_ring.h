@@ -0,0 +1,85 @@
+/*
+ * nf_ring.h - shared memory ring NatFeat
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef _NF_RING_H
+#define _NF_RING_H
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H)
+# define NFRING_SUPPORT 1
+#endif
+
+#ifdef NFRING_SUPPORT
+
+#include "nf_base.h"
+
+#include <string>
+
+struct SDL_Thread;
+
+/*
+ * Single producer, single consumer rings in guest RAM, each drained
+ * by a host thread to a Unix domain socket. The guest only traps for
+ * RING_NOTIFY when a ring stops being empty, so high rate logging
+ * and telemetry cost no NatFeat call per message.
+ */
+class NF_Ring : public NF_Base
+{
+	static const int MAX_RINGS = 8;
+	static const uint32 MIN_SIZE = 256;
+	static const uint32 MAX_SIZE = 16 * 1024 * 1024;
+	// offsets in the guest ring header
+	enum { RING_SIZE = 0, RING_HEAD = 4, RING_TAIL = 8, RING_DATA = 16 };
+
+	struct Ring {
+		NF_Ring *owner;
+		uint8 *host;            // guest ring header
+		uint32 size;
+		uint32 tail;            // the drain thread's copy
+		std::string path;
+		int listenFd;
+		int clientFd;
+		int wakeFd[2];          // RING_NOTIFY -> drain thread
+		SDL_Thread *thread;
+		volatile bool quit;
+		volatile bool stopped;  // drain thread gave up on the ring
+	};
+
+	Ring *rings[MAX_RINGS];
+
+	static int drainFunc(void *arg);
+	static void waitFor(Ring *ring, int fd, short events);
+	int32 openRing(memptr addr, memptr nameAddr);
+	void closeRing(int handle);
+
+  public:
+	NF_Ring();
+	~NF_Ring();
+	const char *name() { return "NF_RING"; }
+	bool isSuperOnly() { return true; }
+	int32 dispatch(uint32 fncode);
+	void reset();
+};
+
+#endif /* NFRING_SUPPORT */
+
+#endif /* _NF_RING_H */
@@ -74,6 +74,9 @@ int32 CdromDriver::dispatch(uint32 fncode)
 		case NFCD_READ:
 			ret = cd_read(getParameter(0),getParameter(1),getParameter(2),getParameter(3));
 			break;
+		case NFCD_READ_ASYNC:
+			ret = cd_read_async(getParameter(0),getParameter(1),getParameter(2),getParameter(3));
+			break;
 		case NFCD_WRITE:
 			ret = cd_write(getParameter(0),getParameter(1),getParameter(2),getParameter(3));
 			break;
@@ -189,6 +192,16 @@ int32 CdromDriver::cd_read(memptr device, memptr buffer, uint32 first, uint32 le
 	return TOS_ENOSYS;
 }
 
+int32 CdromDriver::cd_read_async(memptr device, memptr buffer, uint32 first, uint32 length)
+{
+	UNUSED(device);
+	UNUSED(buffer);
+	UNUSED(first);
+	UNUSED(length);
+	/* the caller falls back to NFCD_READ */
+	return TOS_ENOSYS;
+}
+
 int32 CdromDriver::cd_write(memptr device, memptr buffer, uint32 first, uint32 length)
 {
 	UNUSED(device);
@@ -48,6 +48,7 @@ protected:
 	virtual int32 cd_open(memptr /* metados_bos_header_t * */ device, memptr /* meta_drvinfo * */ buffer);
 	virtual int32 cd_close(memptr /* metados_bos_header_t * */ device);
 	virtual int32 cd_read(memptr /* metados_bos_header_t * */ device, memptr buffer, uint32 /* LBA */ first, uint32 length);
+	virtual int32 cd_read_async(memptr /* metados_bos_header_t * */ device, memptr buffer, uint32 /* LBA */ first, uint32 length);
 	virtual int32 cd_write(memptr /* metados_bos_header_t * */ device, memptr buffer, uint32 /* LBA */ first, uint32 length);
 	virtual int32 cd_seek(memptr /* metados_bos_header_t * */ device, uint32 /* LBA */ offset);
 	virtual int32 cd_status(memptr /* metados_bos_header_t * */ device, memptr ext_status) = 0;
@@ -27,6 +27,7 @@
 #include "nfcdrom.h"
 #include "nfcdrom_atari.h"
 #include "nfcdrom_linux.h"
+#include "nf_async.h"
 
 #include <linux/cdrom.h>
 #include <errno.h>
@@ -406,6 +407,75 @@ int32 CdromDriverLinux::cd_read(memptr device, memptr buffer, uint32 first, uint
 	return TOS_E_OK;
 }
 
+/*
+ * A read on a worker thread, from its own descriptor of the drive,
+ * so that the drive can be closed while the read is in flight.
+ */
+class CdromDriverLinux::AsyncRead : public NFAsyncJob
+{
+	CdromDriverLinux *cdrom;
+	int handle;
+	uint8 *buffer;
+	uint32 first;
+	uint32 length;
+	int err;
+
+	public:
+		AsyncRead(CdromDriverLinux *_cdrom, int drive, int _handle, uint8 *_buffer, uint32 _first, uint32 _length)
+			: NFAsyncJob(&_cdrom->cddrives[drive]), cdrom(_cdrom), handle(_handle),
+			  buffer(_buffer), first(_first), length(_length), err(0)
+		{
+		}
+
+		~AsyncRead()
+		{
+			if (handle >= 0)
+				close(handle);
+		}
+
+		int32 run()
+		{
+			ssize_t res = pread(handle, buffer, length * CD_FRAMESIZE, (off_t)first * CD_FRAMESIZE);
+			if (res < 0)
+				err = errno;
+			else if ((size_t)res != length * CD_FRAMESIZE)
+				err = EIO;	// past the end of the disc
+			close(handle);
+			handle = -1;
+			return TOS_E_OK;
+		}
+
+		int32 complete(int32 res)
+		{
+			if (err) {
+				D(bug(NFCD_NAME "ReadAsync(): can not read %d blocks", length));
+				return cdrom->errnoHost2Mint(err, TOS_ENOSYS);
+			}
+			return res;
+		}
+};
+
+int32 CdromDriverLinux::cd_read_async(memptr device, memptr buffer, uint32 first, uint32 length)
+{
+	int drive;
+
+	drive = OpenDrive(device);
+	if (drive<0) {
+		return drive;
+	}
+
+	D(bug(NFCD_NAME "ReadAsync(%d,%d)", first, length));
+
+	uint8 *hostbuf = Atari2HostBlock(buffer, length * CD_FRAMESIZE, true);
+	int handle = hostbuf != NULL ? dup(cddrives[drive].handle) : -1;
+	CloseDrive(drive);
+	if (handle < 0) {
+		return TOS_ENOSYS;
+	}
+
+	return submitAsync(new AsyncRead(this, drive, handle, hostbuf, first, length));
+}
+
 int32 CdromDriverLinux::cd_status(memptr device, memptr ext_status)
 {
 	UNUSED(ext_status);
@@ -36,6 +36,8 @@ class CdromDriverLinux : public CdromDriver
 		bool drives_scanned;
 		int numcds;
 		
+		class AsyncRead;
+
 		uint16 AtariToLinuxIoctl(uint16 opcode);	/* Translate ioctl numbers */
 
 		int CheckDrive(const char *drive, const char *mnttype, struct stat *stbuf);
@@ -47,6 +49,7 @@ class CdromDriverLinux : public CdromDriver
 		void CloseDrive(int drive);
 
 		int32 cd_read(memptr device, memptr buffer, uint32 first, uint32 length);
+		int32 cd_read_async(memptr device, memptr buffer, uint32 first, uint32 length);
 		int32 cd_status(memptr device, memptr ext_status);
 		int32 cd_ioctl(memptr device, uint16 opcode, memptr buffer);
 	
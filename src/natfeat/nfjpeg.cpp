@@ -38,6 +38,7 @@
  #error "no jpeg library found"
 #endif
 #include "toserror.h"
+#include "nf_async.h"
 
 #define DEBUG 0
 #include "debug.h"
@@ -172,6 +173,9 @@ SDL_Surface *JpegDriver::load_jpeg(SDL_RWops *src)
 	JSAMPROW rowptr[1];
 	SDL_Surface *volatile surface = NULL;
 	j_decompress_ptr cinfo;
+	/* on the stack, as async loads run in parallel */
+	struct my_error_mgr jerr;
+	struct jpeg_decompress_struct jpeg;
 	
 	memset(&jpeg, 0, sizeof(jpeg));
 	cinfo = &jpeg;
@@ -320,6 +324,9 @@ int32 JpegDriver::dispatch(uint32 fncode)
 		case NFJPEG_DECODEIMAGE:
 			ret = decode_image(getParameter(0),getParameter(1));
 			break;
+		case NFJPEG_LOADIMAGE_ASYNC:
+			ret = load_image_async(getParameter(0));
+			break;
 		default:
 			D(bug("nfjpeg: unimplemented function #%d", fncode));
 			break;
@@ -367,6 +374,7 @@ int32 JpegDriver::close_driver(memptr jpeg_ptr)
 	jpgd = (JPGD_STRUCT *)Atari2HostAddr(jpeg_ptr);
 	if (jpgd->handle <= 0 || jpgd->handle > MAX_NFJPEG_IMAGES || !images[jpgd->handle].used)
 		return DRIVERCLOSED;
+	drainAsync(&images[jpgd->handle]);
 	if (images[jpgd->handle].src)
 	{
 		SDL_FreeSurface(images[jpgd->handle].src);
@@ -385,6 +393,7 @@ int32 JpegDriver::get_image_info(memptr jpeg_ptr)
 	jpgd = (JPGD_STRUCT *)Atari2HostAddr(jpeg_ptr);
 	if (jpgd->handle <= 0 || jpgd->handle > MAX_NFJPEG_IMAGES || !images[jpgd->handle].used)
 		return DRIVERCLOSED;
+	drainAsync(&images[jpgd->handle]);
 
 	if (images[jpgd->handle].src == NULL)
 	{
@@ -408,6 +417,7 @@ int32 JpegDriver::get_image_size(memptr jpeg_ptr)
 	jpgd = (JPGD_STRUCT *)Atari2HostAddr(jpeg_ptr);
 	if (jpgd->handle <= 0 || jpgd->handle > MAX_NFJPEG_IMAGES || !images[jpgd->handle].used)
 		return DRIVERCLOSED;
+	drainAsync(&images[jpgd->handle]);
 
 	if (images[jpgd->handle].src == NULL)
 	{
@@ -446,6 +456,7 @@ int32 JpegDriver::decode_image(memptr jpeg_ptr, uint32 row)
 	jpgd = (JPGD_STRUCT *)Atari2HostAddr(jpeg_ptr);
 	if (jpgd->handle <= 0 || jpgd->handle > MAX_NFJPEG_IMAGES || !images[jpgd->handle].used)
 		return DRIVERCLOSED;
+	drainAsync(&images[jpgd->handle]);
 
 	if (images[jpgd->handle].src == NULL)
 	{
@@ -649,25 +660,20 @@ int32 JpegDriver::decode_image(memptr jpeg_ptr, uint32 row)
 	return NOERROR;
 }
 
-bool JpegDriver::load_image(JPGD_STRUCT *jpgd, memptr addr, uint32 size)
+/*
+ * Decode the image, without touching the guest or the driver state.
+ */
+SDL_Surface *JpegDriver::decode(uint8 *buffer, uint32 size)
 {
 	SDL_RWops *src;
 	SDL_Surface *surface;
-	int width, height, image_size;
-	uint8 *buffer;
-
-	D(bug("nfjpeg: load_image()"));
-
-	if (!valid_address(addr, false, size))
-		return false;
-	buffer = Atari2HostAddr(addr);
 
 	/* Load image from memory */
 	src = SDL_RWFromMem(buffer, size);
 	if (src == NULL)
 	{
 		D(bug("nfjpeg: load_image() failed in SDL_RWFromMem()"));
-		return false;
+		return NULL;
 	}
 #if defined(HAVE_JPEGLIB)
 	surface = load_jpeg(src);
@@ -678,7 +684,7 @@ bool JpegDriver::load_image(JPGD_STRUCT *jpgd, memptr addr, uint32 size)
 	if (surface == NULL)
 	{
 		panicbug("nfjpeg: load_image() failed");
-		return false;
+		return NULL;
 	}
 
 	D(bug("nfjpeg: %dx%dx%d,%d image", surface->w, surface->h, surface->format->BitsPerPixel,surface->format->BytesPerPixel));
@@ -687,6 +693,13 @@ bool JpegDriver::load_image(JPGD_STRUCT *jpgd, memptr addr, uint32 size)
 		surface->format->Gmask, surface->format->Bmask
 	));
 
+	return surface;
+}
+
+void JpegDriver::set_image(JPGD_STRUCT *jpgd, SDL_Surface *surface)
+{
+	int width, height, image_size;
+
 	images[jpgd->handle].src = surface;
 
 	/* Fill values */
@@ -714,10 +727,94 @@ bool JpegDriver::load_image(JPGD_STRUCT *jpgd, memptr addr, uint32 size)
 
 	image_size = width * surface->h * SDL_SwapBE16(jpgd->OutPixelSize);
 	jpgd->OutSize = SDL_SwapBE32(image_size);
+}
+
+bool JpegDriver::load_image(JPGD_STRUCT *jpgd, memptr addr, uint32 size)
+{
+	SDL_Surface *surface;
+
+	D(bug("nfjpeg: load_image()"));
+
+	if (!valid_address(addr, false, size))
+		return false;
+
+	surface = decode(Atari2HostAddr(addr), size);
+	if (surface == NULL)
+		return false;
 
+	set_image(jpgd, surface);
 	return true;
 }
 
+/*
+ * The decoding of NFJPEG_GETIMAGEINFO, done on a worker thread.
+ * Each image is a channel of its own.
+ */
+class JpegDriver::AsyncLoad : public NFAsyncJob
+{
+	JpegDriver *driver;
+	memptr jpeg_ptr;
+	uint32 handle;
+	uint8 *buffer;
+	uint32 size;
+	SDL_Surface *surface;
+
+public:
+	AsyncLoad(JpegDriver *_driver, memptr _jpeg_ptr, uint32 _handle, uint8 *_buffer, uint32 _size)
+		: NFAsyncJob(&_driver->images[_handle]), driver(_driver), jpeg_ptr(_jpeg_ptr),
+		  handle(_handle), buffer(_buffer), size(_size), surface(NULL)
+	{
+	}
+
+	~AsyncLoad()
+	{
+		if (surface)
+			SDL_FreeSurface(surface);
+	}
+
+	int32 run()
+	{
+		surface = driver->decode(buffer, size);
+		return surface ? NOERROR : NOTENOUGHMEMORY;
+	}
+
+	int32 complete(int32 res)
+	{
+		JPGD_STRUCT *jpgd = (JPGD_STRUCT *)Atari2HostAddr(jpeg_ptr);
+
+		/* the image may have been closed, or loaded synchronously meanwhile */
+		if (surface == NULL || jpgd->handle != handle ||
+			!driver->images[handle].used || driver->images[handle].src != NULL)
+			return res;
+
+		driver->set_image(jpgd, surface);
+		surface = NULL;
+		return res;
+	}
+};
+
+int32 JpegDriver::load_image_async(memptr jpeg_ptr)
+{
+	JPGD_STRUCT *jpgd;
+	uint8 *buffer;
+
+	D(bug("nfjpeg: load_image_async(0x%08x)",jpeg_ptr));
+
+	jpgd = (JPGD_STRUCT *)Atari2HostAddr(jpeg_ptr);
+	if (jpgd->handle <= 0 || jpgd->handle > MAX_NFJPEG_IMAGES || !images[jpgd->handle].used)
+		return DRIVERCLOSED;
+
+	/* already there, NFJPEG_GETIMAGEINFO returns at once */
+	if (images[jpgd->handle].src != NULL)
+		return TOS_ENOSYS;
+
+	buffer = Atari2HostBlock(SDL_SwapBE32(jpgd->InPointer), SDL_SwapBE32(jpgd->InSize), false);
+	if (buffer == NULL)
+		return TOS_ENOSYS;
+
+	return submitAsync(new AsyncLoad(this, jpeg_ptr, jpgd->handle, buffer, SDL_SwapBE32(jpgd->InSize)));
+}
+
 void JpegDriver::read_rgb(SDL_PixelFormat *format, void *src, int *r, int *g, int *b)
 {
 	uint32 color;
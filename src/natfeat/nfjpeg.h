@@ -62,8 +62,6 @@ private:
 	    struct jpeg_error_mgr errmgr;
 	    jmp_buf escape;
 	};
-	struct my_error_mgr jerr;
-	struct jpeg_decompress_struct jpeg;
 	static void my_error_exit(j_common_ptr cinfo);
 	SDL_Surface *load_jpeg(SDL_RWops *src);
 #endif
@@ -76,7 +74,11 @@ private:
 	int32 get_image_info(memptr jpeg_ptr);
 	int32 get_image_size(memptr jpeg_ptr);
 	int32 decode_image(memptr jpeg_ptr, uint32 row);
+	int32 load_image_async(memptr jpeg_ptr);
 
+	class AsyncLoad;
+	SDL_Surface *decode(uint8 *buffer, uint32 size);
+	void set_image(JPGD_STRUCT *jpgd_ptr, SDL_Surface *surface);
 	bool load_image(JPGD_STRUCT *jpgd_ptr, memptr addr, uint32 size);
 	void read_rgb(SDL_PixelFormat *format, void *src, int *r, int *g, int *b);
 
@@ -23,6 +23,7 @@
 #ifdef NFOSMESA_SUPPORT
 
 #include "verify.h"
+#include <vector>
 
 /*--- Assumptions ---*/
 
@@ -141,9 +142,25 @@ int32 OSMesaDriver::dispatch(uint32 fncode)
 
 	ctx_ptr = getParameter(1);
 
-	for (unsigned int i = 0; i < paramcount[fncode]; i++)
+	unsigned int count = fncode == NFOSMESA_BATCH ? 2 : paramcount[fncode];
+	for (unsigned int i = 0; i < count; i++)
 		nf_params[i] = ReadInt32(ctx_ptr + 4 * (i));
-		
+	
+	std::vector<uint32_t> batch;
+	if (fncode == NFOSMESA_BATCH)
+	{
+		readBatch(nf_params[0], nf_params[1], batch);
+		if (submitBatch(getParameter(0), batch, ret))
+		{
+			if (SDL_glctx)
+				SDL_GL_SetCurrentContext(SDL_glctx);
+			return ret;
+		}
+	}
+	
+	/* everything else has to see what the rendering threads did */
+	syncThreads();
+	
 	if (fncode != NFOSMESA_OSMESAPOSTPROCESS && fncode != GET_VERSION)
 	{
 		/*
@@ -163,6 +180,240 @@ int32 OSMesaDriver::dispatch(uint32 fncode)
 			return ret;
 	}
 	
+	if (fncode == NFOSMESA_BATCH)
+		ret = runBatch(batch, cur_context);
+	else
+		ret = call(fncode, nf_params, cur_context);
+	
+	if (SDL_glctx)
+		SDL_GL_SetCurrentContext(SDL_glctx);
+	
+	return ret;
+}
+
+/*
+ * Fetch a sequence of calls queued by the guest library.
+ *
+ * Every entry is a header word, the function number in the upper 16 bits
+ * and the number of parameter words in the lower ones, followed by the
+ * parameters, exactly as they would have been on the stack. The library
+ * only queues calls that neither return a value nor pass pointers, so
+ * nothing the guest does in between can change their outcome; it sends
+ * the queue before any other call, and whenever the context changes.
+ */
+void OSMesaDriver::readBatch(memptr commands, uint32 words, std::vector<uint32_t> &buf)
+{
+	buf.resize(words);
+	const uint8 *host = words ? Atari2HostBlock(commands, words * 4, false) : NULL;
+	
+	if (host)
+	{
+		for (uint32 i = 0; i < words; i++)
+			buf[i] = SDL_SwapBE32(((const uint32_t *)host)[i]);
+	} else
+	{
+		for (uint32 i = 0; i < words; i++)
+			buf[i] = ReadInt32(commands + 4 * i);
+	}
+}
+
+/*
+ * Execute the calls of a batch for context ctx, which is current.
+ *
+ * Returns the number of calls executed, which is less than queued if
+ * an entry is malformed.
+ */
+int32 OSMesaDriver::runBatch(const std::vector<uint32_t> &buf, uint32_t ctx)
+{
+	uint32 words = buf.size();
+	int32 done = 0;
+	for (uint32 i = 0; i < words; done++)
+	{
+		uint32 fncode = buf[i] >> 16;
+		uint32 count = buf[i] & 0xffff;
+		
+		if (fncode >= NFOSMESA_LAST || count != paramcount[fncode] ||
+			i + 1 + count > words || !isBatchable(fncode))
+		{
+			D(bug("nfosmesa: bad batch entry #%d: function %u, %u parameters", done, fncode, count));
+			break;
+		}
+		call(fncode, &buf[i + 1], ctx);
+		i += 1 + count;
+	}
+	return done;
+}
+
+/*
+ * Let the thread of the context run a batch, if it has one and every
+ * call of the batch may run there. ret is set to the number of calls
+ * then, as runBatch() would return it.
+ */
+bool OSMesaDriver::submitBatch(uint32_t ctx, std::vector<uint32_t> &buf, int32 &ret)
+{
+	if (ctx == 0 || ctx > MAX_OSMESA_CONTEXTS || !contexts[ctx].thread || contexts[ctx].error_check_enabled)
+		return false;
+	
+	uint32 words = buf.size();
+	int32 done = 0;
+	for (uint32 i = 0; i < words; done++)
+	{
+		uint32 fncode = buf[i] >> 16;
+		uint32 count = buf[i] & 0xffff;
+		
+		if (fncode >= NFOSMESA_LAST || count != paramcount[fncode] ||
+			i + 1 + count > words || !isAsync(fncode, &buf[i + 1]))
+			return false;
+		i += 1 + count;
+	}
+	
+	/* the context can only be current on one thread */
+	if (cur_context == ctx)
+	{
+		contexts[ctx].ctx->ClearCurrent();
+		cur_context = 0;
+	}
+	contexts[ctx].thread->submit(buf);
+	ret = done;
+	return true;
+}
+
+void OSMesaDriver::syncThreads(void)
+{
+	for (int i = 1; i <= MAX_OSMESA_CONTEXTS; i++)
+		if (contexts[i].thread)
+			contexts[i].thread->sync();
+}
+
+/*
+ * Calls with special handling in dispatch() can't be queued.
+ */
+bool OSMesaDriver::isBatchable(uint32 fncode)
+{
+	switch (fncode)
+	{
+		case GET_VERSION:
+		case NFOSMESA_LENGLGETSTRING:
+		case NFOSMESA_PUTGLGETSTRING:
+		case NFOSMESA_LENGLGETSTRINGI:
+		case NFOSMESA_PUTGLGETSTRINGI:
+		case NFOSMESA_OSMESACREATECONTEXT:
+		case NFOSMESA_OSMESACREATECONTEXTEXT:
+		case NFOSMESA_OSMESACREATECONTEXTATTRIBS:
+		case NFOSMESA_OSMESADESTROYCONTEXT:
+		case NFOSMESA_OSMESAMAKECURRENT:
+		case NFOSMESA_OSMESAGETCURRENTCONTEXT:
+		case NFOSMESA_OSMESAPIXELSTORE:
+		case NFOSMESA_OSMESAGETINTEGERV:
+		case NFOSMESA_OSMESAGETDEPTHBUFFER:
+		case NFOSMESA_OSMESAGETCOLORBUFFER:
+		case NFOSMESA_OSMESAGETPROCADDRESS:
+		case NFOSMESA_OSMESACOLORCLAMP:
+		case NFOSMESA_OSMESAPOSTPROCESS:
+		case NFOSMESA_BATCH:
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Calls that may run on the thread of a context: besides neither
+ * returning a value nor passing pointers, they must not touch any
+ * state of OSMesaDriver but the damage of their context. These are
+ * the ones the guest library queues.
+ */
+bool OSMesaDriver::isAsync(uint32 fncode, const uint32_t *nf_params)
+{
+	switch (fncode)
+	{
+		case NFOSMESA_GLENABLE:
+		case NFOSMESA_GLDISABLE:
+			return getStackedParameter(0) != GL_NFOSMESA_ERROR_CHECK;
+		case NFOSMESA_GLALPHAFUNC:
+		case NFOSMESA_GLBEGIN:
+		case NFOSMESA_GLBINDTEXTURE:
+		case NFOSMESA_GLBLENDFUNC:
+		case NFOSMESA_GLCALLLIST:
+		case NFOSMESA_GLCLEAR:
+		case NFOSMESA_GLCLEARCOLOR:
+		case NFOSMESA_GLCLEARDEPTH:
+		case NFOSMESA_GLCOLOR3D:
+		case NFOSMESA_GLCOLOR3F:
+		case NFOSMESA_GLCOLOR3UB:
+		case NFOSMESA_GLCOLOR4D:
+		case NFOSMESA_GLCOLOR4F:
+		case NFOSMESA_GLCOLOR4UB:
+		case NFOSMESA_GLCOLORMASK:
+		case NFOSMESA_GLCULLFACE:
+		case NFOSMESA_GLDEPTHFUNC:
+		case NFOSMESA_GLDEPTHMASK:
+		case NFOSMESA_GLEDGEFLAG:
+		case NFOSMESA_GLEND:
+		case NFOSMESA_GLFOGF:
+		case NFOSMESA_GLFOGI:
+		case NFOSMESA_GLFRONTFACE:
+		case NFOSMESA_GLHINT:
+		case NFOSMESA_GLINDEXF:
+		case NFOSMESA_GLINDEXI:
+		case NFOSMESA_GLLIGHTF:
+		case NFOSMESA_GLLIGHTI:
+		case NFOSMESA_GLLIGHTMODELF:
+		case NFOSMESA_GLLIGHTMODELI:
+		case NFOSMESA_GLLINEWIDTH:
+		case NFOSMESA_GLLOADIDENTITY:
+		case NFOSMESA_GLMATERIALF:
+		case NFOSMESA_GLMATERIALI:
+		case NFOSMESA_GLMATRIXMODE:
+		case NFOSMESA_GLMULTITEXCOORD2F:
+		case NFOSMESA_GLMULTITEXCOORD2FARB:
+		case NFOSMESA_GLNORMAL3D:
+		case NFOSMESA_GLNORMAL3F:
+		case NFOSMESA_GLPOINTSIZE:
+		case NFOSMESA_GLPOLYGONMODE:
+		case NFOSMESA_GLPOPMATRIX:
+		case NFOSMESA_GLPUSHMATRIX:
+		case NFOSMESA_GLRECTF:
+		case NFOSMESA_GLRECTI:
+		case NFOSMESA_GLROTATED:
+		case NFOSMESA_GLROTATEF:
+		case NFOSMESA_GLSCALED:
+		case NFOSMESA_GLSCALEF:
+		case NFOSMESA_GLSHADEMODEL:
+		case NFOSMESA_GLTEXCOORD1F:
+		case NFOSMESA_GLTEXCOORD2D:
+		case NFOSMESA_GLTEXCOORD2F:
+		case NFOSMESA_GLTEXCOORD3F:
+		case NFOSMESA_GLTEXCOORD4F:
+		case NFOSMESA_GLTEXENVF:
+		case NFOSMESA_GLTEXENVI:
+		case NFOSMESA_GLTEXPARAMETERF:
+		case NFOSMESA_GLTEXPARAMETERI:
+		case NFOSMESA_GLTRANSLATED:
+		case NFOSMESA_GLTRANSLATEF:
+		case NFOSMESA_GLVERTEX2D:
+		case NFOSMESA_GLVERTEX2F:
+		case NFOSMESA_GLVERTEX2I:
+		case NFOSMESA_GLVERTEX2S:
+		case NFOSMESA_GLVERTEX3D:
+		case NFOSMESA_GLVERTEX3F:
+		case NFOSMESA_GLVERTEX3I:
+		case NFOSMESA_GLVERTEX3S:
+		case NFOSMESA_GLVERTEX4D:
+		case NFOSMESA_GLVERTEX4F:
+		case NFOSMESA_GLVIEWPORT:
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Execute a call for context ctx, which is current; that is cur_context,
+ * but on the thread of the context.
+ */
+int32 OSMesaDriver::call(uint32 fncode, const uint32_t *nf_params, uint32_t ctx)
+{
+	int32 ret = 0;
+	
 	switch(fncode)
 	{
 		case GET_VERSION:
@@ -251,8 +502,10 @@ int32 OSMesaDriver::dispatch(uint32 fncode)
 	}
 /*	D(bug("nfosmesa: function returning with 0x%08x", ret));*/
 
+	trackDamage(ctx, fncode, nf_params);
+
 #if DEBUG
-	if (contexts[cur_context].error_check_enabled)
+	if (contexts[ctx].error_check_enabled)
 	{
 		GLenum last;
 		const char *funcname = "???";
@@ -263,7 +516,7 @@ int32 OSMesaDriver::dispatch(uint32 fncode)
 				funcname = gl_functionnames[i].name;
 				break;
 			}
-		last = contexts[cur_context].error_code;
+		last = contexts[ctx].error_code;
 		if (last != GL_NO_ERROR)
 		{
 			PrintErrors(funcname);
@@ -275,17 +528,99 @@ int32 OSMesaDriver::dispatch(uint32 fncode)
 		 * stash back the last error code, so
 		 * the application can still fetch it
 		 */
-		contexts[cur_context].error_code = last;
+		contexts[ctx].error_code = last;
 	}
 #endif
 	
-	if (SDL_glctx)
-		SDL_GL_SetCurrentContext(SDL_glctx);
-	
 	return ret;
 }
 
 
+/*
+ * Tell the context which part of the color buffer a call may have
+ * drawn to, so ConvertContext() only has to convert that. Primitives
+ * are clipped to the viewport; the calls below that are not, or that
+ * can't be seen into, like display lists, damage the whole buffer.
+ */
+void OSMesaDriver::trackDamage(uint32_t context, uint32 fncode, const uint32_t *nf_params)
+{
+	OffscreenContext *ctx = contexts[context].ctx;
+	
+	if (context == 0 || !ctx)
+		return;
+	
+	switch (fncode)
+	{
+		case NFOSMESA_GLVIEWPORT:
+			ctx->Damage(getStackedParameter(0), getStackedParameter(1), getStackedParameter(2), getStackedParameter(3));
+			break;
+		case NFOSMESA_GLPOINTSIZE:
+		case NFOSMESA_GLLINEWIDTH:
+			ctx->DamageWidth(getStackedFloat(0));
+			break;
+		case NFOSMESA_GLPOPATTRIB:
+			ctx->DamageState();
+			break;
+		case NFOSMESA_GLCLEAR:
+			if (fn.glIsEnabled(GL_SCISSOR_TEST))
+			{
+				GLint box[4];
+				fn.glGetIntegerv(GL_SCISSOR_BOX, box);
+				ctx->Damage(box[0], box[1], box[2], box[3]);
+			} else
+			{
+				ctx->DamageAll();
+			}
+			break;
+		case NFOSMESA_GLACCUM:
+		case NFOSMESA_GLBITMAP:
+		case NFOSMESA_GLBLITFRAMEBUFFER:
+		case NFOSMESA_GLBLITFRAMEBUFFEREXT:
+		case NFOSMESA_GLBLITNAMEDFRAMEBUFFER:
+		case NFOSMESA_GLCALLLIST:
+		case NFOSMESA_GLCALLLISTS:
+		case NFOSMESA_GLCLEARBUFFERFI:
+		case NFOSMESA_GLCLEARBUFFERFV:
+		case NFOSMESA_GLCLEARBUFFERIV:
+		case NFOSMESA_GLCLEARBUFFERUIV:
+		case NFOSMESA_GLCLEARNAMEDFRAMEBUFFERFI:
+		case NFOSMESA_GLCLEARNAMEDFRAMEBUFFERFV:
+		case NFOSMESA_GLCLEARNAMEDFRAMEBUFFERIV:
+		case NFOSMESA_GLCLEARNAMEDFRAMEBUFFERUIV:
+		case NFOSMESA_GLCOPYPIXELS:
+		case NFOSMESA_GLDRAWPIXELS:
+		case NFOSMESA_GLDRAWTEXTURENV:
+			ctx->DamageAll();
+			break;
+		/* state that makes every later primitive unbounded */
+		case NFOSMESA_GLENABLE:
+			if (getStackedParameter(0) == GL_PROGRAM_POINT_SIZE)
+				ctx->DamageAlways();
+			break;
+		case NFOSMESA_GLPOINTPARAMETERF:
+		case NFOSMESA_GLPOINTPARAMETERFV:
+		case NFOSMESA_GLPOINTPARAMETERI:
+		case NFOSMESA_GLPOINTPARAMETERIV:
+		case NFOSMESA_GLPOINTPARAMETERFARB:
+		case NFOSMESA_GLPOINTPARAMETERFVARB:
+		case NFOSMESA_GLPOINTPARAMETERFEXT:
+		case NFOSMESA_GLPOINTPARAMETERFVEXT:
+		case NFOSMESA_GLPOINTPARAMETERFSGIS:
+		case NFOSMESA_GLPOINTPARAMETERFVSGIS:
+		case NFOSMESA_GLPOINTPARAMETERINV:
+		case NFOSMESA_GLPOINTPARAMETERIVNV:
+		case NFOSMESA_GLPOINTPARAMETERXVOES:
+		case NFOSMESA_GLVIEWPORTARRAYV:
+		case NFOSMESA_GLVIEWPORTINDEXEDF:
+		case NFOSMESA_GLVIEWPORTINDEXEDFV:
+		case NFOSMESA_GLVIEWPORTSWIZZLENV:
+		case NFOSMESA_GLVIEWPORTPOSITIONWSCALENV:
+			ctx->DamageAlways();
+			break;
+	}
+}
+
+
 GLenum OSMesaDriver::PrintErrors(const char *funcname)
 {
 	GLenum err, last;
@@ -710,6 +1045,18 @@ uint32_t OSMesaDriver::nfOSMesaCreateContextExt(const uint32_t *nf_params)
 	}
 	context->share_ctx = sharelist;
 	num_contexts++;
+
+	/* the OpenGL contexts stay on the thread of SDL */
+	if (bx_options.osmesa.threaded && !context->ctx->IsOpengl())
+	{
+		context->thread = new OSMesaThread(this, j);
+		if (!context->thread->start())
+		{
+			D(bug("nfosmesa: can't start the rendering thread of context %d", j));
+			delete context->thread;
+			context->thread = NULL;
+		}
+	}
 	return j;
 }
 
@@ -723,6 +1070,11 @@ void OSMesaDriver::OSMesaDestroyContextInternal(uint32_t ctx)
 	}
 	context_t *context = &contexts[ctx];
 	
+	if (context->thread)
+	{
+		delete context->thread;
+		context->thread = NULL;
+	}
 	delete context->ctx;
 	context->ctx = NULL;
 	
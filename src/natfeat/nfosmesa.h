@@ -33,6 +33,7 @@
 
 #include "nf_base.h"
 #include "parameters.h"
+#include <vector>
 
 /*--- Defines ---*/
 
@@ -166,9 +167,12 @@ typedef struct {
 } fbo_buffer;
 
 class OffscreenContext;
+class OSMesaThread;
 
 typedef struct {
 	OffscreenContext *ctx;
+	/* runs the batches of the context, if rendering is threaded */
+	OSMesaThread *thread;
 	GLenum render_mode;
 	GLenum error_code;
 	void *feedback_buffer_host;
@@ -235,6 +239,8 @@ typedef struct {
 
 class OSMesaDriver : public NF_Base
 {
+	friend class OSMesaThread;
+
 protected:
 	/* contexts[0] unused */
 	context_t contexts[MAX_OSMESA_CONTEXTS+1];
@@ -258,6 +264,14 @@ protected:
 	void CloseGLLibrary(void);
 	static void InitPointersOSMesa(void *handle);
 	bool SelectContext(uint32_t ctx);
+	int32 call(uint32 fncode, const uint32_t *nf_params, uint32_t ctx);
+	void readBatch(memptr commands, uint32 words, std::vector<uint32_t> &buf);
+	int32 runBatch(const std::vector<uint32_t> &buf, uint32_t ctx);
+	static bool isBatchable(uint32 fncode);
+	static bool isAsync(uint32 fncode, const uint32_t *nf_params);
+	bool submitBatch(uint32_t ctx, std::vector<uint32_t> &buf, int32 &ret);
+	void syncThreads(void);
+	void trackDamage(uint32_t ctx, uint32 fncode, const uint32_t *nf_params);
 	void ConvertContext(uint32_t ctx);
 
 	void glSetError(GLenum e);
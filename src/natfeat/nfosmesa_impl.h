@@ -33,6 +33,7 @@
 #define PRI_PTR "0x%08x"
 
 #include "osmesa_context.h"
+#include "osmesa_thread.h"
 
 #define DEBUG 0
 #include "debug.h"
@@ -221,6 +221,10 @@ int32 VdiDriver::dispatch(uint32 fncode)
 			                  getParameter(10),			// logic operation
 			                  (memptr)getParameter(11));		// clip rectangle
 			break;
+		case FVDI_BATCH:
+			ret = runBatch((memptr)getParameter(0),		// commands*
+			               getParameter(1));			// count
+			break;
 		case FVDI_GET_HWCOLOR:
 			getHwColor(getParameter(0), getParameter(1), getParameter(2), getParameter(3), getParameter(4));
 			break;
@@ -258,6 +262,48 @@ int32 VdiDriver::dispatch(uint32 fncode)
 	return ret;
 }
 
+/**
+ * Run a list of drawing calls, saving a NatFeat call for each of them
+ * (see FVDI_BATCH in fvdidrv_nfapi.h). Returns the number of calls done.
+ **/
+int32 VdiDriver::runBatch(memptr commands, uint32 count)
+{
+	uint32 done;
+
+	for(done = 0; done < count; done++) {
+		uint32 header = ReadInt32(commands);
+		uint32 fncode = header >> 16;
+		uint32 params = header & 0xffff;
+
+		switch(fncode) {
+			case FVDI_PUT_PIXEL:
+			case FVDI_EXPAND_AREA:
+			case FVDI_FILL_AREA:
+			case FVDI_BLIT_AREA:
+			case FVDI_LINE:
+			case FVDI_FILL_POLYGON:
+			case FVDI_TEXT_AREA:
+				break;
+			default:
+				D(bug("nfvdi: function #%d can't be batched", fncode));
+				return done;
+		}
+		if (params > FVDI_BATCH_MAX_PARAMS)
+			return done;
+
+		memptr caller = nf_setparameters(commands + 4);
+		int32 ret = dispatch(fncode);
+		nf_setparameters(caller);
+		if (ret != 1)
+			break;
+
+		commands += 4 + params * 4;
+	}
+
+	D(bug("nfvdi: batch of %d calls, %d done", count, done));
+	return done;
+}
+
 VdiDriver::VdiDriver()
 	: surface(NULL)
 {
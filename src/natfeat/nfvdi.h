@@ -223,6 +223,8 @@ private:
 	SDL_Cursor *cursor;
 
 	int events, new_event, mouse_x, mouse_y, buttons, wheel, vblank;
+
+	int32 runBatch(memptr commands, uint32 count);
  
 	/* Blit memory to memory */
 	int32 blitArea_M2M(memptr vwk, memptr src, int32 sx, int32 sy,
@@ -0,0 +1,328 @@
+/*
+ * nfvdi_expand.cpp - monochrome expansion kernels of the software fVDI driver
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "nfvdi_expand.h"
+
+#include <cstring>
+
+#if (defined(X86_ASSEMBLY) || defined(X86_64_ASSEMBLY)) && defined(__SSE2__)
+# include <emmintrin.h>
+# define USE_SSE2_EXPAND 1
+/* AVX2 versions are compiled with the target attribute and used if the CPU has it */
+# if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#  include <immintrin.h>
+#  define USE_AVX2_EXPAND 1
+# endif
+#endif
+
+/* the MD_* modes of nfvdi.h */
+enum { REPLACE = 1, TRANS, XOR, ERASE };
+
+/*--- Scalar ---*/
+
+template <typename T, int mode>
+static inline void expandPixels(T *dst, const uint16 *bits, int from, int to, T fg, T bg)
+{
+	for(int i = from; i < to; i++) {
+		bool set = (bits[i >> 4] >> (i & 15)) & 1;
+		switch(mode) {
+			case REPLACE:
+				dst[i] = set ? fg : bg;
+				break;
+			case TRANS:
+				if (set)
+					dst[i] = fg;
+				break;
+			case XOR:
+				if (set)
+					dst[i] = ~dst[i];
+				break;
+			case ERASE:
+				if (!set)
+					dst[i] = bg;
+				break;
+		}
+	}
+}
+
+template <typename T, int mode>
+static void expandRowScalar(uint8 *dst, const uint16 *bits, int w, uint32 fg, uint32 bg)
+{
+	expandPixels<T, mode>((T *)dst, bits, 0, w, (T)fg, (T)bg);
+}
+
+/*--- SSE2 ---*/
+
+#ifdef USE_SSE2_EXPAND
+
+/*
+ * 16 pixels take sizeof(T) vectors; this is the lane mask of
+ * vector k for the 16 bits in m.
+ */
+template <typename T>
+static inline __m128i laneMask128(uint32 m, int k);
+
+template <>
+inline __m128i laneMask128<uint8>(uint32 m, int /* k */)
+{
+	const __m128i sel = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+	/* the low byte of m for pixels 0-7, the high one for 8-15 */
+	__m128i v = _mm_unpacklo_epi64(_mm_set1_epi8((char)m), _mm_set1_epi8((char)(m >> 8)));
+	return _mm_cmpeq_epi8(_mm_and_si128(v, sel), sel);
+}
+
+template <>
+inline __m128i laneMask128<uint16>(uint32 m, int k)
+{
+	const __m128i sel = _mm_set_epi16(128, 64, 32, 16, 8, 4, 2, 1);
+	__m128i v = _mm_set1_epi16((short)(m >> (8 * k)));
+	return _mm_cmpeq_epi16(_mm_and_si128(v, sel), sel);
+}
+
+template <>
+inline __m128i laneMask128<uint32>(uint32 m, int k)
+{
+	const __m128i sel = _mm_set_epi32(8, 4, 2, 1);
+	__m128i v = _mm_set1_epi32(m >> (4 * k));
+	return _mm_cmpeq_epi32(_mm_and_si128(v, sel), sel);
+}
+
+template <typename T>
+static inline __m128i broadcast128(uint32 c)
+{
+	switch(sizeof(T)) {
+		case 1:
+			return _mm_set1_epi8((char)c);
+		case 2:
+			return _mm_set1_epi16((short)c);
+		default:
+			return _mm_set1_epi32(c);
+	}
+}
+
+template <int mode>
+static inline void expandVector128(__m128i *p, __m128i mask, __m128i fg, __m128i bg)
+{
+	__m128i d;
+
+	switch(mode) {
+		case REPLACE:
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(mask, fg), _mm_andnot_si128(mask, bg)));
+			break;
+		case TRANS:
+			d = _mm_loadu_si128(p);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(mask, fg), _mm_andnot_si128(mask, d)));
+			break;
+		case XOR:
+			d = _mm_loadu_si128(p);
+			_mm_storeu_si128(p, _mm_xor_si128(d, mask));
+			break;
+		case ERASE:
+			d = _mm_loadu_si128(p);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(mask, d), _mm_andnot_si128(mask, bg)));
+			break;
+	}
+}
+
+template <typename T, int mode>
+static void expandRowSSE2(uint8 *dst, const uint16 *bits, int w, uint32 fg, uint32 bg)
+{
+	__m128i fgv = broadcast128<T>(fg);
+	__m128i bgv = broadcast128<T>(bg);
+	int i;
+
+	for(i = 0; i + 16 <= w; i += 16) {
+		__m128i *p = (__m128i *)(dst + i * sizeof(T));
+		uint32 m = bits[i >> 4];
+		for(int k = 0; k < (int)sizeof(T); k++)
+			expandVector128<mode>(p + k, laneMask128<T>(m, k), fgv, bgv);
+	}
+	expandPixels<T, mode>((T *)dst, bits, i, w, (T)fg, (T)bg);
+}
+
+#endif /* USE_SSE2_EXPAND */
+
+/*--- AVX2, 16 and 32 bit pixels ---*/
+
+#ifdef USE_AVX2_EXPAND
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+template <typename T>
+static inline TARGET_AVX2 __m256i laneMask256(uint32 m, int k);
+
+template <>
+inline TARGET_AVX2 __m256i laneMask256<uint16>(uint32 m, int /* k */)
+{
+	const __m256i sel = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128,
+		0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000, (short)0x8000);
+	__m256i v = _mm256_set1_epi16((short)m);
+	return _mm256_cmpeq_epi16(_mm256_and_si256(v, sel), sel);
+}
+
+template <>
+inline TARGET_AVX2 __m256i laneMask256<uint32>(uint32 m, int k)
+{
+	const __m256i sel = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256i v = _mm256_set1_epi32(m >> (8 * k));
+	return _mm256_cmpeq_epi32(_mm256_and_si256(v, sel), sel);
+}
+
+template <int mode>
+static inline TARGET_AVX2 void expandVector256(__m256i *p, __m256i mask, __m256i fg, __m256i bg)
+{
+	__m256i d;
+
+	switch(mode) {
+		case REPLACE:
+			_mm256_storeu_si256(p, _mm256_blendv_epi8(bg, fg, mask));
+			break;
+		case TRANS:
+			d = _mm256_loadu_si256(p);
+			_mm256_storeu_si256(p, _mm256_blendv_epi8(d, fg, mask));
+			break;
+		case XOR:
+			d = _mm256_loadu_si256(p);
+			_mm256_storeu_si256(p, _mm256_xor_si256(d, mask));
+			break;
+		case ERASE:
+			d = _mm256_loadu_si256(p);
+			_mm256_storeu_si256(p, _mm256_blendv_epi8(bg, d, mask));
+			break;
+	}
+}
+
+template <typename T, int mode>
+static TARGET_AVX2 void expandRowAVX2(uint8 *dst, const uint16 *bits, int w, uint32 fg, uint32 bg)
+{
+	__m256i fgv = sizeof(T) == 2 ? _mm256_set1_epi16((short)fg) : _mm256_set1_epi32(fg);
+	__m256i bgv = sizeof(T) == 2 ? _mm256_set1_epi16((short)bg) : _mm256_set1_epi32(bg);
+	int i;
+
+	for(i = 0; i + 16 <= w; i += 16) {
+		__m256i *p = (__m256i *)(dst + i * sizeof(T));
+		uint32 m = bits[i >> 4];
+		for(int k = 0; k < (int)sizeof(T) / 2; k++)
+			expandVector256<mode>(p + k, laneMask256<T>(m, k), fgv, bgv);
+	}
+	expandPixels<T, mode>((T *)dst, bits, i, w, (T)fg, (T)bg);
+}
+
+#endif /* USE_AVX2_EXPAND */
+
+/*--- Dispatch ---*/
+
+#define KERNELS(variant, T) \
+	{ variant<T, REPLACE>, variant<T, TRANS>, variant<T, XOR>, variant<T, ERASE> }
+
+/* [bytes per pixel 1, 2, 4][mode - 1] */
+typedef ExpandRowFunc KernelTable[3][4];
+
+static const KernelTable scalarKernels = {
+	KERNELS(expandRowScalar, uint8),
+	KERNELS(expandRowScalar, uint16),
+	KERNELS(expandRowScalar, uint32)
+};
+
+#ifdef USE_SSE2_EXPAND
+static const KernelTable sse2Kernels = {
+	KERNELS(expandRowSSE2, uint8),
+	KERNELS(expandRowSSE2, uint16),
+	KERNELS(expandRowSSE2, uint32)
+};
+#endif
+
+#ifdef USE_AVX2_EXPAND
+static const KernelTable avx2Kernels = {
+	/* 16 8 bit pixels fill an SSE2 vector already */
+	KERNELS(expandRowSSE2, uint8),
+	KERNELS(expandRowAVX2, uint16),
+	KERNELS(expandRowAVX2, uint32)
+};
+#endif
+
+static const KernelTable *kernels;
+static const char *variant;
+
+bool setExpandRowVariant(const char *name)
+{
+#ifdef USE_AVX2_EXPAND
+	if (strcmp(name, "avx2") == 0) {
+		__builtin_cpu_init();
+		if (!__builtin_cpu_supports("avx2"))
+			return false;
+		kernels = &avx2Kernels;
+		variant = "avx2";
+		return true;
+	}
+#endif
+#ifdef USE_SSE2_EXPAND
+	if (strcmp(name, "sse2") == 0) {
+		kernels = &sse2Kernels;
+		variant = "sse2";
+		return true;
+	}
+#endif
+	if (strcmp(name, "scalar") == 0) {
+		kernels = &scalarKernels;
+		variant = "scalar";
+		return true;
+	}
+	return false;
+}
+
+static void selectKernels(void)
+{
+	if (!setExpandRowVariant("avx2") && !setExpandRowVariant("sse2"))
+		setExpandRowVariant("scalar");
+}
+
+const char *getExpandRowVariant(void)
+{
+	if (kernels == NULL)
+		selectKernels();
+	return variant;
+}
+
+ExpandRowFunc getExpandRow(int bytesPerPixel, int logOp)
+{
+	if (kernels == NULL)
+		selectKernels();
+	if (logOp < REPLACE || logOp > ERASE)
+		return NULL;
+
+	switch(bytesPerPixel) {
+		case 1:
+			return (*kernels)[0][logOp - 1];
+		case 2:
+			return (*kernels)[1][logOp - 1];
+		case 4:
+			return (*kernels)[2][logOp - 1];
+	}
+	return NULL;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,51 @@
+/*
+ * nfvdi_expand.h - monochrome expansion kernels of the software fVDI driver
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NFVDI_EXPAND_H
+#define NFVDI_EXPAND_H
+
+#include "sysdeps.h"
+
+/*
+ * Expand w pixels of a monochrome row to dst, a row of 8, 16 or 32
+ * bit pixels. Pixel i is set if bit (i & 15) of bits[i >> 4] is, so
+ * the leftmost pixel is the least significant bit; patterns can thus
+ * be passed as they are, bitmaps have to be bit reversed.
+ *
+ *  MD_REPLACE  set pixels get fgColor, the others bgColor
+ *  MD_TRANS    set pixels get fgColor
+ *  MD_XOR      set pixels are inverted
+ *  MD_ERASE    pixels not set get bgColor
+ */
+typedef void (*ExpandRowFunc)(uint8 *dst, const uint16 *bits, int w,
+	uint32 fgColor, uint32 bgColor);
+
+/* the kernel for 1, 2 or 4 bytes per pixel and an MD_* mode, or NULL */
+extern ExpandRowFunc getExpandRow(int bytesPerPixel, int logOp);
+
+/* "avx2", "sse2" or "scalar", chosen for the host CPU on first use */
+extern const char *getExpandRowVariant(void);
+/* use another variant, for the benchmark; false if not supported */
+extern bool setExpandRowVariant(const char *name);
+
+#endif /* NFVDI_EXPAND_H */
@@ -25,11 +25,13 @@
 #include "host_surface.h"
 #include "nfvdi.h"
 #include "nfvdi_soft.h"
+#include "nfvdi_expand.h"
 
 #define DEBUG 0
 #include "debug.h"
 
 #include <cstring>
+#include <algorithm>
 
 /*--- Defines ---*/
 
@@ -55,10 +57,16 @@ SoftVdiDriver::SoftVdiDriver()
 						  && SDL_VERSIONNUM(version.major, version.minor, version.patch) <= SDL_VERSIONNUM(1,2,13))
 	/* SDL 2.x seems to not allow blitting inside the same surface at all */
 						|| SDL_VERSIONNUM(version.major, version.minor, version.patch) >= SDL_VERSIONNUM(2,0,0);
+
+	glyphBpp = 0;
+	blitCacheBytes = 0;
+	blitCacheClock = 0;
 }
 
 SoftVdiDriver::~SoftVdiDriver()
 {
+	flushBlitCache();
+	trimScratchSurfaces(0);
 }
 
 /*--- Private functions ---*/
@@ -407,17 +415,20 @@ int32 SoftVdiDriver::expandArea(memptr vwk, memptr src, int32 sx, int32 sy,
 			return 0;
 		}
 
-		SDL_Surface *asurf = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, 32,
-				sdl_surf->format->Rmask, sdl_surf->format->Gmask, sdl_surf->format->Bmask, 0xFF000000);
+		SDL_Surface *asurf = getScratchSurface(w, h, sdl_surf->format, 0xFF000000);
 		if ( asurf == NULL ) return 0;
+		/* pooled surfaces may be larger than needed */
+		SDL_Rect identRect = { 0, 0, Uint16(w), Uint16(h) };
 
 		if (logOp == MD_REPLACE) {
 			D(bug("fVDI: expandArea 8bit: logOp=%d screen=%p, format=%p [%d]", logOp, sdl_surf, sdl_surf->format, sdl_surf->format->BytesPerPixel));
 
 			/* no alpha surface */
-			SDL_Surface *blocksurf = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, sdl_surf->format->BitsPerPixel,
-					sdl_surf->format->Rmask, sdl_surf->format->Gmask, sdl_surf->format->Bmask, 0xFF000000);
-			if ( blocksurf == NULL ) return 0;
+			SDL_Surface *blocksurf = getScratchSurface(w, h, sdl_surf->format, 0xFF000000);
+			if ( blocksurf == NULL ) {
+				putScratchSurface(asurf);
+				return 0;
+			}
 
 			/* fill with the background color */
 			for(uint16 j = 0; j < h; j++) {
@@ -432,9 +443,9 @@ int32 SoftVdiDriver::expandArea(memptr vwk, memptr src, int32 sx, int32 sy,
 					*dst++ = fgColor | (ReadInt8(data + j * pitch + i) << 24);
 				}
 			}
-			SDL_Rect identRect = { 0, 0, Uint16(w), Uint16(h) };
-			SDL_BlitSurface(asurf,NULL,blocksurf,&identRect);
-			SDL_FreeSurface(asurf);
+			SDL_Rect blockRect = identRect;
+			SDL_BlitSurface(asurf,&identRect,blocksurf,&blockRect);
+			putScratchSurface(asurf);
 
 			/* blit the whole thing to the screen */
 			asurf = blocksurf;
@@ -466,14 +477,19 @@ int32 SoftVdiDriver::expandArea(memptr vwk, memptr src, int32 sx, int32 sy,
 		D(bug("fVDI: %s %x, %d, %d", "8BIT expandArea - src: data address, MFDB wdwidth << 1, bitplanes", data, pitch, ReadInt16( src + MFDB_NPLANES )));
 
 		SDL_Rect destRect = { Sint16(dx), Sint16(dy), Uint16(w), Uint16(h) };
-		SDL_BlitSurface(asurf,NULL,surface->getSdlSurface(),&destRect);
-		SDL_FreeSurface(asurf);
+		SDL_BlitSurface(asurf,&identRect,surface->getSdlSurface(),&destRect);
+		putScratchSurface(asurf);
 
 		surface->setDirtyRect(dx,dy,w,h);
 		return 1;
 	}
 
 	D(bug("fVDI: expandArea M->S"));
+	if (expandRows(data, pitch, sx, dx, dy, w, h, fgColor, bgColor, logOp)) {
+		surface->setDirtyRect(dx,dy,w,h);
+		return 1;
+	}
+
 	for(uint16 j = 0; j < h; j++) {
 		D2(fprintf(stderr, "fVDI: bmp:"));
 
@@ -508,6 +524,79 @@ int32 SoftVdiDriver::expandArea(memptr vwk, memptr src, int32 sx, int32 sy,
 	return 1;
 }
 
+static inline uint16 reverseBits16(uint16 v)
+{
+	v = ((v >> 1) & 0x5555) | ((v & 0x5555) << 1);
+	v = ((v >> 2) & 0x3333) | ((v & 0x3333) << 2);
+	v = ((v >> 4) & 0x0f0f) | ((v & 0x0f0f) << 4);
+	return (v >> 8) | (v << 8);
+}
+
+/*
+ * The background colour to pass to the expansion kernels for a line or
+ * a pattern fill. In MD_ERASE mode the line and fill code has always
+ * drawn the clear pattern bits in the foreground colour, unlike
+ * expandArea(), and the kernels have to keep that.
+ */
+static inline uint32 patternBgColor(uint32 logOp, uint32 fgColor, uint32 bgColor)
+{
+	return (logOp == MD_ERASE) ? fgColor : bgColor;
+}
+
+/**
+ * The monochrome to screen expansion of expandArea() a row at a time,
+ * with the kernels of nfvdi_expand.cpp. Returns false if there is no
+ * kernel for the surface format.
+ **/
+bool SoftVdiDriver::expandRows(memptr data, uint16 pitch, int32 sx,
+	int32 dx, int32 dy, int32 w, int32 h, uint32 fgColor, uint32 bgColor,
+	uint32 logOp)
+{
+	SDL_Surface *sdl_surf = surface->getSdlSurface();
+	int bpp = sdl_surf->format->BytesPerPixel;
+	ExpandRowFunc expandRow = getExpandRow(bpp, logOp);
+	if (!expandRow)
+		return false;
+
+	/* clip to the surface, like hsPutPixel() does */
+	int x1 = std::max(dx, 0);
+	int x2 = std::min(dx + w, (int32)surface->getWidth());
+	int y1 = std::max(dy, 0);
+	int y2 = std::min(dy + h, (int32)surface->getHeight());
+	if (x1 >= x2 || y1 >= y2)
+		return true;
+
+	int cw = x2 - x1;
+	int first = sx + x1 - dx;		/* the first source pixel */
+	int shift = first & 0xf;
+	int srcWords = (shift + cw + 15) >> 4;
+	int words = (cw + 15) >> 4;
+
+	if ((int)rowBits.size() < words)
+		rowBits.resize(words);
+	if ((int)rowWords.size() < srcWords + 1)
+		rowWords.resize(srcWords + 1);
+
+	for(int j = y1; j < y2; j++) {
+		memptr line = data + (j - dy) * pitch + ((first >> 3) & ~1);
+
+		/* the bitmap words the row spans, then shifted into place */
+		for(int k = 0; k < srcWords; k++)
+			rowWords[k] = ReadInt16(line + k * 2);
+		rowWords[srcWords] = 0;
+		for(int k = 0; k < words; k++) {
+			uint16 bits = rowWords[k] << shift;
+			if (shift)
+				bits |= rowWords[k + 1] >> (16 - shift);
+			rowBits[k] = reverseBits16(bits);
+		}
+
+		uint8 *pixel = (uint8 *)sdl_surf->pixels + j * sdl_surf->pitch + x1 * bpp;
+		expandRow(pixel, &rowBits[0], cw, fgColor, bgColor);
+	}
+	return true;
+}
+
 /**
  * Fill a coloured area using a monochrome pattern.
  *
@@ -649,6 +738,11 @@ int32 SoftVdiDriver::blitArea_M2S(memptr vwk, memptr src, int32 sx, int32 sy,
 		return 1;
 	}
 
+	if (blitCachedArea(src, sx, sy, dx, dy, w, h, logOp)) {
+		surface->setDirtyRect(dx,dy,w,h);
+		return 1;
+	}
+
 	uint32 planes = ReadInt16(src + MFDB_NPLANES);			// MFDB *src->bitplanes
 	uint32 pitch  = ReadInt16(src + MFDB_WDWIDTH) * planes * 2;	// MFDB *src->pitch
 	if ( (uint32)ReadInt16( src + MFDB_STAND ) & 0x1000 ) {
@@ -778,6 +872,229 @@ int32 SoftVdiDriver::blitArea_M2S(memptr vwk, memptr src, int32 sx, int32 sy,
 	return 1;
 }
 
+static uint64 hashBytes(const uint8 *p, uint32 len)
+{
+	uint64 hash = 0xcbf29ce484222325ULL ^ len;
+	uint32 i;
+
+	for(i = 0; i + 8 <= len; i += 8) {
+		uint64 v;
+		memcpy(&v, p + i, 8);
+		hash = (hash ^ v) * 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+	for(; i < len; i++)
+		hash = (hash ^ p[i]) * 0x100000001b3ULL;
+	return hash;
+}
+
+static inline uint32 getSurfacePixel(const uint8 *p, int bpp)
+{
+	switch(bpp) {
+		case 1:
+			return *p;
+		case 2:
+			return *(const uint16 *)p;
+		default:
+			return *(const uint32 *)p;
+	}
+}
+
+/**
+ * Draw a guest bitmap that is kept converted to the surface format.
+ *
+ * Only bitmaps in plain RAM whose pixels match the surface are cached:
+ * bitplanes or 8 bit chunky on 8 bit surfaces, 16 bit on 15/16 bit
+ * and 32 bit on 32 bit ones. Every draw hashes the rows it copies,
+ * which costs far less than converting them again, and converts the
+ * rows the guest changed anew. Returns false to have the caller draw
+ * it directly.
+ **/
+bool SoftVdiDriver::blitCachedArea(memptr src, int32 sx, int32 sy,
+	int32 dx, int32 dy, int32 w, int32 h, uint32 logOp)
+{
+	if (bx_options.nfvdi.blit_cache <= 0 || w <= 0 || h <= 0 || sx < 0 || sy < 0)
+		return false;
+
+	SDL_Surface *sdl_surf = surface->getSdlSurface();
+	int bpp = sdl_surf->format->BytesPerPixel;
+	uint32 planes = ReadInt16(src + MFDB_NPLANES);
+	uint32 stand = ReadInt16(src + MFDB_STAND);
+	bool chunky = (stand & 0x100) != 0;
+
+	switch(planes) {
+		case 1:
+		case 2:
+		case 4:
+		case 8:
+			if (bpp != 1 || (chunky && planes != 8))
+				return false;
+			break;
+		case 16:
+			if (bpp != 2)
+				return false;
+			break;
+		case 32:
+			if (bpp != 4)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	uint32 wdwidth = ReadInt16(src + MFDB_WDWIDTH);
+	uint32 pitch = wdwidth * planes * 2;
+	if (stand & 0x1000)
+		pitch >>= 1;
+	uint32 width = pitch * 8 / planes;
+	uint32 height = ReadInt16(src + MFDB_HEIGHT);
+	/* bitplanes are converted 16 pixels at a time, past a narrower pitch */
+	uint32 rowBytes = pitch;
+	if (planes < 16 && !chunky)
+		rowBytes = ((width + 15) >> 4) * planes * 2;
+	if (pitch == 0 || height == 0
+	 || (uint32)(sx + w) > width || (uint32)(sy + h) > height)
+		return false;
+	uint32 size = (height - 1) * pitch + std::max(rowBytes, pitch);
+	if (size > BLIT_CACHE_MAX_BITMAP)
+		return false;
+
+	memptr addr = ReadInt32(src + MFDB_ADDRESS);
+	const uint8 *data = Atari2HostBlock(addr, size, false);
+	if (!data)
+		return false;
+
+	BlitCacheKey key(addr, ((uint64)wdwidth << 48) | ((uint64)height << 32) | (planes << 16) | stand);
+	BlitCache::iterator it = blitCache.find(key);
+	if (it != blitCache.end()) {
+		SDL_Surface *cached = it->second.surf;
+		if (cached->format->BitsPerPixel != sdl_surf->format->BitsPerPixel
+		 || cached->format->Rmask != sdl_surf->format->Rmask) {
+			blitCacheBytes -= cached->pitch * cached->h;
+			SDL_FreeSurface(cached);
+			blitCache.erase(it);
+			it = blitCache.end();
+		}
+	}
+	if (it == blitCache.end()) {
+		SDL_Surface *conv = convertBitmap(data, pitch, width, height, planes, chunky);
+		if (!conv)
+			return false;
+
+		uint64 budget = (uint64)bx_options.nfvdi.blit_cache << 20;
+		uint32 bytes = conv->pitch * conv->h;
+		while (!blitCache.empty() && blitCacheBytes + bytes > budget) {
+			BlitCache::iterator oldest = blitCache.begin();
+			for(BlitCache::iterator i = blitCache.begin(); i != blitCache.end(); ++i) {
+				if ((int32)(i->second.lastUse - oldest->second.lastUse) < 0)
+					oldest = i;
+			}
+			blitCacheBytes -= oldest->second.surf->pitch * oldest->second.surf->h;
+			SDL_FreeSurface(oldest->second.surf);
+			blitCache.erase(oldest);
+		}
+
+		BlitCacheEntry entry = BlitCacheEntry();
+		entry.surf = conv;
+		it = blitCache.insert(std::make_pair(key, entry)).first;
+		it->second.rowHash.resize(height);
+		for(uint32 j = 0; j < height; j++)
+			it->second.rowHash[j] = hashBytes(data + j * pitch, rowBytes);
+		blitCacheBytes += bytes;
+		D(bug("fVDI: %ux%ux%u bitmap at $%08x cached, %llu bytes in cache", width, height, planes, addr, (unsigned long long)blitCacheBytes));
+	} else {
+		/* convert the drawn rows the guest changed since */
+		SDL_Surface *cached = it->second.surf;
+		for(int32 j = sy; j < sy + h; j++) {
+			uint64 hash = hashBytes(data + j * pitch, rowBytes);
+			if (it->second.rowHash[j] != hash) {
+				convertBitmapRow(data + j * pitch, (uint8 *)cached->pixels + j * cached->pitch,
+					width, planes, chunky);
+				it->second.rowHash[j] = hash;
+			}
+		}
+	}
+	it->second.lastUse = ++blitCacheClock;
+
+	/* clip to the surface */
+	SDL_Surface *cached = it->second.surf;
+	int x1 = std::max(dx, 0);
+	int y1 = std::max(dy, 0);
+	int x2 = std::min(dx + w, (int32)surface->getWidth());
+	int y2 = std::min(dy + h, (int32)surface->getHeight());
+
+	for(int y = y1; y < y2; y++) {
+		const uint8 *s = (const uint8 *)cached->pixels + (sy + y - dy) * cached->pitch + (sx + x1 - dx) * bpp;
+		uint8 *d = (uint8 *)sdl_surf->pixels + y * sdl_surf->pitch + x1 * bpp;
+
+		if (logOp == S_ONLY) {
+			if (x1 < x2)
+				memcpy(d, s, (x2 - x1) * bpp);
+			continue;
+		}
+		for(int x = x1; x < x2; x++, s += bpp) {
+			uint32 destData = applyBlitLogOperation(logOp, hsGetPixel(x, y), getSurfacePixel(s, bpp));
+			hsPutPixel(x, y, destData);
+		}
+	}
+	return true;
+}
+
+/**
+ * A whole guest bitmap in the pixel format of the surface.
+ **/
+SDL_Surface *SoftVdiDriver::convertBitmap(const uint8 *data, uint32 pitch,
+	uint32 width, uint32 height, uint32 planes, bool chunky)
+{
+	SDL_PixelFormat *format = surface->getSdlSurface()->format;
+	SDL_Surface *conv = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height,
+		format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+	if (!conv)
+		return NULL;
+
+	for(uint32 j = 0; j < height; j++)
+		convertBitmapRow(data + j * pitch, (uint8 *)conv->pixels + j * conv->pitch,
+			width, planes, chunky);
+	return conv;
+}
+
+/**
+ * One row of a guest bitmap in the pixel format of the surface.
+ **/
+void SoftVdiDriver::convertBitmapRow(const uint8 *s, uint8 *d, uint32 width,
+	uint32 planes, bool chunky)
+{
+	switch(planes) {
+		case 16:
+			for(uint32 i = 0; i < width; i++)
+				((uint16 *)d)[i] = SDL_SwapBE16(((const uint16 *)s)[i]);
+			break;
+		case 32:
+			for(uint32 i = 0; i < width; i++)
+				((uint32 *)d)[i] = SDL_SwapBE32(((const uint32 *)s)[i]);
+			break;
+		default:
+			if (chunky) {
+				memcpy(d, s, width);
+				break;
+			}
+			for(uint32 i = 0; i < width; i += 16) {
+				uint8 color[16];
+				HostScreen::bitplaneToChunky((uint16 *)(s + (i >> 4) * planes * 2), planes, color);
+				memcpy(d + i, color, std::min(width - i, (uint32)16));
+			}
+			break;
+	}
+}
+
+void SoftVdiDriver::flushBlitCache(void)
+{
+	for(BlitCache::iterator it = blitCache.begin(); it != blitCache.end(); ++it)
+		SDL_FreeSurface(it->second.surf);
+	blitCache.clear();
+	blitCacheBytes = 0;
+}
+
 int32 SoftVdiDriver::blitArea_S2M(memptr vwk, memptr src, int32 sx, int32 sy,
 	memptr dest, int32 dx, int32 dy, int32 w, int32 h, uint32 logOp)
 {
@@ -1244,6 +1561,31 @@ int32 SoftVdiDriver::drawLine(memptr vwk, uint32 x1_, uint32 y1_, uint32 x2_,
 	return 1;
 }
 
+/*
+ * Read count big endian words from guest memory, in one piece
+ * if the range is plain RAM.
+ */
+static void readWords(int16 *dst, memptr addr, int count)
+{
+	const uint8 *host = count > 0 ? Atari2HostBlock(addr, count * 2, false) : NULL;
+
+	if (host) {
+		for(int i = 0; i < count; ++i)
+			dst[i] = (int16)SDL_SwapBE16(((const uint16 *)host)[i]);
+	} else {
+		for(int i = 0; i < count; ++i)
+			dst[i] = (int16)ReadInt16(addr + i * 2);
+	}
+}
+
+/**
+ * Scanline polygon fill with an active edge table: the edges are
+ * sorted by their top, enter the active list on the scanline they
+ * start and leave it after their last, and their x is stepped
+ * incrementally, giving exactly what SMUL_DIV() does for a crossing.
+ * Spans are filled with the pattern expansion kernels, so the cost
+ * follows the perimeter rather than vertices times height.
+ **/
 int32 SoftVdiDriver::fillPoly(memptr vwk, memptr points_addr, int n,
 	memptr index_addr, int moves, memptr pattern_addr, uint32 fgColor,
 	uint32 bgColor, uint32 logOp, uint32 interior_style, memptr clip)
@@ -1259,45 +1601,42 @@ int32 SoftVdiDriver::fillPoly(memptr vwk, memptr points_addr, int n,
 		return -1;      // Don't know about any special fills
 
 	// Allocate arrays for data
-	if (!AllocPoints(n) || !AllocIndices(moves) || !AllocCrossings(200))
+	if (!AllocPoints(n) || !AllocIndices(moves))
 		return -1;
 
 	uint16 pattern[16];
 	for(int i = 0; i < 16; ++i)
 		pattern[i] = ReadInt16(pattern_addr + i * 2);
 
-	int cliparray[4];
-	int* cliprect = 0;
-	if (clip) {     // Clipping is not off
-		cliprect = cliparray;
-		cliprect[0] = (int16)ReadInt32(clip);
-		cliprect[1] = (int16)ReadInt32(clip + 4);
-		cliprect[2] = (int16)ReadInt32(clip + 8);
-		cliprect[3] = (int16)ReadInt32(clip + 12);
+	if (!surface) {
+		return 1;
+	}
+	SDL_Surface *sdl_surf = surface->getSdlSurface();
+	if (!sdl_surf) {
+		return 1;
+	}
+
+	/* no clipping still means the surface */
+	int cliprect[4] = { 0, 0, surface->getWidth() - 1, surface->getHeight() - 1 };
+	if (clip) {
+		cliprect[0] = std::max(cliprect[0], (int)(int16)ReadInt32(clip));
+		cliprect[1] = std::max(cliprect[1], (int)(int16)ReadInt32(clip + 4));
+		cliprect[2] = std::min(cliprect[2], (int)(int16)ReadInt32(clip + 8));
+		cliprect[3] = std::min(cliprect[3], (int)(int16)ReadInt32(clip + 12));
 		D2(bug("fVDI: %s %d,%d:%d,%d", "clipFillTO", cliprect[0], cliprect[1],
 		       cliprect[2], cliprect[3]));
 	}
 
 	Points p(alloc_point);
 	int16* index = alloc_index;
-	int16* crossing = alloc_crossing;
 
-	for(int i = 0; i < n; ++i) {
-		p[i][0] = (int16)ReadInt16(points_addr + i * 4);
-		p[i][1] = (int16)ReadInt16(points_addr + i * 4 + 2);
-	}
+	readWords(alloc_point, points_addr, n * 2);
 	bool indices = moves;
-	for(int i = 0; i < moves; ++i)
-		index[i] = (int16)ReadInt16(index_addr + i * 2);
-
+	readWords(index, index_addr, moves);
 
 	if (!n)
 		return 1;
 
-	if (!surface) {
-		return 1;
-	}
-
 	if (!indices) {
 		if ((p[0][0] == p[n - 1][0]) && (p[0][1] == p[n - 1][1]))
 			n--;
@@ -1309,135 +1648,219 @@ int32 SoftVdiDriver::fillPoly(memptr vwk, memptr points_addr, int n,
 			moves--;
 	}
 
-	int miny = p[0][1];
-	int maxy = miny;
-	for(int i = 1; i < n; ++i) {
-		int16 y = p[i][1];
-		if (y < miny) {
-			miny = y;
+	/* the edge table; with indices, the moves given start new sub-polygons */
+	polyEdges.clear();
+	int move_n = moves;
+	int movepnt = indices ? (index[move_n] + 4) / 2 : -1;
+	for(int i = indices; i < n; ++i) {
+		int x1, y1;
+		if (indices) {
+			x1 = p[i - 1][0];
+			y1 = p[i - 1][1];
+			if (i == movepnt) {
+				if (--move_n >= 0)
+					movepnt = (index[move_n] + 4) / 2;
+				else
+					movepnt = -1;           // Never again equal to n
+				continue;
+			}
+		} else {
+			x1 = p[i ? i - 1 : n - 1][0];
+			y1 = p[i ? i - 1 : n - 1][1];
 		}
-		if (y > maxy) {
-			maxy = y;
+		int x2 = p[i][0];
+		int y2 = p[i][1];
+
+		if (y1 == y2)
+			continue;
+		if (y1 > y2) {
+			std::swap(x1, x2);
+			std::swap(y1, y2);
 		}
-	}
-	if (cliprect) {
-		if (miny < cliprect[1])
-			miny = cliprect[1];
-		if (maxy > cliprect[3])
-			maxy = cliprect[3];
-	}
+		if (y2 <= cliprect[1] || y1 > cliprect[3])
+			continue;
 
-	int minx = 1000000;
-	int maxx = -1000000;
+		PolyEdge edge;
+		edge.yTop = y1;
+		edge.yBottom = y2;
+		edge.xTop = x1;
+		edge.sign = x2 < x1 ? -1 : 1;
+		edge.h = y2 - y1;
+		edge.stepQ = (x2 - x1) * edge.sign / edge.h;
+		edge.stepR = (x2 - x1) * edge.sign % edge.h;
+		polyEdges.push_back(edge);
+	}
+	if (polyEdges.empty())
+		return 1;
+	std::sort(polyEdges.begin(), polyEdges.end());
 
-	for(int16 y = miny; y <= maxy; ++y) {
-		int ints = 0;
-		int16 x1 = 0;   // Make the compiler happy with some initializations
-		int16 y1 = 0;
-		int16 x2 = 0;
-		int16 y2 = 0;
-		int move_n = 0;
-		int movepnt = 0;
-		if (indices) {
-			move_n = moves;
-			movepnt = (index[move_n] + 4) / 2;
-			x2 = p[0][0];
-			y2 = p[0][1];
-		} else {
-			x1 = p[n - 1][0];
-			y1 = p[n - 1][1];
-		}
+	ExpandRowFunc expandRow = getExpandRow(sdl_surf->format->BytesPerPixel, logOp);
+	uint32 eraseColor = patternBgColor(logOp, fgColor, bgColor);
+	int bpp = sdl_surf->format->BytesPerPixel;
 
-		for(int i = indices; i < n; ++i) {
-			if (EnoughCrossings(ints + 1) || AllocCrossings(ints + 1))
-				crossing = alloc_crossing;
-			else
-				break;          // At least something will get drawn
+	int minx = 1000000;
+	int maxx = -1000000;
+	int miny = 1000000;
+	int maxy = -1000000;
 
-			if (indices) {
-				x1 = x2;
-				y1 = y2;
-			}
-			x2 = p[i][0];
-			y2 = p[i][1];
-			if (indices) {
-				if (i == movepnt) {
-					if (--move_n >= 0)
-						movepnt = (index[move_n] + 4) / 2;
-					else
-						movepnt = -1;           // Never again equal to n
-					continue;
-				}
+	activeEdges.clear();
+	size_t next = 0;
+	for(int y = std::max(polyEdges[0].yTop, cliprect[1]); y <= cliprect[3]; ++y) {
+		/* drop the edges that ended, step the others */
+		size_t active = 0;
+		for(size_t i = 0; i < activeEdges.size(); ++i) {
+			PolyEdge &edge = polyEdges[activeEdges[i]];
+			if (edge.yBottom <= y)
+				continue;
+			edge.q += edge.stepQ;
+			edge.r += edge.stepR;
+			if (edge.r >= edge.h) {
+				edge.r -= edge.h;
+				edge.q++;
 			}
+			edge.x = edge.xTop + edge.sign * edge.q;
+			activeEdges[active++] = activeEdges[i];
+		}
+		activeEdges.resize(active);
+
+		/* add the edges that start, possibly above the clip rectangle */
+		for(; next < polyEdges.size() && polyEdges[next].yTop <= y; ++next) {
+			PolyEdge &edge = polyEdges[next];
+			if (edge.yBottom <= y)
+				continue;
+			int64 num = (int64)(y - edge.yTop) * (edge.stepQ * edge.h + edge.stepR);
+			edge.q = num / edge.h;
+			edge.r = num % edge.h;
+			edge.x = edge.xTop + edge.sign * edge.q;
+			activeEdges.push_back(next);
+		}
 
-			if (y1 < y2) {
-				if ((y >= y1) && (y < y2)) {
-					crossing[ints++] = SMUL_DIV((y - y1), (x2 - x1), (y2 - y1)) + x1;
-				}
-			} else if (y1 > y2) {
-				if ((y >= y2) && (y < y1)) {
-					crossing[ints++] = SMUL_DIV((y - y2), (x1 - x2), (y1 - y2)) + x2;
-				}
-			}
-			if (!indices) {
-				x1 = x2;
-				y1 = y2;
-			}
+		if (activeEdges.empty()) {
+			if (next == polyEdges.size())
+				break;
+			/* skip to where the next edge starts */
+			y = polyEdges[next].yTop - 1;
+			continue;
 		}
 
-		for(int i = 0; i < ints - 1; ++i) {
-			for(int j = i + 1; j < ints; ++j) {
-				if (crossing[i] > crossing[j]) {
-					int16 tmp = crossing[i];
-					crossing[i] = crossing[j];
-					crossing[j] = tmp;
-				}
-			}
+		/* insertion sort, the order changes little from line to line */
+		for(size_t i = 1; i < activeEdges.size(); ++i) {
+			int e = activeEdges[i];
+			int x = polyEdges[e].x;
+			size_t j = i;
+			for(; j > 0 && polyEdges[activeEdges[j - 1]].x > x; --j)
+				activeEdges[j] = activeEdges[j - 1];
+			activeEdges[j] = e;
 		}
 
-		x1 = cliprect[0];
-		x2 = cliprect[2];
-		for(int i = 0; i < ints - 1; i += 2) {
-			y1 = crossing[i];       // Really x-values, but...
-			y2 = crossing[i + 1];
-			if (y1 < x1)
-				y1 = x1;
-			if (y2 > x2)
-				y2 = x2;
-			if (y1 <= y2) {
-				hsFillArea(y1, y, y2 - y1 + 1, 1, pattern,
-				                    fgColor, bgColor, logOp);
-				if (y1 < minx)
-					minx = y1;
-				if (y2 > maxx)
-					maxx = y2;
+		uint8 *line = (uint8 *)sdl_surf->pixels + y * sdl_surf->pitch;
+		uint16 linePattern = pattern[y & 0xf];
+		for(size_t i = 0; i + 1 < activeEdges.size(); i += 2) {
+			int x1 = std::max(polyEdges[activeEdges[i]].x, cliprect[0]);
+			int x2 = std::min(polyEdges[activeEdges[i + 1]].x, cliprect[2]);
+			if (x1 > x2)
+				continue;
+
+			int w = x2 - x1 + 1;
+			if (expandRow) {
+				int words = (w + 15) >> 4;
+				int shift = x1 & 0xf;
+				uint16 bits = (linePattern >> shift) | (linePattern << ((16 - shift) & 0xf));
+
+				if ((int)rowBits.size() < words)
+					rowBits.resize(words);
+				std::fill(rowBits.begin(), rowBits.begin() + words, bits);
+				expandRow(line + x1 * bpp, &rowBits[0], w, fgColor, eraseColor);
+			} else {
+				hsFillArea(x1, y, w, 1, pattern, fgColor, bgColor, logOp);
 			}
+			minx = std::min(minx, x1);
+			maxx = std::max(maxx, x2);
+			miny = std::min(miny, y);
+			maxy = y;
 		}
 	}
 
+	if (expandRow && minx <= maxx)
+		surface->setDirtyRect(minx, miny, maxx - minx + 1, maxy - miny + 1);
+
 	return 1;
 #endif
 }
 
+/**
+ * Draw a string of an 8 pixel wide font in one go.
+ *
+ * The font has 16 bytes per character, one per row, MSB first;
+ * text points to the character codes as words. The glyphs are
+ * expanded to the surface format once and then kept in glyphCache,
+ * so a string costs one copy per glyph row.
+ *
+ * A return of 0 makes fVDI fall back to drawing the string with
+ * expandArea().
+ **/
 int32 SoftVdiDriver::drawText(memptr vwk, memptr text, uint32 length,
 			      int32 dst_x, int32 dst_y, memptr font,
 			      uint32 w, uint32 h, uint32 fgColor, uint32 bgColor,
 			      uint32 logOp, memptr clip)
 {
 	DUNUSED(vwk);
-	DUNUSED(text);
-	DUNUSED(length);
-	DUNUSED(dst_x);
-	DUNUSED(dst_y);
-	DUNUSED(font);
-	DUNUSED(w);
-	DUNUSED(h);
-	DUNUSED(fgColor);
-	DUNUSED(bgColor);
-	DUNUSED(logOp);
-	DUNUSED(clip);
 
-	return 0;
+	if (w == 0 || w > 8 || h == 0 || h > 16 || logOp < MD_REPLACE || logOp > MD_ERASE)
+		return 0;
+
+	if (!surface) {
+		return 1;
+	}
+	SDL_Surface *sdl_surf = surface->getSdlSurface();
+	if (!sdl_surf) {
+		return 1;
+	}
+
+	if (surface->getBpp() == 8) {
+		fgColor &= 0xff;
+		bgColor &= 0xff;
+	}
+	if (glyphBpp != sdl_surf->format->BytesPerPixel) {
+		glyphCache.clear();
+		glyphBpp = sdl_surf->format->BytesPerPixel;
+	}
+
+	int cx1 = 0, cy1 = 0;
+	int cx2 = surface->getWidth() - 1, cy2 = surface->getHeight() - 1;
+	if (clip) {
+		cx1 = std::max(cx1, (int32)ReadInt32(clip));
+		cy1 = std::max(cy1, (int32)ReadInt32(clip + 4));
+		cx2 = std::min(cx2, (int32)ReadInt32(clip + 8));
+		cy2 = std::min(cy2, (int32)ReadInt32(clip + 12));
+	}
+
+	/* only the characters inside the clip rectangle */
+	int x = dst_x;
+	int first = 0, last = length;
+	if (x < cx1)
+		first = (cx1 - x) / (int)w;
+	if (x + (int)(length * w) - 1 > cx2)
+		last = (cx2 - x) / (int)w + 1;
+	if (x > cx2 || first >= last || dst_y + (int)h <= cy1 || dst_y > cy2)
+		return 1;
+
+	for(int i = first; i < last; i++) {
+		if (!ValidAtariAddr(font + ReadInt16(text + i * 2) * 16, false, h))
+			return 0;
+	}
+
+	for(int i = first; i < last; i++) {
+		Glyph *glyph = getGlyph(font, ReadInt16(text + i * 2), w, h, fgColor, bgColor, logOp);
+		drawGlyph(*glyph, x + i * w, dst_y, w, h, cx1, cx2, cy1, cy2, logOp);
+	}
+
+	int dx = std::max(x + first * (int)w, cx1);
+	int dy = std::max(dst_y, cy1);
+	int dw = std::min(x + last * (int)w - 1, cx2) - dx + 1;
+	int dh = std::min(dst_y + (int)h - 1, cy2) - dy + 1;
+	surface->setDirtyRect(dx,dy,dw,dh);
+	return 1;
 }
 
 void SoftVdiDriver::getHwColor(uint16 index, uint32 red, uint32 green,
@@ -1592,6 +2015,125 @@ void SoftVdiDriver::hsPutPixel( int x, int y, uint32 color )
 	} /* switch */
 }
 
+/**
+ * The glyph of character ch, expanded to the surface format.
+ * The font data is compared with what the glyph was made from,
+ * so a font replaced at the same address is picked up.
+ **/
+SoftVdiDriver::Glyph *SoftVdiDriver::getGlyph(memptr font, uint16 ch,
+	uint32 w, uint32 h, uint32 fgColor, uint32 bgColor, uint32 logOp)
+{
+	/* colours a mode doesn't use must not split the cache */
+	if (logOp == MD_TRANS || logOp == MD_XOR)
+		bgColor = 0;
+	if (logOp == MD_XOR || logOp == MD_ERASE)
+		fgColor = 0;
+
+	GlyphKey key(((uint64)font << 32) | ((uint64)ch << 16) | (logOp << 8) | ((w - 1) << 4) | (h - 1),
+	             ((uint64)fgColor << 32) | bgColor);
+	const uint8 *bits = Atari2HostAddr(font + ch * 16);
+
+	GlyphCache::iterator it = glyphCache.find(key);
+	if (it != glyphCache.end() && memcmp(it->second.bits, bits, h) == 0)
+		return &it->second;
+	if (it == glyphCache.end() && glyphCache.size() >= MAX_GLYPHS)
+		glyphCache.clear();
+
+	Glyph &glyph = glyphCache[key];
+	memcpy(glyph.bits, bits, h);
+	glyph.opaque = logOp == MD_REPLACE;
+
+	uint8 *mask = glyph.mask;
+	uint8 *p = glyph.pixels;
+	for(uint32 j = 0; j < h; j++) {
+		for(uint32 i = 0; i < w; i++) {
+			bool set = (bits[j] >> (7 - i)) & 1;
+			uint32 color = fgColor;
+			switch(logOp) {
+				case MD_REPLACE:
+					*mask++ = 1;
+					color = set ? fgColor : bgColor;
+					break;
+				case MD_TRANS:
+				case MD_XOR:
+					*mask++ = set;
+					break;
+				case MD_ERASE:
+					*mask++ = !set;
+					color = bgColor;
+					break;
+			}
+			switch(glyphBpp) {
+				case 1:
+					*p = color;
+					break;
+				case 2:
+					*(uint16 *)p = color;
+					break;
+				case 3:
+					putBpp24Pixel( p, color );
+					break;
+				case 4:
+					*(uint32 *)p = color;
+					break;
+			}
+			p += glyphBpp;
+		}
+	}
+
+	return &glyph;
+}
+
+/**
+ * Copy the part of a glyph at x,y that is inside the clip rectangle.
+ **/
+void SoftVdiDriver::drawGlyph(const Glyph &glyph, int x, int y, int w, int h,
+	int clipX1, int clipX2, int clipY1, int clipY2, uint32 logOp)
+{
+	int i0 = std::max(0, clipX1 - x);
+	int i1 = std::min(w, clipX2 - x + 1);
+	int j0 = std::max(0, clipY1 - y);
+	int j1 = std::min(h, clipY2 - y + 1);
+	if (i0 >= i1 || j0 >= j1)
+		return;
+
+	SDL_Surface *sdl_surf = surface->getSdlSurface();
+	int bpp = glyphBpp;
+	for(int j = j0; j < j1; j++) {
+		uint8 *dst = (uint8 *)sdl_surf->pixels + (y + j) * sdl_surf->pitch + (x + i0) * bpp;
+		const uint8 *src = glyph.pixels + (j * w + i0) * bpp;
+		const uint8 *mask = glyph.mask + j * w;
+
+		if (glyph.opaque) {
+			memcpy(dst, src, (i1 - i0) * bpp);
+			continue;
+		}
+		for(int i = i0; i < i1; i++, dst += bpp, src += bpp) {
+			if (!mask[i])
+				continue;
+			if (logOp == MD_XOR) {
+				for(int b = 0; b < bpp; b++)
+					dst[b] = ~dst[b];
+			} else {
+				switch(bpp) {
+					case 1:
+						*dst = *src;
+						break;
+					case 2:
+						*(uint16 *)dst = *(const uint16 *)src;
+						break;
+					case 4:
+						*(uint32 *)dst = *(const uint32 *)src;
+						break;
+					default:
+						memcpy(dst, src, bpp);
+						break;
+				}
+			}
+		}
+	}
+}
+
 void SoftVdiDriver::hsFillArea( int x, int y, int w, int h,
 	uint16 *pattern, uint32 fgColor, uint32 bgColor, uint16 logOp )
 {
@@ -1629,6 +2171,26 @@ void SoftVdiDriver::hsGfxBoxColorPattern( int x, int y, int w, int h,
 	pixel = ((uint8*)sdl_surf->pixels) + pixx * (int32)x + pixy * (int32)y;
 	pixellast = pixel + pixy*dy;
 
+	ExpandRowFunc expandRow = getExpandRow(pixx, logOp);
+	if (expandRow && w > 0) {
+		uint32 eraseColor = patternBgColor(logOp, fgColor, bgColor);
+		int words = (w + 15) >> 4;
+		int shift = x & 0xf;
+
+		if ((int)rowBits.size() < words)
+			rowBits.resize(words);
+		for (; pixel<pixellast; pixel += pixy) {
+			uint16 pattern = areaPattern ? areaPattern[ y++ & 0xf ] : 0xffff;
+
+			/* rotate so that bit 0 is the pattern bit of column x */
+			pattern = (pattern >> shift) | (pattern << ((16 - shift) & 0xf));
+			std::fill(rowBits.begin(), rowBits.begin() + words, pattern);
+			expandRow(pixel, &rowBits[0], w, fgColor, eraseColor);
+		}
+		surface->setDirtyRect(x,y0,w,h);
+		return;
+	}
+
 	// STanda // FIXME here the pattern should be checked out of the loops for performance
 			  // but for now it is good enough (if there is no pattern -> another switch?)
 
@@ -1834,6 +2396,104 @@ void SoftVdiDriver::hsGfxBoxColorPattern( int x, int y, int w, int h,
 	surface->setDirtyRect(x,y0,w,h);
 }
 
+/**
+ * An off-screen surface of at least w x h pixels in the given format,
+ * taken from the pool or made, to be returned with putScratchSurface().
+ * Sizes are rounded up, so that moving windows or growing text hit
+ * a surface already there.
+ **/
+SDL_Surface *SoftVdiDriver::getScratchSurface(int w, int h,
+	SDL_PixelFormat *format, uint32 Amask)
+{
+	ScratchSurface *best = NULL;
+
+	if (w <= 0 || h <= 0)
+		return NULL;
+
+	for(std::vector<ScratchSurface>::iterator it = scratchSurfaces.begin(); it != scratchSurfaces.end(); ++it) {
+		SDL_Surface *surf = it->surf;
+		if (it->busy || surf->w < w || surf->h < h)
+			continue;
+		if (surf->format->BitsPerPixel != format->BitsPerPixel
+		 || surf->format->Rmask != format->Rmask || surf->format->Gmask != format->Gmask
+		 || surf->format->Bmask != format->Bmask || surf->format->Amask != Amask)
+			continue;
+		if (best == NULL || surf->w * surf->h < best->surf->w * best->surf->h)
+			best = &*it;
+	}
+	if (best) {
+		best->busy = true;
+		return best->surf;
+	}
+
+	/* 64 pixel steps */
+	int bw = (w + 63) & ~63;
+	int bh = (h + 63) & ~63;
+	SDL_Surface *surf = SDL_CreateRGBSurface(SDL_SWSURFACE, bw, bh,
+		format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, Amask);
+	if (surf == NULL) {
+		/* maybe just short of memory */
+		trimScratchSurfaces(0);
+		surf = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h,
+			format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, Amask);
+		if (surf == NULL)
+			return NULL;
+	}
+	D(bug("fVDI: new %dx%dx%d scratch surface", surf->w, surf->h, format->BitsPerPixel));
+
+	ScratchSurface scratch;
+	scratch.surf = surf;
+	scratch.lastUse = SDL_GetTicks();
+	scratch.busy = true;
+	scratchSurfaces.push_back(scratch);
+	return surf;
+}
+
+void SoftVdiDriver::putScratchSurface(SDL_Surface *surf)
+{
+	for(std::vector<ScratchSurface>::iterator it = scratchSurfaces.begin(); it != scratchSurfaces.end(); ++it) {
+		if (it->surf == surf) {
+			it->busy = false;
+			it->lastUse = SDL_GetTicks();
+			break;
+		}
+	}
+	trimScratchSurfaces(SCRATCH_MAX_BYTES);
+}
+
+/**
+ * Free idle surfaces that have not been used for a while, then
+ * the least recently used ones until at most maxBytes are kept.
+ **/
+void SoftVdiDriver::trimScratchSurfaces(uint32 maxBytes)
+{
+	uint32 now = SDL_GetTicks();
+	uint32 bytes = 0;
+
+	for(std::vector<ScratchSurface>::iterator it = scratchSurfaces.begin(); it != scratchSurfaces.end(); ) {
+		if (!it->busy && (maxBytes == 0 || now - it->lastUse > SCRATCH_MAX_IDLE)) {
+			SDL_FreeSurface(it->surf);
+			it = scratchSurfaces.erase(it);
+		} else {
+			bytes += it->surf->pitch * it->surf->h;
+			++it;
+		}
+	}
+
+	while (bytes > maxBytes) {
+		std::vector<ScratchSurface>::iterator oldest = scratchSurfaces.end();
+		for(std::vector<ScratchSurface>::iterator it = scratchSurfaces.begin(); it != scratchSurfaces.end(); ++it) {
+			if (!it->busy && (oldest == scratchSurfaces.end() || (int32)(it->lastUse - oldest->lastUse) < 0))
+				oldest = it;
+		}
+		if (oldest == scratchSurfaces.end())
+			break;
+		bytes -= oldest->surf->pitch * oldest->surf->h;
+		SDL_FreeSurface(oldest->surf);
+		scratchSurfaces.erase(oldest);
+	}
+}
+
 void SoftVdiDriver::hsBlitArea( int sx, int sy, int dx, int dy, int w, int h )
 {
 	SDL_Rect srcrect;
@@ -1843,11 +2503,8 @@ void SoftVdiDriver::hsBlitArea( int sx, int sy, int dx, int dy, int w, int h )
 	if (sdl_buggy_blitsurface) {
 		SDL_Surface *a_surf;
 		
-		a_surf = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h,
-			sdl_surf->format->BitsPerPixel, sdl_surf->format->Rmask,
-			sdl_surf->format->Gmask, sdl_surf->format->Bmask,
-			sdl_surf->format->Amask);
-   
+		a_surf = getScratchSurface(w, h, sdl_surf->format, sdl_surf->format->Amask);
+
 		if (a_surf) {
 			if (sdl_surf->format->BitsPerPixel<=8) {
 #if SDL_VERSION_ATLEAST(2, 0, 0)
@@ -1871,7 +2528,7 @@ void SoftVdiDriver::hsBlitArea( int sx, int sy, int dx, int dy, int w, int h )
 			dstrect.y = dy;
 			SDL_BlitSurface(a_surf, &srcrect, sdl_surf, &dstrect);
 
-			SDL_FreeSurface(a_surf);
+			putScratchSurface(a_surf);
 		}
 	} else {
 		srcrect.x = sx;
@@ -2302,6 +2959,18 @@ void SoftVdiDriver::gfxHLineColor ( int16 x1, int16 x2, int16 y, uint16 pattern,
 
 	D2(bug("HLn %3d,%3d,%3d", x1, x2, y));
 
+	ExpandRowFunc expandRow = getExpandRow(pixx, logOp);
+	if (expandRow) {
+		int words = (w + 15) >> 4;
+
+		if ((int)rowBits.size() < words)
+			rowBits.resize(words);
+		std::fill(rowBits.begin(), rowBits.begin() + words, pattern);
+		expandRow(pixel, &rowBits[0], w, fgColor, patternBgColor(logOp, fgColor, bgColor));
+		surface->setDirtyLine(x1, y, x2, y);
+		return;
+	}
+
 	/* Draw */
 	switch(surface->getBpp()) {
 		case 8:
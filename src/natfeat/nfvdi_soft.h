@@ -25,6 +25,9 @@
 
 #include "parameters.h"
 
+#include <map>
+#include <vector>
+
 /*--- Defines ---*/
 
 /*--- Types ---*/
@@ -82,6 +85,98 @@ class SoftVdiDriver : public VdiDriver
 			memptr dest, int32 dx, int32 dy, int32 w, int32 h, uint32 logOp);
 
 	private:
+		/* An edge of the polygon fillPoly() fills, top to bottom */
+		struct PolyEdge {
+			int yTop, yBottom;	/* it crosses scanlines yTop to yBottom - 1 */
+			int x;			/* where it crosses the current one */
+			int xTop, sign;
+			int q, r;		/* |x - xTop| is q + r / h */
+			int stepQ, stepR, h;	/* |dx| / h per scanline */
+
+			bool operator<(const PolyEdge &other) const { return yTop < other.yTop; }
+		};
+
+		/* A glyph of an 8 pixel wide font, expanded for the surface */
+		struct Glyph {
+			uint8 bits[16];		/* the font data it was expanded from */
+			uint8 mask[16 * 8];	/* nonzero where the glyph sets the pixel */
+			uint8 pixels[16 * 8 * 4];
+			bool opaque;		/* mask is all set */
+		};
+		/* (font, char, logOp, size), (fgColor, bgColor) */
+		typedef std::pair<uint64, uint64> GlyphKey;
+		typedef std::map<GlyphKey, Glyph> GlyphCache;
+
+		static const unsigned int MAX_GLYPHS = 2048;
+
+		GlyphCache glyphCache;
+		int glyphBpp;
+
+		Glyph *getGlyph(memptr font, uint16 ch, uint32 w, uint32 h,
+			uint32 fgColor, uint32 bgColor, uint32 logOp);
+		void drawGlyph(const Glyph &glyph, int x, int y, int w, int h,
+			int clipX1, int clipX2, int clipY1, int clipY2, uint32 logOp);
+
+		/* An off-screen surface kept for reuse by getScratchSurface() */
+		struct ScratchSurface {
+			SDL_Surface *surf;
+			uint32 lastUse;		/* SDL_GetTicks() of its last release */
+			bool busy;
+		};
+
+		/* the pixel data the pool may keep while no surface is in use */
+		static const uint32 SCRATCH_MAX_BYTES = 16 * 1024 * 1024;
+		/* idle surfaces are freed after this many ms */
+		static const uint32 SCRATCH_MAX_IDLE = 10000;
+
+		std::vector<ScratchSurface> scratchSurfaces;
+
+		SDL_Surface *getScratchSurface(int w, int h, SDL_PixelFormat *format,
+			uint32 Amask);
+		void putScratchSurface(SDL_Surface *surf);
+		void trimScratchSurfaces(uint32 maxBytes);
+
+		/*
+		 * A guest bitmap converted to the surface format by
+		 * blitArea_M2S(), keyed by (address, width, height, planes
+		 * and format flags). Each row is checked against a hash of
+		 * its data when it gets drawn.
+		 */
+		typedef std::pair<memptr, uint64> BlitCacheKey;
+		struct BlitCacheEntry {
+			std::vector<uint64> rowHash;
+			SDL_Surface *surf;
+			uint32 lastUse;
+		};
+		typedef std::map<BlitCacheKey, BlitCacheEntry> BlitCache;
+
+		/* larger bitmaps are not cached */
+		static const uint32 BLIT_CACHE_MAX_BITMAP = 256 * 1024;
+
+		BlitCache blitCache;
+		uint64 blitCacheBytes;
+		uint32 blitCacheClock;
+
+		bool blitCachedArea(memptr src, int32 sx, int32 sy, int32 dx, int32 dy,
+			int32 w, int32 h, uint32 logOp);
+		SDL_Surface *convertBitmap(const uint8 *data, uint32 pitch, uint32 width,
+			uint32 height, uint32 planes, bool chunky);
+		static void convertBitmapRow(const uint8 *s, uint8 *d, uint32 width,
+			uint32 planes, bool chunky);
+		void flushBlitCache(void);
+
+		/* the edge table and the active edges of fillPoly() */
+		std::vector<PolyEdge> polyEdges;
+		std::vector<int> activeEdges;
+
+		/* scratch rows of the monochrome expansion */
+		std::vector<uint16> rowBits;
+		std::vector<uint16> rowWords;
+
+		bool expandRows(memptr data, uint16 pitch, int32 sx, int32 dx,
+			int32 dy, int32 w, int32 h, uint32 fgColor, uint32 bgColor,
+			uint32 logOp);
+
 		bool clipLine(int x1, int y1, int x2, int y2, int cliprect[]);
 		int drawSingleLine(int x1, int y1, int x2, int y2, uint16 pattern,
 			uint32 fgColor, uint32 bgColor, int logOp, 
@@ -32,6 +32,7 @@
 #include "nfosmesa.h"
 #include "../../atari/nfosmesa/nfosmesa_nfapi.h"
 #include "osmesa_context.h"
+#include "osmesa_convert.h"
 #if SDL_VERSION_ATLEAST(2, 0, 0)
 #include "host.h"
 #endif
@@ -152,6 +153,16 @@ OffscreenContext::OffscreenContext(void *glhandle) :
 	conversion(false),
 	swapcomponents(false),
 	error_check_enabled(GL_FALSE),
+	damage_x0(0),
+	damage_y0(0),
+	damage_x1(0),
+	damage_y1(0),
+	damage_margin(1),
+	damage_all(true),
+	damage_always(false),
+	converted_buffer(0),
+	converted_width(0),
+	converted_height(0),
 	type(GL_NONE),
 	width(0),
 	height(0)
@@ -178,9 +189,11 @@ void OffscreenContext::PixelStore(GLint pname, GLint value)
 	case OSMESA_ROW_LENGTH:
 		if (value >= 0)
 			setUserRowLength(value);
+		DamageAll();
 		break;
 	case OSMESA_Y_UP:
 		setYup(value ? GL_TRUE : GL_FALSE);
+		DamageAll();
 		break;
 	}
 }
@@ -245,618 +258,252 @@ void OffscreenContext::ResizeBuffer(GLsizei newBpp)
 
 /*-----------------------------------------------------------------------*/
 
-void OffscreenContext::ConvertContext()
+void OffscreenContext::FreeBuffer(void)
 {
-	if (!conversion)
-		return;
-
-	switch (bx_options.osmesa.channel_size)
+	if (host_buffer)
 	{
-	case 16:
-		ConvertContext16();
-		break;
-	case 32:
-		ConvertContext32();
-		break;
-	case 8:
-	default:
-		ConvertContext8();
-		break;
+		free(host_buffer);
+		host_buffer = NULL;
+		buffer_width = buffer_height = buffer_bpp = 0;
 	}
 }
 
 /*-----------------------------------------------------------------------*/
 
-void OffscreenContext::ConvertContext8()
+/*
+ * Whether the pixels can be stored straight into the atari buffer,
+ * in dstformat and with the row length asked for: all of the buffer
+ * has to be plain memory with the byte order of the guest.
+ */
+bool OffscreenContext::CanRenderDirect(void)
 {
-	int x, y, srcpitch, dstpitch;
-
-	switch (dstformat)
-	{
-	case OSMESA_RGB_565:
-		/*
-		 * assumes srcformat also == OSMESA_RGB_565
-		 */
-		if (host_buffer)
-		{
-			Uint16 *srcline, *srccol, color;
-			memptr dstline, dstcol;
-			
-			srcline = (Uint16 *)host_buffer;
-			srcpitch = width;
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 1;
-			if (UpsideDown())
-			{
-				dstline += (height - 1) * dstpitch;
-				dstpitch = -dstpitch;
-			}
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					color = *srccol++;
-					WriteInt16(dstcol, color);
-					dstcol += 2;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		} else
-		{
-			/*
-			 * without host_buffer; colorbuffer was already written to atari memory
-			 */
-			Uint16 *srcline, *srccol, color;
-
-			srcline = (Uint16 *)Atari2HostAddr(dst_buffer);
-			srcpitch = getUserRowLength();
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				for (x = 0; x < width; x++)
-				{
-					color = SDL_SwapBE16(*srccol);
-					*srccol++ = color;
-				}
-				srcline += srcpitch;
-			}
-		}
-		break;
-	
-	/*
-	 * all others are byte formats, and we are only here
-	 * because we can't do glReadPixels() directly to atari memory
-	 * assumes srcformat == OSMESA_ARGB
-	 */
-	case OSMESA_RGB:
-	case VDI_RGB:
-	/* case GL_RGB: */
-		{
-			memptr dstline, dstcol;
-			Uint8 *srcline, *srccol;
-			
-			srcline = (Uint8 *)host_buffer;
-			srcpitch = width * 4;
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 3;
-			if (UpsideDown())
-			{
-				dstline += (height - 1) * dstpitch;
-				dstpitch = -dstpitch;
-			}
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					WriteInt8(dstcol++, srccol[1]);
-					WriteInt8(dstcol++, srccol[2]);
-					WriteInt8(dstcol++, srccol[3]);
-					srccol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-
-	case OSMESA_BGR:
-	case GL_BGR:
-		{
-			memptr dstline, dstcol;
-			Uint8 *srcline, *srccol;
-
-			srcline = (Uint8 *)host_buffer;
-			srcpitch = width * 4;
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 3;
-			if (UpsideDown())
-			{
-				dstline += (height - 1) * dstpitch;
-				dstpitch = -dstpitch;
-			}
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					WriteInt8(dstcol++, srccol[3]);
-					WriteInt8(dstcol++, srccol[2]);
-					WriteInt8(dstcol++, srccol[1]);
-					srccol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_BGRA:
-	case GL_BGRA_EXT:
-		{
-			memptr dstline, dstcol;
-			Uint8 *srcline, *srccol;
-
-			srcline = (Uint8 *)host_buffer;
-			srcpitch = width * 4;
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 4;
-			if (UpsideDown())
-			{
-				dstline += (height - 1) * dstpitch;
-				dstpitch = -dstpitch;
-			}
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					WriteInt8(dstcol++, srccol[3]);
-					WriteInt8(dstcol++, srccol[2]);
-					WriteInt8(dstcol++, srccol[1]);
-					WriteInt8(dstcol++, srccol[0]);
-					srccol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_ARGB:
-	case VDI_ARGB:
-	case DIRECT_VDI_ARGB:
+	if (destination_bpp == 0)
+		return true;
 #if NFOSMESA_NEED_BYTE_CONV
-		{
-			memptr dstline, dstcol;
-			Uint8 *srcline, *srccol;
-
-			srcline = (Uint8 *)host_buffer;
-			srcpitch = width * 4;
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 4;
-			if (UpsideDown())
-			{
-				dstline += (height - 1) * dstpitch;
-				dstpitch = -dstpitch;
-			}
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					WriteInt8(dstcol++, srccol[0]);
-					WriteInt8(dstcol++, srccol[1]);
-					WriteInt8(dstcol++, srccol[2]);
-					WriteInt8(dstcol++, srccol[3]);
-					srccol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+	return false;
 #else
-		{
-			Uint32 *dstline, *dstcol;
-			Uint32 *srcline, *srccol;
-
-			srcline = (Uint32 *)host_buffer;
-			srcpitch = width;
-			dstline = (Uint32 *) Atari2HostAddr(dst_buffer);
-			dstpitch = getUserRowLength();
-			if (UpsideDown())
-			{
-				dstline += (height - 1) * dstpitch;
-				dstpitch = -dstpitch;
-			}
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					*dstcol++ = *srccol++;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+	if (!bx_options.osmesa.direct_render || width <= 0 || height <= 0)
+		return false;
+	/* the row length comes from the guest, it must not wrap the size */
+	GLint rowLength = getUserRowLength();
+	if (rowLength < width)
+		return false;
+	uint64 size = ((uint64)(height - 1) * rowLength + width) * destination_bpp;
+	if (size > 0xffffffffULL)
+		return false;
+	return Atari2HostBlock(dst_buffer, (uint32)size, true) != NULL;
 #endif
-		break;
-	}
+}
+
+/*-----------------------------------------------------------------------*/
+
+void OffscreenContext::ConvertContext()
+{
+	GLint x, y;
+	GLsizei w, h;
+
+	if (!conversion)
+		return;
+	if (TakeDamage(x, y, w, h))
+		ConvertRegion(x, y, w, h);
 }
 
 /*-----------------------------------------------------------------------*/
 
 /*
- * assumes srcformat == OSMESA_ARGB
+ * Everything drawn is clipped to the viewport, but for wide points and
+ * lines, and for the calls that OSMesaDriver reports with DamageAll().
  */
-void OffscreenContext::ConvertContext16()
+void OffscreenContext::Damage(GLint x, GLint y, GLsizei w, GLsizei h)
 {
-	int x,y, r,g,b,a, srcpitch, dstpitch, color;
-	Uint16 *srcline, *srccol;
+	if (w <= 0 || h <= 0)
+		return;
+	if (w > 0x10000)
+		w = 0x10000;
+	if (h > 0x10000)
+		h = 0x10000;
+	if (x < damage_x0)
+		damage_x0 = x;
+	if (y < damage_y0)
+		damage_y0 = y;
+	if (x + w > damage_x1)
+		damage_x1 = x + w;
+	if (y + h > damage_y1)
+		damage_y1 = y + h;
+}
 
-	srcline = (Uint16 *) host_buffer;
-	srcpitch = width * 4;
+/*-----------------------------------------------------------------------*/
 
-	switch(dstformat)
-	{
-	case OSMESA_RGB_565:
-		{
-			memptr dstline, dstcol;
+void OffscreenContext::DamageWidth(GLfloat size)
+{
+	if (!(size > 0.0f))
+		return;
+	if (size > 0x10000)
+		size = 0x10000;
+	GLint margin = (GLint)ceil(size / 2) + 1;
+	if (margin > damage_margin)
+		damage_margin = margin;
+}
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 1;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					srccol++; /* Skip alpha */
-					r = ((*srccol++)>>11) & 31;
-					g = ((*srccol++)>>10) & 63;
-					b = ((*srccol++)>>11) & 31;
-
-					color = (r<<11)|(g<<5)|b;
-					WriteInt16(dstcol, color);
-					dstcol += 2;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_RGB:
-	case VDI_RGB:
-	/* case GL_RGB: */
-		{
-			memptr dstline, dstcol;
+/*-----------------------------------------------------------------------*/
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 3;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					srccol++; /* Skip alpha */
-					r = ((*srccol++)>>8) & 255;
-					g = ((*srccol++)>>8) & 255;
-					b = ((*srccol++)>>8) & 255;
-
-					WriteInt8(dstcol++, r);
-					WriteInt8(dstcol++, g);
-					WriteInt8(dstcol++, b);
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_BGR:
-	case GL_BGR:
-		{
-			memptr dstline, dstcol;
+/*
+ * The current viewport and widths, which may have come from anywhere,
+ * e.g. glPopAttrib()
+ */
+void OffscreenContext::DamageState(void)
+{
+	GLint viewport[4];
+	GLfloat size;
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 3;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					srccol++; /* Skip alpha */
-					r = ((*srccol++)>>8) & 255;
-					g = ((*srccol++)>>8) & 255;
-					b = ((*srccol++)>>8) & 255;
-
-					WriteInt8(dstcol++, b);
-					WriteInt8(dstcol++, g);
-					WriteInt8(dstcol++, r);
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_BGRA:
-	case GL_BGRA_EXT:
-		{
-			memptr dstline, dstcol;
+	OSMesaDriver::fn.glGetIntegerv(GL_VIEWPORT, viewport);
+	Damage(viewport[0], viewport[1], viewport[2], viewport[3]);
+	OSMesaDriver::fn.glGetFloatv(GL_POINT_SIZE, &size);
+	DamageWidth(size);
+	OSMesaDriver::fn.glGetFloatv(GL_LINE_WIDTH, &size);
+	DamageWidth(size);
+}
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 2;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width;x ++)
-				{
-					a = ((*srccol++)>>8) & 255;
-					r = ((*srccol++)>>8) & 255;
-					g = ((*srccol++)>>8) & 255;
-					b = ((*srccol++)>>8) & 255;
-
-					color = (b<<24)|(g<<16)|(r<<8)|a;
-					WriteInt32(dstcol, color);
-					dstcol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_ARGB:
-	case VDI_ARGB:
-	case DIRECT_VDI_ARGB:
-		{
-			memptr dstline, dstcol;
+/*-----------------------------------------------------------------------*/
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 2;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					a = ((*srccol++)>>8) & 255;
-					r = ((*srccol++)>>8) & 255;
-					g = ((*srccol++)>>8) & 255;
-					b = ((*srccol++)>>8) & 255;
-
-					color = (a<<24)|(r<<16)|(g<<8)|b;
-					WriteInt32(dstcol, color);
-					dstcol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
-	case OSMESA_RGBA:
-	/* case GL_RGBA: */
-		{
-			memptr dstline, dstcol;
+/*
+ * Get the region to convert, in window coordinates,
+ * and start over with what the current state may draw to.
+ * Returns false if nothing has to be converted.
+ */
+bool OffscreenContext::TakeDamage(GLint &x, GLint &y, GLsizei &w, GLsizei &h)
+{
+	GLint x0 = 0, y0 = 0, x1 = width, y1 = height;
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 2;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					a = ((*srccol++)>>8) & 255;
-					r = ((*srccol++)>>8) & 255;
-					g = ((*srccol++)>>8) & 255;
-					b = ((*srccol++)>>8) & 255;
-
-					color = (r<<24)|(g<<16)|(b<<8)|a;
-					WriteInt32(dstcol, color);
-					dstcol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
-		break;
+	if (dst_buffer != converted_buffer || width != converted_width || height != converted_height)
+		damage_all = true;
+	if (!damage_all)
+	{
+		x0 = MAX(x0, damage_x0 - damage_margin);
+		y0 = MAX(y0, damage_y0 - damage_margin);
+		x1 = MIN(x1, damage_x1 + damage_margin);
+		y1 = MIN(y1, damage_y1 + damage_margin);
 	}
+	converted_buffer = dst_buffer;
+	converted_width = width;
+	converted_height = height;
+
+	damage_all = damage_always;
+	damage_x0 = damage_y0 = 0x10000;
+	damage_x1 = damage_y1 = -0x10000;
+	damage_margin = 1;
+	DamageState();
+
+	if (x0 >= x1 || y0 >= y1)
+		return false;
+	x = x0;
+	y = y0;
+	w = x1 - x0;
+	h = y1 - y0;
+	return true;
 }
 
 /*-----------------------------------------------------------------------*/
 
 /*
- * assumes srcformat == OSMESA_ARGB
+ * Convert a region of host_buffer, which has the OSMESA_ARGB layout with
+ * the configured channel size, or the dstformat one if SourceIsDestination(),
+ * to dstformat in atari memory. Without host_buffer, only 565 pixels can be
+ * swapped in place.
  */
-void OffscreenContext::ConvertContext32()
+void OffscreenContext::ConvertRegion(GLint x, GLint y, GLsizei w, GLsizei h)
 {
-#define FLOAT_TO_INT(source, value, maximum) \
-	{ \
-		value = (int) (source * maximum ## .0); \
-		if (value>maximum) value=maximum; \
-		if (value<0) value=0; \
-	}
-
-	int x,y, r,g,b,a, srcpitch, dstpitch, color;
-	float *srcline, *srccol;
+	int channel_size, format, srcbpp, dstbpp;
+	GLint srcpitch, dstpitch;
+	bool copy;
 
-	srcline = (float *) host_buffer;
-	srcpitch = width * 4;
+	channel_size = bx_options.osmesa.channel_size;
+	if (channel_size != 16 && channel_size != 32)
+		channel_size = 8;
 
-	switch(dstformat)
+	switch (dstformat)
 	{
 	case OSMESA_RGB_565:
-		{
-			memptr dstline, dstcol;
-
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 1;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					srccol++; /* Skip alpha */
-					FLOAT_TO_INT(*srccol++, r, 31);
-					FLOAT_TO_INT(*srccol++, g, 63);
-					FLOAT_TO_INT(*srccol++, b, 31);
-
-					color = (r<<11)|(g<<5)|b;
-					WriteInt16(dstcol, color);
-					dstcol += 2;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+		format = CONVERT_RGB565;
+		dstbpp = 2;
 		break;
 	case OSMESA_RGB:
 	case VDI_RGB:
-	/* case GL_RGB: */
-		{
-			memptr dstline, dstcol;
-
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 3;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					srccol++; /* Skip alpha */
-					FLOAT_TO_INT(*srccol++, r, 255);
-					FLOAT_TO_INT(*srccol++, g, 255);
-					FLOAT_TO_INT(*srccol++, b, 255);
-
-					WriteInt8(dstcol++, r);
-					WriteInt8(dstcol++, g);
-					WriteInt8(dstcol++, b);
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+		format = CONVERT_RGB;
+		dstbpp = 3;
 		break;
 	case OSMESA_BGR:
 	case GL_BGR:
-		{
-			memptr dstline, dstcol;
-
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() * 3;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					srccol++; /* Skip alpha */
-					FLOAT_TO_INT(*srccol++, r, 255);
-					FLOAT_TO_INT(*srccol++, g, 255);
-					FLOAT_TO_INT(*srccol++, b, 255);
-
-					WriteInt8(dstcol++, b);
-					WriteInt8(dstcol++, g);
-					WriteInt8(dstcol++, r);
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+		format = CONVERT_BGR;
+		dstbpp = 3;
 		break;
 	case OSMESA_BGRA:
 	case GL_BGRA_EXT:
-		{
-			memptr dstline, dstcol;
-
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 2;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					FLOAT_TO_INT(*srccol++, a, 255);
-					FLOAT_TO_INT(*srccol++, r, 255);
-					FLOAT_TO_INT(*srccol++, g, 255);
-					FLOAT_TO_INT(*srccol++, b, 255);
-
-					color = (b<<24)|(g<<16)|(r<<8)|a;
-					WriteInt32(dstcol, color);
-					dstcol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+		format = CONVERT_BGRA;
+		dstbpp = 4;
 		break;
 	case OSMESA_ARGB:
 	case VDI_ARGB:
 	case DIRECT_VDI_ARGB:
-		{
-			memptr dstline, dstcol;
-
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 2;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width; x++)
-				{
-					FLOAT_TO_INT(*srccol++, a, 255);
-					FLOAT_TO_INT(*srccol++, r, 255);
-					FLOAT_TO_INT(*srccol++, g, 255);
-					FLOAT_TO_INT(*srccol++, b, 255);
-
-					color = (a<<24)|(r<<16)|(g<<8)|b;
-					WriteInt32(dstcol, color);
-					dstcol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
-		}
+		format = CONVERT_ARGB;
+		dstbpp = 4;
 		break;
 	case OSMESA_RGBA:
-	/* case GL_RGBA: */
-		{
-			memptr dstline, dstcol;
+		format = CONVERT_RGBA;
+		dstbpp = 4;
+		break;
+	default:
+		return;
+	}
+	ConvertRowFunc convertRow = getConvertRow(channel_size, format);
 
-			dstline = dst_buffer;
-			dstpitch = getUserRowLength() << 2;
-			for (y = 0; y < height; y++)
-			{
-				srccol = srcline;
-				dstcol = dstline;
-				for (x = 0; x < width;x++)
-				{
-					FLOAT_TO_INT(*srccol++, a, 255);
-					FLOAT_TO_INT(*srccol++, r, 255);
-					FLOAT_TO_INT(*srccol++, g, 255);
-					FLOAT_TO_INT(*srccol++, b, 255);
-
-					color = (r<<24)|(g<<16)|(g<<8)|a;
-					WriteInt32(dstcol, color);
-					dstcol += 4;
-				}
-				srcline += srcpitch;
-				dstline += dstpitch;
-			}
+	/* 565 pixels are rendered in host byte order always */
+	copy = channel_size == 8 && format != CONVERT_RGB565 && SourceIsDestination();
+	if (channel_size == 8 && format == CONVERT_RGB565)
+		srcbpp = 2;
+	else if (copy)
+		srcbpp = dstbpp;
+	else
+		srcbpp = 4 * (channel_size >> 3);
+	if (host_buffer == NULL && (copy || srcbpp != 2))
+		return;
+	srcpitch = width * srcbpp;
+	dstpitch = getUserRowLength() * dstbpp;
+	if (convert_row.size() < (size_t)(w * dstbpp))
+		convert_row.resize(w * dstbpp);
+
+	for (GLint row = y; row < y + h; row++)
+	{
+		GLint srcrow = SourceTopDown() ? height - 1 - row : row;
+		GLint dstrow = UpsideDown() ? height - 1 - srcrow : srcrow;
+		memptr dst = dst_buffer + dstrow * dstpitch + x * dstbpp;
+		Uint8 *hostdst = Atari2HostBlock(dst, w * dstbpp, true);
+		const Uint8 *src;
+
+		if (host_buffer)
+		{
+			src = (const Uint8 *)host_buffer + srcrow * srcpitch + x * srcbpp;
+		} else
+		{
+			/* colorbuffer was already written to atari memory */
+			if (hostdst == NULL)
+				continue;
+			src = hostdst;
+		}
+		if (copy)
+		{
+			if (hostdst)
+				memcpy(hostdst, src, w * dstbpp);
+			else
+				Host2Atari_memcpy(dst, src, w * dstbpp);
+		} else if (hostdst)
+		{
+			convertRow(hostdst, src, w);
+		} else
+		{
+			convertRow(&convert_row[0], src, w);
+			Host2Atari_memcpy(dst, &convert_row[0], w * dstbpp);
 		}
-		break;
 	}
 }
 
@@ -984,6 +631,15 @@ bool MesaContext::TestContext()
 	const GLubyte *extensions = OSMesaDriver::fn.glGetString(GL_EXTENSIONS);
 	OffscreenContext::has_MESA_pack_invert = gl_HasExtension("GL_MESA_pack_invert", extensions);
 
+	/*
+	 * Gallium OSMesa uses llvmpipe when it was built with it, unless
+	 * GALLIUM_DRIVER says otherwise; it rasterizes on all host cores,
+	 * which is what the rendering threads are meant to keep busy
+	 */
+	const GLubyte *renderer = OSMesaDriver::fn.glGetString(GL_RENDERER);
+	if (bx_options.osmesa.threaded && renderer != NULL && strstr((const char *)renderer, "llvmpipe") == NULL)
+		infoprint("nfosmesa: renderer '%s' is not llvmpipe, rasterizing on one core", renderer);
+
 #if DEBUG
 	{
 		const GLubyte *str;
@@ -1032,30 +688,35 @@ GLboolean MesaContext::MakeCurrent(memptr _buffer, GLenum _type, GLsizei _width,
 		}
 	} else
 	{
-		if (dstformat == OSMESA_RGB_565)
-		{
-			type = GL_UNSIGNED_SHORT_5_6_5;
-#if NFOSMESA_NEED_BYTE_CONV || NFOSMESA_NEED_INT_CONV
-			conversion = true;
-#endif
-			if (conversion)
-				ResizeBuffer(2);
-		} else
-		{
-			type = GL_UNSIGNED_BYTE;
-#if NFOSMESA_NEED_BYTE_CONV
-			if (dstformat != GL_NONE)
-				conversion = true;
-#endif
-			if (conversion)
-				ResizeBuffer(4);
-		}
+		type = dstformat == OSMESA_RGB_565 ? GL_UNSIGNED_SHORT_5_6_5 : GL_UNSIGNED_BYTE;
+		conversion = !RenderDirect();
+		if (conversion)
+			ResizeBuffer(destination_bpp);
+		else
+			FreeBuffer();
+		D(bug("nfosmesa: rendering %s", conversion ? "to host buffer" : "directly"));
 	}
 	return MakeCurrent();
 }
 
 /*-----------------------------------------------------------------------*/
 
+/*
+ * With 8 bit channels, Mesa renders in the format that was asked for,
+ * so it can draw to atari memory itself, with the row length of the
+ * application; but 565 pixels are always in host byte order.
+ */
+bool MesaContext::RenderDirect(void)
+{
+#if NFOSMESA_NEED_INT_CONV
+	if (dstformat == OSMESA_RGB_565)
+		return false;
+#endif
+	return CanRenderDirect();
+}
+
+/*-----------------------------------------------------------------------*/
+
 GLboolean MesaContext::MakeCurrent()
 {
 	void *draw_buffer;
@@ -1063,7 +724,12 @@ GLboolean MesaContext::MakeCurrent()
 	draw_buffer = Atari2HostAddr(dst_buffer);
 	if (host_buffer)
 		draw_buffer = host_buffer;
-	return OSMesaDriver::fn.OSMesaMakeCurrent(ctx, draw_buffer, type, width, height);
+	if (!OSMesaDriver::fn.OSMesaMakeCurrent(ctx, draw_buffer, type, width, height))
+		return GL_FALSE;
+	/* host_buffer is never wider than the image */
+	if (GL_ISAVAILABLE(OSMesaPixelStore))
+		OSMesaDriver::fn.OSMesaPixelStore(OSMESA_ROW_LENGTH, host_buffer ? 0 : userRowLength);
+	return GL_TRUE;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -1097,6 +763,14 @@ bool MesaContext::GetIntegerv(GLint pname, GLint *value)
 void MesaContext::PixelStore(GLint pname, GLint value)
 {
 	OffscreenContext::PixelStore(pname, value);
+	if (pname == OSMESA_ROW_LENGTH && bx_options.osmesa.channel_size <= 8 && dst_buffer != 0)
+	{
+		/* the longer rows may not be plain memory anymore, or now are */
+		MakeCurrent(dst_buffer, type, width, height);
+		return;
+	}
+	if (pname == OSMESA_ROW_LENGTH && host_buffer)
+		value = 0;
 	if (GL_ISAVAILABLE(OSMesaPixelStore))
 		OSMesaDriver::fn.OSMesaPixelStore(pname, value);
 }
@@ -1269,18 +943,11 @@ bool OpenglContext::CreateContext(GLenum format, GLint _depthBits, GLint _stenci
 		destination_bpp = 3;
 		break;
 	case OSMESA_RGB_565:
+		/* read with GL_PACK_SWAP_BYTES on little endian hosts */
 		destination_bpp = 2;
-#if NFOSMESA_NEED_INT_CONV
-		/* TODO; without FULLMMU, we might get away with just setting GL_PACK_SWAP_BYTES */
-		conversion = true;
-#endif
 		break;
 	}
 
-#if NFOSMESA_NEED_BYTE_CONV
-	conversion = true;
-#endif
-	
 	/*
 	 * the FBO can't be created until we know the dimensions,
 	 * which we receive through OSMesaMakeCurrent()
@@ -1294,21 +961,36 @@ bool OpenglContext::CreateContext(GLenum format, GLint _depthBits, GLint _stenci
 void OpenglContext::setYup(GLboolean enable)
 {
 	OffscreenContext::setYup(enable);
-	/*
-	 * glReadPixels() always returns pixel data upside down,
-	 * and doing glReadPixels() a single row at a time to correct that
-	 * is much slower than doing a single read into a temporary buffer
-	 * and doing the conversion ourselves
-	 */
-	if (!enable && !OffscreenContext::has_MESA_pack_invert)
-	{
-		conversion = true;
-	}
 	createBuffers();
 }
 
 /*-----------------------------------------------------------------------*/
 
+void OpenglContext::setUserRowLength(GLint length)
+{
+	OffscreenContext::setUserRowLength(length);
+	/* the longer rows may not be plain memory anymore, or now are */
+	createBuffers();
+}
+
+/*-----------------------------------------------------------------------*/
+
+/*
+ * glReadPixels() stores all formats straight into atari memory, with
+ * the row length of the application.
+ * But it always returns pixel data upside down, and doing glReadPixels()
+ * a single row at a time to correct that is much slower than doing a
+ * single read into a temporary buffer and doing the conversion ourselves
+ */
+bool OpenglContext::RenderDirect(void)
+{
+	if (!getYup() && !OffscreenContext::has_MESA_pack_invert)
+		return false;
+	return CanRenderDirect();
+}
+
+/*-----------------------------------------------------------------------*/
+
 GLboolean OpenglContext::createBuffers()
 {
 	GLenum status;
@@ -1538,6 +1220,7 @@ GLboolean OpenglContext::createBuffers()
 			return GL_FALSE;
 	}
 		
+	conversion = !RenderDirect();
 	if (conversion)
 	{
 		if (swapcomponents && dstformat == GL_BGRA_EXT)
@@ -1549,7 +1232,17 @@ GLboolean OpenglContext::createBuffers()
 			swapcomponents = false;
 		}
 		ResizeBuffer(4);
+	} else
+	{
+		if (dstformat == OSMESA_ARGB)
+		{
+			/* GL has no GL_ARGB format */
+			dstformat = GL_BGRA_EXT;
+			swapcomponents = true;
+		}
+		FreeBuffer();
 	}
+	D(bug("nfosmesa: reading %s", conversion ? "to host buffer" : "directly"));
 
 	return GL_TRUE;
 }
@@ -1653,87 +1346,65 @@ void OpenglContext::ConvertContext()
 	
 	if (host_buffer)
 	{
-		if (dstformat == OSMESA_RGB_565)
-		{
-			/* the conversion routines want OSMESA_RGB565 */
-			GLenum dsttype = GL_UNSIGNED_SHORT_5_6_5;
-			OSMesaDriver::fn.glReadPixels(0, 0, width, height, GL_RGB, dsttype, host_buffer);
-		} else
-		{
-			GLenum dsttype = SDL_BYTEORDER == SDL_LIL_ENDIAN ? GL_UNSIGNED_INT_8_8_8_8 : GL_UNSIGNED_INT_8_8_8_8_REV;
-			/* the conversion routines want GL_ARGB */
-			OSMesaDriver::fn.glReadPixels(0, 0, width, height, GL_BGRA_EXT, dsttype, host_buffer);
-		}
-		D(OSMesaDriver::PrintErrors("glReadPixels"));
-		OffscreenContext::ConvertContext();
-	} else
-	{
-		OSMesaDriver::fn.glPixelStorei(GL_PACK_ROW_LENGTH, getUserRowLength());
-		D(OSMesaDriver::PrintErrors("glPixelStorei(GL_PACK_ROW_LENGTH)"));
-		if (swapcomponents)
+		GLint x, y;
+		GLsizei w, h;
+
+		if (conversion && TakeDamage(x, y, w, h))
 		{
-			GLenum dsttype = SDL_BYTEORDER == SDL_LIL_ENDIAN ? GL_UNSIGNED_INT_8_8_8_8 : GL_UNSIGNED_INT_8_8_8_8_REV;
-			if (getYup())
+			/* read just the region, to where it is in host_buffer */
+			OSMesaDriver::fn.glPixelStorei(GL_PACK_ROW_LENGTH, width);
+			OSMesaDriver::fn.glPixelStorei(GL_PACK_SKIP_PIXELS, x);
+			OSMesaDriver::fn.glPixelStorei(GL_PACK_SKIP_ROWS, y);
+			if (dstformat == OSMESA_RGB_565)
 			{
-				OSMesaDriver::fn.glReadPixels(0, 0, width, height, dstformat, dsttype, Atari2HostAddr(dst_buffer));
-			} else if (OffscreenContext::has_MESA_pack_invert)
-			{
-				OSMesaDriver::fn.glPixelStorei(GL_PACK_INVERT_MESA, GL_TRUE);
-				OSMesaDriver::fn.glReadPixels(0, 0, width, height, dstformat, dsttype, Atari2HostAddr(dst_buffer));
+				/* the conversion routines want OSMESA_RGB565 */
+				GLenum dsttype = GL_UNSIGNED_SHORT_5_6_5;
+				OSMesaDriver::fn.glPixelStorei(GL_PACK_ALIGNMENT, 2);
+				OSMesaDriver::fn.glReadPixels(x, y, w, h, GL_RGB, dsttype, host_buffer);
 			} else
 			{
-				/* just in case; we should not be here */
-				char *ptr = (char *)Atari2HostAddr(dst_buffer);
-				GLint pitch = getUserRowLength() * destination_bpp;
-				for (GLsizei y = height; --y >= 0; )
-				{
-					OSMesaDriver::fn.glReadPixels(0, y, width, 1, dstformat, dsttype, ptr);
-					ptr += pitch;
-				}
+				GLenum dsttype = SDL_BYTEORDER == SDL_LIL_ENDIAN ? GL_UNSIGNED_INT_8_8_8_8 : GL_UNSIGNED_INT_8_8_8_8_REV;
+				/* the conversion routines want GL_ARGB */
+				OSMesaDriver::fn.glReadPixels(x, y, w, h, GL_BGRA_EXT, dsttype, host_buffer);
 			}
-		} else if (dstformat == OSMESA_RGB_565)
+			D(OSMesaDriver::PrintErrors("glReadPixels"));
+			ConvertRegion(x, y, w, h);
+		}
+	} else
+	{
+		GLint x, y;
+		GLsizei w, h;
+
+		if (TakeDamage(x, y, w, h))
 		{
-			GLenum dsttype = SDL_BYTEORDER == SDL_LIL_ENDIAN ? GL_UNSIGNED_SHORT_5_6_5 : GL_UNSIGNED_SHORT_5_6_5_REV;
-			if (getYup())
+			/* store just the region, to where it is in atari memory */
+			GLenum readformat = dstformat;
+			GLenum readtype = type;
+			GLint pitch = getUserRowLength() * destination_bpp;
+			GLint dstrow = y;
+
+			if (swapcomponents)
 			{
-				OSMesaDriver::fn.glReadPixels(0, 0, width, height, GL_RGB, dsttype, Atari2HostAddr(dst_buffer));
-			} else if (OffscreenContext::has_MESA_pack_invert)
+				readtype = SDL_BYTEORDER == SDL_LIL_ENDIAN ? GL_UNSIGNED_INT_8_8_8_8 : GL_UNSIGNED_INT_8_8_8_8_REV;
+			} else if (dstformat == OSMESA_RGB_565)
 			{
-				OSMesaDriver::fn.glPixelStorei(GL_PACK_INVERT_MESA, GL_TRUE);
-				OSMesaDriver::fn.glReadPixels(0, 0, width, height, GL_RGB, dsttype, Atari2HostAddr(dst_buffer));
-			} else
-			{
-				/* just in case; we should not be here */
-				char *ptr = (char *)Atari2HostAddr(dst_buffer);
-				GLint pitch = getUserRowLength() * destination_bpp;
-				for (GLsizei y = height; --y >= 0; )
-				{
-					OSMesaDriver::fn.glReadPixels(0, y, width, 1, GL_RGB, dsttype, ptr);
-					ptr += pitch;
-				}
+				readformat = GL_RGB;
+				readtype = GL_UNSIGNED_SHORT_5_6_5;
+				if (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+					OSMesaDriver::fn.glPixelStorei(GL_PACK_SWAP_BYTES, GL_TRUE);
 			}
-		} else
-		{
-			if (getYup())
-			{
-				OSMesaDriver::fn.glReadPixels(0, 0, width, height, dstformat, type, Atari2HostAddr(dst_buffer));
-			} else if (OffscreenContext::has_MESA_pack_invert)
+			if (!getYup())
 			{
+				/* RenderDirect() made sure we have it */
 				OSMesaDriver::fn.glPixelStorei(GL_PACK_INVERT_MESA, GL_TRUE);
-				OSMesaDriver::fn.glReadPixels(0, 0, width, height, dstformat, type, Atari2HostAddr(dst_buffer));
-			} else
-			{
-				/* just in case; we should not be here */
-				char *ptr = (char *)Atari2HostAddr(dst_buffer);
-				GLint pitch = getUserRowLength() * destination_bpp;
-				for (GLsizei y = height; --y >= 0; )
-				{
-					OSMesaDriver::fn.glReadPixels(0, y, width, 1, dstformat, type, ptr);
-					ptr += pitch;
-				}
+				dstrow = height - y - h;
 			}
+			OSMesaDriver::fn.glPixelStorei(GL_PACK_ROW_LENGTH, getUserRowLength());
+			OSMesaDriver::fn.glPixelStorei(GL_PACK_ALIGNMENT, 1);
+			D(OSMesaDriver::PrintErrors("glPixelStorei"));
+			OSMesaDriver::fn.glReadPixels(x, y, w, h, readformat, readtype, Atari2HostAddr(dst_buffer + dstrow * pitch + x * destination_bpp));
+			D(OSMesaDriver::PrintErrors("glReadPixels"));
 		}
-		D(OSMesaDriver::PrintErrors("glReadPixels"));
 	}
 	if (texEnabled)
 		OSMesaDriver::fn.glEnable(texTarget);
@@ -21,6 +21,8 @@
 #ifndef NFOSMESA_CONTEXT_H
 #define NFOSMESA_CONTEXT_H
 
+#include <vector>
+
 #if defined(__MACOSX__)
 #include <CoreFoundation/CoreFoundation.h>
 #endif
@@ -53,8 +55,9 @@ protected:
 
 	/* 
 	 * Host buffer, if channel reduction needed (deprecated)
-	 * or when we cannot pass the atari address directly
-	 * (e.g. when using FULLMMU, or glReadPixels() in opposite Y-order)
+	 * or when we cannot render to the atari buffer directly
+	 * (e.g. when using FULLMMU, when it is not plain memory,
+	 * or glReadPixels() in opposite Y-order); NULL otherwise
 	 */
 	void *host_buffer;
 	GLsizei buffer_width, buffer_height, buffer_bpp;
@@ -87,20 +90,38 @@ protected:
 
 	GLboolean error_check_enabled;
 	
-	void ConvertContext8();			/* 8 bits per channel */
-	void ConvertContext16(void);	/* 16 bits per channel */
-	void ConvertContext32(void);	/* 32 bits per channel */
+	/*
+	 * bounds of what may have been drawn since the last conversion,
+	 * in window coordinates, widened by damage_margin for wide points
+	 * and lines; damage_all if unknown, damage_always if never known
+	 */
+	GLint damage_x0, damage_y0, damage_x1, damage_y1;
+	GLint damage_margin;
+	bool damage_all;
+	bool damage_always;
+
+	/* what the last conversion was done to */
+	memptr converted_buffer;
+	GLsizei converted_width, converted_height;
+
+	/* a row, when the atari buffer is not plain memory */
+	std::vector<Uint8> convert_row;
+
+	bool TakeDamage(GLint &x, GLint &y, GLsizei &w, GLsizei &h);
+	void ConvertRegion(GLint x, GLint y, GLsizei w, GLsizei h);
 	void ResizeBuffer(GLsizei newBpp);
+	void FreeBuffer(void);
+	bool CanRenderDirect(void);
 	
 	GLboolean getYup() { return yup; }
 	GLint getUserRowLength() { return userRowLength ? userRowLength : width; }
 	virtual void setYup(GLboolean enable) { yup = enable; }
 	virtual bool UpsideDown(void) { return false; }
-	virtual void setUserRowLength(GLint length) {
-		userRowLength = length;
-		if (userRowLength != 0 && userRowLength != width)
-			conversion = true;
-	}
+	/* true if the first row of host_buffer is the top one */
+	virtual bool SourceTopDown(void) { return false; }
+	/* true if host_buffer has the dstformat layout instead of OSMESA_ARGB */
+	virtual bool SourceIsDestination(void) { return false; }
+	virtual void setUserRowLength(GLint length) { userRowLength = length; }
 	
 	static bool FormatHasAlpha(GLenum format);
 
@@ -125,6 +146,12 @@ public:
 	virtual void GetColorBuffer(GLint *width, GLint *height, GLint *format, memptr *buffer);
 	virtual void GetDepthBuffer(GLint *width, GLint *height, GLint *bytesPerValue, memptr *buffer);
 
+	void Damage(GLint x, GLint y, GLsizei w, GLsizei h);
+	void DamageWidth(GLfloat size);
+	void DamageState(void);
+	void DamageAll(void) { damage_all = true; }
+	void DamageAlways(void) { damage_always = damage_all = true; }
+
 	virtual bool IsOpengl(void) = 0;
 };
 
@@ -133,6 +160,9 @@ public:
 class MesaContext : public OffscreenContext {
 protected:
 	OSMesaContext ctx;
+	virtual bool SourceTopDown(void) { return !getYup(); }
+	virtual bool SourceIsDestination(void) { return bx_options.osmesa.channel_size <= 8; }
+	bool RenderDirect(void);
 public:
 	MesaContext(void *glhandle);
 	virtual ~MesaContext();
@@ -176,7 +206,9 @@ protected:
 	GLboolean MakeBufferCurrent(bool create_buffer);
 	GLboolean ClearCurrent();
 	virtual void setYup(GLboolean enable);
+	virtual void setUserRowLength(GLint length);
 	virtual bool UpsideDown(void) { return !getYup(); }
+	bool RenderDirect(void);
 	GLboolean createBuffers();
 public:
 	OpenglContext(void *glhandle);
@@ -0,0 +1,548 @@
+/*
+ * osmesa_convert.cpp - pixel conversion kernels of NFOSMesa
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "osmesa_convert.h"
+
+#include <cstring>
+
+/*
+ * The byte shuffles need pshufb, so the x86 kernels start at SSSE3;
+ * they are compiled with the target attribute and used if the CPU has it.
+ */
+#if (defined(X86_ASSEMBLY) || defined(X86_64_ASSEMBLY)) && defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+# include <immintrin.h>
+# define USE_SSSE3_CONVERT 1
+# define USE_AVX2_CONVERT 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define USE_NEON_CONVERT 1
+#endif
+
+/*--- Scalar ---*/
+
+/* like the FLOAT_TO_INT() the conversion always used */
+static inline int floatToInt(float source, int maximum)
+{
+	int value = (int) (source * (double) maximum);
+	if (value > maximum)
+		value = maximum;
+	if (value < 0)
+		value = 0;
+	return value;
+}
+
+template <int chan>
+static inline void loadPixel(const void *src, int i, int &a, int &r, int &g, int &b);
+
+template <>
+inline void loadPixel<8>(const void *src, int i, int &a, int &r, int &g, int &b)
+{
+	const uint8 *s = (const uint8 *)src + i * 4;
+	a = s[0];
+	r = s[1];
+	g = s[2];
+	b = s[3];
+}
+
+template <>
+inline void loadPixel<16>(const void *src, int i, int &a, int &r, int &g, int &b)
+{
+	const uint16 *s = (const uint16 *)src + i * 4;
+	a = s[0] >> 8;
+	r = s[1] >> 8;
+	g = s[2] >> 8;
+	b = s[3] >> 8;
+}
+
+template <>
+inline void loadPixel<32>(const void *src, int i, int &a, int &r, int &g, int &b)
+{
+	const float *s = (const float *)src + i * 4;
+	a = floatToInt(s[0], 255);
+	r = floatToInt(s[1], 255);
+	g = floatToInt(s[2], 255);
+	b = floatToInt(s[3], 255);
+}
+
+template <int fmt>
+static inline void storePixel(uint8 *dst, int i, int a, int r, int g, int b)
+{
+	uint8 *d;
+
+	switch(fmt) {
+		case CONVERT_ARGB:
+			d = dst + i * 4;
+			d[0] = a; d[1] = r; d[2] = g; d[3] = b;
+			break;
+		case CONVERT_BGRA:
+			d = dst + i * 4;
+			d[0] = b; d[1] = g; d[2] = r; d[3] = a;
+			break;
+		case CONVERT_RGBA:
+			d = dst + i * 4;
+			d[0] = r; d[1] = g; d[2] = b; d[3] = a;
+			break;
+		case CONVERT_RGB:
+			d = dst + i * 3;
+			d[0] = r; d[1] = g; d[2] = b;
+			break;
+		case CONVERT_BGR:
+			d = dst + i * 3;
+			d[0] = b; d[1] = g; d[2] = r;
+			break;
+		case CONVERT_RGB565:
+			d = dst + i * 2;
+			d[0] = (r & 0xf8) | (g >> 5);
+			d[1] = ((g << 3) & 0xe0) | (b >> 3);
+			break;
+	}
+}
+
+template <int chan, int fmt>
+static inline void convertPixels(uint8 *dst, const void *src, int from, int to)
+{
+	int a, r, g, b;
+
+	if (chan == 8 && fmt == CONVERT_RGB565) {
+		/* the source is 565 already, maybe dst itself */
+		const uint16 *s = (const uint16 *)src;
+		for(int i = from; i < to; i++) {
+			uint16 color = s[i];
+			dst[i * 2] = color >> 8;
+			dst[i * 2 + 1] = color;
+		}
+	} else if (chan == 32 && fmt == CONVERT_RGB565) {
+		/* scaled to 5 and 6 bits directly, not from 8 bits */
+		const float *s = (const float *)src;
+		for(int i = from; i < to; i++) {
+			uint16 color = (floatToInt(s[i * 4 + 1], 31) << 11) |
+				(floatToInt(s[i * 4 + 2], 63) << 5) |
+				floatToInt(s[i * 4 + 3], 31);
+			dst[i * 2] = color >> 8;
+			dst[i * 2 + 1] = color;
+		}
+	} else {
+		for(int i = from; i < to; i++) {
+			loadPixel<chan>(src, i, a, r, g, b);
+			storePixel<fmt>(dst, i, a, r, g, b);
+		}
+	}
+}
+
+template <int chan, int fmt>
+static void convertRowScalar(uint8 *dst, const void *src, int n)
+{
+	if (chan == 8 && fmt == CONVERT_ARGB)
+		memcpy(dst, src, n * 4);
+	else
+		convertPixels<chan, fmt>(dst, src, 0, n);
+}
+
+/*--- SSSE3 ---*/
+
+#ifdef USE_SSSE3_CONVERT
+
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+
+/* 16 pixels from pixel i on, as 4 vectors of A R G B bytes */
+template <int chan>
+static inline TARGET_SSSE3 void load16(__m128i v[4], const void *src, int i);
+
+template <>
+inline TARGET_SSSE3 void load16<8>(__m128i v[4], const void *src, int i)
+{
+	const __m128i *s = (const __m128i *)((const uint8 *)src + i * 4);
+	for(int k = 0; k < 4; k++)
+		v[k] = _mm_loadu_si128(s + k);
+}
+
+template <>
+inline TARGET_SSSE3 void load16<16>(__m128i v[4], const void *src, int i)
+{
+	const __m128i *s = (const __m128i *)((const uint16 *)src + i * 4);
+	for(int k = 0; k < 4; k++)
+		v[k] = _mm_packus_epi16(_mm_srli_epi16(_mm_loadu_si128(s + 2 * k), 8),
+			_mm_srli_epi16(_mm_loadu_si128(s + 2 * k + 1), 8));
+}
+
+/*
+ * Scaled in double precision and truncated like floatToInt();
+ * the saturating packs do the clamping.
+ */
+static inline TARGET_SSSE3 __m128i floatPixel128(const float *s)
+{
+	const __m128d scale = _mm_set1_pd(255.0);
+	__m128 f = _mm_loadu_ps(s);
+	__m128i lo = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(f), scale));
+	__m128i hi = _mm_cvttpd_epi32(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(f, f)), scale));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+template <>
+inline TARGET_SSSE3 void load16<32>(__m128i v[4], const void *src, int i)
+{
+	const float *s = (const float *)src + i * 4;
+	for(int k = 0; k < 4; k++, s += 16)
+		v[k] = _mm_packus_epi16(
+			_mm_packs_epi32(floatPixel128(s), floatPixel128(s + 4)),
+			_mm_packs_epi32(floatPixel128(s + 8), floatPixel128(s + 12)));
+}
+
+/* 16 pixels to pixel i on */
+template <int fmt>
+static inline TARGET_SSSE3 void store16(uint8 *dst, int i, const __m128i v[4])
+{
+	__m128i *d, mask, t[4];
+
+	switch(fmt) {
+		case CONVERT_ARGB:
+			d = (__m128i *)(dst + i * 4);
+			for(int k = 0; k < 4; k++)
+				_mm_storeu_si128(d + k, v[k]);
+			break;
+		case CONVERT_BGRA:
+		case CONVERT_RGBA:
+			mask = fmt == CONVERT_BGRA ?
+				_mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+				_mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+			d = (__m128i *)(dst + i * 4);
+			for(int k = 0; k < 4; k++)
+				_mm_storeu_si128(d + k, _mm_shuffle_epi8(v[k], mask));
+			break;
+		case CONVERT_RGB:
+		case CONVERT_BGR:
+			/* 12 bytes of each vector, joined to 3 vectors */
+			mask = fmt == CONVERT_RGB ?
+				_mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1) :
+				_mm_setr_epi8(3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, -1, -1, -1, -1);
+			for(int k = 0; k < 4; k++)
+				t[k] = _mm_shuffle_epi8(v[k], mask);
+			d = (__m128i *)(dst + i * 3);
+			_mm_storeu_si128(d, _mm_or_si128(t[0], _mm_slli_si128(t[1], 12)));
+			_mm_storeu_si128(d + 1, _mm_or_si128(_mm_srli_si128(t[1], 4), _mm_slli_si128(t[2], 8)));
+			_mm_storeu_si128(d + 2, _mm_or_si128(_mm_srli_si128(t[2], 8), _mm_slli_si128(t[3], 4)));
+			break;
+		case CONVERT_RGB565:
+			{
+				uint8 argb[64];
+				for(int k = 0; k < 4; k++)
+					_mm_storeu_si128((__m128i *)argb + k, v[k]);
+				for(int j = 0; j < 16; j++)
+					storePixel<fmt>(dst, i + j, argb[j * 4], argb[j * 4 + 1], argb[j * 4 + 2], argb[j * 4 + 3]);
+			}
+			break;
+	}
+}
+
+/* byte swap of 565 pixels */
+static inline TARGET_SSSE3 int swap16SSSE3(uint8 *dst, const void *src, int n)
+{
+	int i;
+	for(i = 0; i + 8 <= n; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *)((const uint16 *)src + i));
+		_mm_storeu_si128((__m128i *)(dst + i * 2), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+	}
+	return i;
+}
+
+template <int chan, int fmt>
+static TARGET_SSSE3 void convertRowSSSE3(uint8 *dst, const void *src, int n)
+{
+	int i = 0;
+
+	if (chan == 8 && fmt == CONVERT_ARGB) {
+		memcpy(dst, src, n * 4);
+		return;
+	}
+	if (chan == 8 && fmt == CONVERT_RGB565) {
+		i = swap16SSSE3(dst, src, n);
+	} else if (chan != 32 || fmt != CONVERT_RGB565) {
+		for(; i + 16 <= n; i += 16) {
+			__m128i v[4];
+			load16<chan>(v, src, i);
+			store16<fmt>(dst, i, v);
+		}
+	}
+	convertPixels<chan, fmt>(dst, src, i, n);
+}
+
+#endif /* USE_SSSE3_CONVERT */
+
+/*--- AVX2 ---*/
+
+#ifdef USE_AVX2_CONVERT
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+/*
+ * Only the wide channels are narrowed with 256 bit vectors;
+ * the stores, and the 8 bit kernels, are those of SSSE3.
+ */
+template <int chan>
+static inline TARGET_AVX2 void load16AVX2(__m128i v[4], const void *src, int i);
+
+template <>
+inline TARGET_AVX2 void load16AVX2<16>(__m128i v[4], const void *src, int i)
+{
+	const __m256i *s = (const __m256i *)((const uint16 *)src + i * 4);
+	for(int k = 0; k < 2; k++) {
+		__m256i p = _mm256_packus_epi16(_mm256_srli_epi16(_mm256_loadu_si256(s + 2 * k), 8),
+			_mm256_srli_epi16(_mm256_loadu_si256(s + 2 * k + 1), 8));
+		/* packus works within the 128 bit lanes */
+		p = _mm256_permute4x64_epi64(p, 0xd8);
+		v[2 * k] = _mm256_castsi256_si128(p);
+		v[2 * k + 1] = _mm256_extracti128_si256(p, 1);
+	}
+}
+
+static inline TARGET_AVX2 __m128i floatPixel256(const float *s)
+{
+	return _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(s)), _mm256_set1_pd(255.0)));
+}
+
+template <>
+inline TARGET_AVX2 void load16AVX2<32>(__m128i v[4], const void *src, int i)
+{
+	const float *s = (const float *)src + i * 4;
+	for(int k = 0; k < 4; k++, s += 16)
+		v[k] = _mm_packus_epi16(
+			_mm_packs_epi32(floatPixel256(s), floatPixel256(s + 4)),
+			_mm_packs_epi32(floatPixel256(s + 8), floatPixel256(s + 12)));
+}
+
+template <int chan, int fmt>
+static TARGET_AVX2 void convertRowAVX2(uint8 *dst, const void *src, int n)
+{
+	int i = 0;
+
+	if (fmt != CONVERT_RGB565 || chan == 16) {
+		for(; i + 16 <= n; i += 16) {
+			__m128i v[4];
+			load16AVX2<chan>(v, src, i);
+			store16<fmt>(dst, i, v);
+		}
+	}
+	convertPixels<chan, fmt>(dst, src, i, n);
+}
+
+#endif /* USE_AVX2_CONVERT */
+
+/*--- NEON ---*/
+
+#ifdef USE_NEON_CONVERT
+
+/* 16 pixels from pixel i on, split to A, R, G and B planes */
+template <int chan>
+static inline uint8x16x4_t loadNEON(const void *src, int i);
+
+template <>
+inline uint8x16x4_t loadNEON<8>(const void *src, int i)
+{
+	return vld4q_u8((const uint8 *)src + i * 4);
+}
+
+template <>
+inline uint8x16x4_t loadNEON<16>(const void *src, int i)
+{
+	const uint16 *s = (const uint16 *)src + i * 4;
+	uint16x8x4_t lo = vld4q_u16(s);
+	uint16x8x4_t hi = vld4q_u16(s + 32);
+	uint8x16x4_t p;
+	for(int c = 0; c < 4; c++)
+		p.val[c] = vcombine_u8(vshrn_n_u16(lo.val[c], 8), vshrn_n_u16(hi.val[c], 8));
+	return p;
+}
+
+template <int fmt>
+static inline void storeNEON(uint8 *dst, int i, uint8x16x4_t p)
+{
+	uint8x16x4_t q4;
+	uint8x16x3_t q3;
+	uint8x16x2_t q2;
+
+	switch(fmt) {
+		case CONVERT_ARGB:
+			vst4q_u8(dst + i * 4, p);
+			break;
+		case CONVERT_BGRA:
+			q4.val[0] = p.val[3]; q4.val[1] = p.val[2]; q4.val[2] = p.val[1]; q4.val[3] = p.val[0];
+			vst4q_u8(dst + i * 4, q4);
+			break;
+		case CONVERT_RGBA:
+			q4.val[0] = p.val[1]; q4.val[1] = p.val[2]; q4.val[2] = p.val[3]; q4.val[3] = p.val[0];
+			vst4q_u8(dst + i * 4, q4);
+			break;
+		case CONVERT_RGB:
+			q3.val[0] = p.val[1]; q3.val[1] = p.val[2]; q3.val[2] = p.val[3];
+			vst3q_u8(dst + i * 3, q3);
+			break;
+		case CONVERT_BGR:
+			q3.val[0] = p.val[3]; q3.val[1] = p.val[2]; q3.val[2] = p.val[1];
+			vst3q_u8(dst + i * 3, q3);
+			break;
+		case CONVERT_RGB565:
+			q2.val[0] = vorrq_u8(vandq_u8(p.val[1], vdupq_n_u8(0xf8)), vshrq_n_u8(p.val[2], 5));
+			q2.val[1] = vorrq_u8(vandq_u8(vshlq_n_u8(p.val[2], 3), vdupq_n_u8(0xe0)), vshrq_n_u8(p.val[3], 3));
+			vst2q_u8(dst + i * 2, q2);
+			break;
+	}
+}
+
+/* floats are left to the scalar code, for want of double vectors on 32 bit ARM */
+template <int chan, int fmt>
+static void convertRowNEON(uint8 *dst, const void *src, int n)
+{
+	int i = 0;
+
+	if (chan == 8 && fmt == CONVERT_ARGB) {
+		memcpy(dst, src, n * 4);
+		return;
+	}
+	if (chan == 8 && fmt == CONVERT_RGB565) {
+		for(; i + 8 <= n; i += 8)
+			vst1q_u8(dst + i * 2, vrev16q_u8(vld1q_u8((const uint8 *)src + i * 2)));
+	} else {
+		for(; i + 16 <= n; i += 16)
+			storeNEON<fmt>(dst, i, loadNEON<chan>(src, i));
+	}
+	convertPixels<chan, fmt>(dst, src, i, n);
+}
+
+#endif /* USE_NEON_CONVERT */
+
+/*--- Dispatch ---*/
+
+#define KERNELS(variant, chan) \
+	{ variant<chan, CONVERT_ARGB>, variant<chan, CONVERT_BGRA>, variant<chan, CONVERT_RGBA>, \
+	  variant<chan, CONVERT_RGB>, variant<chan, CONVERT_BGR>, variant<chan, CONVERT_RGB565> }
+
+/* [channel size 8, 16, 32][format] */
+typedef ConvertRowFunc KernelTable[3][CONVERT_FORMATS];
+
+static const KernelTable scalarKernels = {
+	KERNELS(convertRowScalar, 8),
+	KERNELS(convertRowScalar, 16),
+	KERNELS(convertRowScalar, 32)
+};
+
+#ifdef USE_SSSE3_CONVERT
+static const KernelTable ssse3Kernels = {
+	KERNELS(convertRowSSSE3, 8),
+	KERNELS(convertRowSSSE3, 16),
+	KERNELS(convertRowSSSE3, 32)
+};
+#endif
+
+#ifdef USE_AVX2_CONVERT
+static const KernelTable avx2Kernels = {
+	/* 16 8 bit pixels fill an SSE vector already */
+	KERNELS(convertRowSSSE3, 8),
+	KERNELS(convertRowAVX2, 16),
+	KERNELS(convertRowAVX2, 32)
+};
+#endif
+
+#ifdef USE_NEON_CONVERT
+static const KernelTable neonKernels = {
+	KERNELS(convertRowNEON, 8),
+	KERNELS(convertRowNEON, 16),
+	KERNELS(convertRowScalar, 32)
+};
+#endif
+
+static const KernelTable *kernels;
+static const char *variant;
+
+bool setConvertRowVariant(const char *name)
+{
+#ifdef USE_AVX2_CONVERT
+	if (strcmp(name, "avx2") == 0) {
+		__builtin_cpu_init();
+		if (!__builtin_cpu_supports("avx2"))
+			return false;
+		kernels = &avx2Kernels;
+		variant = "avx2";
+		return true;
+	}
+#endif
+#ifdef USE_SSSE3_CONVERT
+	if (strcmp(name, "ssse3") == 0) {
+		__builtin_cpu_init();
+		if (!__builtin_cpu_supports("ssse3"))
+			return false;
+		kernels = &ssse3Kernels;
+		variant = "ssse3";
+		return true;
+	}
+#endif
+#ifdef USE_NEON_CONVERT
+	if (strcmp(name, "neon") == 0) {
+		kernels = &neonKernels;
+		variant = "neon";
+		return true;
+	}
+#endif
+	if (strcmp(name, "scalar") == 0) {
+		kernels = &scalarKernels;
+		variant = "scalar";
+		return true;
+	}
+	return false;
+}
+
+static void selectKernels(void)
+{
+	if (!setConvertRowVariant("avx2") && !setConvertRowVariant("ssse3") && !setConvertRowVariant("neon"))
+		setConvertRowVariant("scalar");
+}
+
+const char *getConvertRowVariant(void)
+{
+	if (kernels == NULL)
+		selectKernels();
+	return variant;
+}
+
+ConvertRowFunc getConvertRow(int channelSize, int format)
+{
+	if (kernels == NULL)
+		selectKernels();
+	if (format < 0 || format >= CONVERT_FORMATS)
+		return NULL;
+
+	switch(channelSize) {
+		case 8:
+			return (*kernels)[0][format];
+		case 16:
+			return (*kernels)[1][format];
+		case 32:
+			return (*kernels)[2][format];
+	}
+	return NULL;
+}
+
+/*
+vim:ts=4:sw=4:
+*/
@@ -0,0 +1,57 @@
+/*
+ * osmesa_convert.h - pixel conversion kernels of NFOSMesa
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OSMESA_CONVERT_H
+#define OSMESA_CONVERT_H
+
+#include "sysdeps.h"
+
+/*
+ * Convert n pixels of a row of the host render buffer to the
+ * big endian layout the guest asked for.
+ *
+ * The source has A, R, G, B channels in this order, each one an 8 bit,
+ * a host endian 16 bit or a float value (channel size 8, 16 or 32).
+ * A 565 source (channel size 8 only) is a host endian 16 bit value.
+ */
+typedef void (*ConvertRowFunc)(uint8 *dst, const void *src, int n);
+
+enum {
+	CONVERT_ARGB,		/* A R G B bytes */
+	CONVERT_BGRA,		/* B G R A bytes */
+	CONVERT_RGBA,		/* R G B A bytes */
+	CONVERT_RGB,		/* R G B bytes */
+	CONVERT_BGR,		/* B G R bytes */
+	CONVERT_RGB565,		/* big endian 16 bit */
+	CONVERT_FORMATS
+};
+
+/* the kernel for a channel size of 8, 16 or 32 and a CONVERT_* format, or NULL */
+extern ConvertRowFunc getConvertRow(int channelSize, int format);
+
+/* "avx2", "ssse3", "neon" or "scalar", chosen for the host CPU on first use */
+extern const char *getConvertRowVariant(void);
+/* use another variant; false if not supported */
+extern bool setConvertRowVariant(const char *name);
+
+#endif /* OSMESA_CONVERT_H */
@@ -0,0 +1,173 @@
+/*
+ * osmesa_thread.cpp - NFOSMesa rendering threads
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "SDL_compat.h"
+#include <SDL_thread.h>
+
+#include "cpu_emulation.h"
+#include "parameters.h"
+#include "nfosmesa.h"
+#include "osmesa_context.h"
+#include "osmesa_thread.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#ifdef NFOSMESA_SUPPORT
+
+OSMesaThread::OSMesaThread(OSMesaDriver *drv, uint32_t context) :
+	driver(drv),
+	ctx(context),
+	thread(NULL),
+	running(false),
+	current(false),
+	release(false),
+	quit(false),
+	synced(true)
+{
+	lock = SDL_CreateMutex();
+	workCond = SDL_CreateCond();
+	doneCond = SDL_CreateCond();
+}
+
+/*
+ * Batches not run yet are thrown away; the context is about to go.
+ */
+OSMesaThread::~OSMesaThread()
+{
+	if (thread)
+	{
+		SDL_LockMutex(lock);
+		quit = true;
+		SDL_CondSignal(workCond);
+		SDL_UnlockMutex(lock);
+		SDL_WaitThread(thread, NULL);
+	}
+	SDL_DestroyCond(doneCond);
+	SDL_DestroyCond(workCond);
+	SDL_DestroyMutex(lock);
+}
+
+bool OSMesaThread::start()
+{
+	if (lock == NULL || workCond == NULL || doneCond == NULL)
+		return false;
+	thread = SDL_CreateNamedThread(threadFunc, "NFOSMesa", this);
+	return thread != NULL;
+}
+
+
+int OSMesaThread::threadFunc(void *arg)
+{
+	((OSMesaThread *)arg)->run();
+	return 0;
+}
+
+void OSMesaThread::run()
+{
+	OffscreenContext *context = driver->contexts[ctx].ctx;
+	std::vector<uint32_t> batch;
+
+	SDL_LockMutex(lock);
+	for (;;)
+	{
+		if (quit)
+			queue.clear();
+		if (!queue.empty())
+		{
+			batch.swap(queue.front());
+			queue.pop_front();
+			running = true;
+			// submit() may be waiting for room
+			SDL_CondBroadcast(doneCond);
+			bool make_current = !current;
+			SDL_UnlockMutex(lock);
+
+			bool ok = !make_current || context->MakeCurrent();
+			if (ok) {
+				driver->runBatch(batch, ctx);
+			} else {
+				D(bug("nfosmesa: context %u can not be made current on its thread", ctx));
+			}
+
+			SDL_LockMutex(lock);
+			current = ok;
+			running = false;
+			continue;
+		}
+		if (current && (release || quit))
+		{
+			SDL_UnlockMutex(lock);
+			context->ClearCurrent();
+			SDL_LockMutex(lock);
+			current = false;
+			continue;
+		}
+		if (quit)
+			break;
+		SDL_CondBroadcast(doneCond);
+		SDL_CondWait(workCond, lock);
+	}
+	SDL_UnlockMutex(lock);
+}
+
+
+/*
+ * Queue a batch; commands is left empty.
+ */
+void OSMesaThread::submit(std::vector<uint32_t> &commands)
+{
+	SDL_LockMutex(lock);
+	while (queue.size() >= MAX_QUEUED)
+		SDL_CondWait(doneCond, lock);
+	queue.push_back(std::vector<uint32_t>());
+	queue.back().swap(commands);
+	SDL_CondSignal(workCond);
+	SDL_UnlockMutex(lock);
+	synced = false;
+}
+
+/*
+ * Wait until everything submitted ran, and the context
+ * may be made current on the CPU thread again.
+ */
+void OSMesaThread::sync()
+{
+	if (synced)
+		return;
+	SDL_LockMutex(lock);
+	release = true;
+	SDL_CondSignal(workCond);
+	while (!queue.empty() || running || current)
+		SDL_CondWait(doneCond, lock);
+	release = false;
+	SDL_UnlockMutex(lock);
+	synced = true;
+}
+
+#endif /* NFOSMESA_SUPPORT */
+
+/*
+vim:ts=4:sw=4:
+*/
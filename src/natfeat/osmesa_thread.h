@@ -0,0 +1,81 @@
+/*
+ * osmesa_thread.h - NFOSMesa rendering threads - declaration
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef OSMESA_THREAD_H
+#define OSMESA_THREAD_H
+
+#include <deque>
+#include <vector>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+class OSMesaDriver;
+
+/*
+ * Runs the batches of GL calls of one context on a thread of its own,
+ * while the guest goes on.
+ *
+ * Only batches that OSMesaDriver::isAsync() accepts may be submitted:
+ * their calls neither return a value nor touch guest memory. While
+ * the thread has work the context is current on it, and must not be
+ * used on the CPU thread; sync() waits until all batches ran and the
+ * thread has let go of the context.
+ *
+ * submit() and sync() are called on the CPU thread only.
+ */
+class OSMesaThread
+{
+	// the number of batches queued before submit() waits
+	static const unsigned int MAX_QUEUED = 16;
+
+	OSMesaDriver *driver;
+	uint32_t ctx;
+	SDL_Thread *thread;
+	SDL_mutex *lock;
+	SDL_cond *workCond;
+	SDL_cond *doneCond;
+
+	// guarded by lock
+	std::deque<std::vector<uint32_t> > queue;
+	bool running;       // a batch is being run
+	bool current;       // the context is current on the thread
+	bool release;       // sync() waits for the context
+	bool quit;
+
+	// used by the CPU thread only
+	bool synced;
+
+	static int threadFunc(void *arg);
+	void run();
+
+  public:
+	OSMesaThread(OSMesaDriver *drv, uint32_t context);
+	~OSMesaThread();
+	bool start();
+
+	void submit(std::vector<uint32_t> &commands);
+	void sync();
+};
+
+#endif /* OSMESA_THREAD_H */
@@ -25,6 +25,7 @@
 #include <cassert>
 #include "cpu_emulation.h"
 #include "xhdi.h"
+#include "nf_async.h"
 #include "atari_rootsec.h"
 #include "tools.h"
 #include <errno.h>
@@ -191,17 +192,90 @@ int32 XHDIDriver::XHInqDriver(uint16 bios_device, memptr name, memptr version,
 }
 
 
+/*
+ * Seek and transfer whole blocks between the disk and a host buffer.
+ * Doesn't touch the guest, so that it can run on an async worker.
+ */
+int32 XHDIDriver::transfer(disk_t *disk, bool writing, off_t offset, uint8 *hostbuf, uint32 bytes)
+{
+	FILE *f = disk->file;
+	if (fseeko(f, offset, SEEK_SET) != 0)
+		return errnoHost2Mint(errno, TOS_EINVAL);
+	if (bytes == 0)
+		return writing ? TOS_EACCDN : TOS_E_OK;
+
+	if (writing)
+	{
+		uint8 *src = hostbuf;
+		uint8 *tempbuf = NULL;
+		if (! disk->byteswap)
+		{
+			// malloc()ed memory is aligned enough for USE_SSE_BYTESWAP
+			tempbuf = (uint8 *)malloc(bytes);
+			if (tempbuf == NULL)
+				return TOS_ENSMEM;
+			memcpy(tempbuf, src, bytes);
+			byteSwapBuf(tempbuf, bytes);
+			src = tempbuf;
+		}
+		size_t written = fwrite(src, bytes, 1, f);
+		free(tempbuf);
+		if (written != 1) {
+			panicbug("nfXHDI: Error writing to device %s (record=%d)", disk->path, (int)(offset / XHDI_BLOCK_SIZE));
+			return TOS_EWRITF;
+		}
+	} else {
+		if (fread(hostbuf, bytes, 1, f) != 1) {
+			panicbug("nfXHDI: error reading device %s (record=%d)", disk->path, (int)(offset / XHDI_BLOCK_SIZE));
+			return TOS_EREADF;
+		} else
+		{
+			if (! disk->byteswap)
+				byteSwapBuf(hostbuf, bytes);
+		}
+	}
+	return TOS_E_OK;
+}
+
+/*
+ * XHReadWrite() done by a worker thread; the disk is its channel,
+ * so that the transfers of a disk don't interleave on its FILE.
+ */
+class XHDIDriver::AsyncIO : public NFAsyncJob
+{
+	XHDIDriver *xhdi;
+	disk_t *disk;
+	bool writing;
+	off_t offset;
+	uint8 *hostbuf;
+	uint32 bytes;
+
+  public:
+	AsyncIO(XHDIDriver *_xhdi, disk_t *_disk, bool _writing, off_t _offset, uint8 *_hostbuf, uint32 _bytes)
+		: NFAsyncJob(_disk), xhdi(_xhdi), disk(_disk), writing(_writing),
+		  offset(_offset), hostbuf(_hostbuf), bytes(_bytes)
+	{
+	}
+
+	int32 run()
+	{
+		return xhdi->transfer(disk, writing, offset, hostbuf, bytes);
+	}
+};
+
 int32 XHDIDriver::XHReadWrite(uint16 major, uint16 minor,
-					uint16 rwflag, uint32 recno, uint16 count, memptr buf)
+					uint16 rwflag, uint32 recno, uint16 count, memptr buf, bool async)
 {
-	D(bug("ARAnyM XH%s(%u.%u, recno=%lu, count=%u, buf=$%x)",
-		(rwflag & 1) ? "Write" : "Read",
+	D(bug("ARAnyM XH%s%s(%u.%u, recno=%lu, count=%u, buf=$%x)",
+		(rwflag & 1) ? "Write" : "Read", async ? "Async" : "",
 		major, minor, recno, count, buf));
 
 	disk_t *disk = dev2disk(major, minor);
 	if (disk == NULL) {
 		return TOS_EUNDEV;
 	}
+	if (!async)
+		drainAsync(disk);
 
 	bool writing = (rwflag & 1);
 	if (writing && disk->readonly) {
@@ -224,6 +298,9 @@ int32 XHDIDriver::XHReadWrite(uint16 major, uint16 minor,
 
 	if (disk->sim_root) {
 		if (recno == 0 && count > 0) {
+			// the simulated root sector is written to the guest right away
+			if (async)
+				return TOS_ENOSYS;
 			if (!writing) {
 				// simulate the root sector
 				assert(sizeof(rootsector) == XHDI_BLOCK_SIZE);
@@ -274,52 +351,25 @@ int32 XHDIDriver::XHReadWrite(uint16 major, uint16 minor,
 	}
 
 	off_t offset = (off_t)recno * XHDI_BLOCK_SIZE;
-	if (fseeko(f, offset, SEEK_SET) != 0)
-		return errnoHost2Mint(errno, TOS_EINVAL);
-	if (count == 0)
-		return writing ? TOS_EACCDN : TOS_E_OK;
-	
 	memptr bytes = count * XHDI_BLOCK_SIZE;
-	if (writing)
-	{
-#ifdef USE_SSE_BYTESWAP
-		__attribute__((__aligned__(16))
-#endif
-		uint8 tempbuf[bytes];
-
-		memptr src_end = buf + bytes - 1;
-		if (! ValidAtariAddr(buf, false, 1))
-			BUS_ERROR(buf);
-		if (! ValidAtariAddr(src_end, false, 1))
-			BUS_ERROR(src_end);
-		uint8 *src = Atari2HostAddr(buf);
-		if (! disk->byteswap)
-		{
-			memcpy(tempbuf, src, bytes);
-			byteSwapBuf(tempbuf, bytes);
-			src = tempbuf;
-		}
-		if (fwrite(src, bytes, 1, f) != 1) {
-			panicbug("nfXHDI: Error writing to device %u.%u (record=%d)", major, minor, recno);
-			return TOS_EWRITF;
-		}
-	} else {
-		memptr dst_end = buf + bytes - 1;
-		if (! ValidAtariAddr(buf, true, 1))
-			BUS_ERROR(buf);
-		if (! ValidAtariAddr(dst_end, true, 1))
-			BUS_ERROR(dst_end);
-		uint8 *dst = Atari2HostAddr(buf);
-		if (fread(dst, bytes, 1, f) != 1) {
-			panicbug("nfXHDI: error reading device %u.%u (record=%d)", major, minor, recno);
-			return TOS_EREADF;
-		} else
-		{
-			if (! disk->byteswap)
-				byteSwapBuf(dst, bytes);
-		}
+
+	if (async) {
+		// the worker can't check guest addresses or raise bus errors
+		uint8 *hostbuf = Atari2HostBlock(buf, bytes, !writing);
+		if (hostbuf == NULL || bytes == 0)
+			return TOS_ENOSYS;
+		return submitAsync(new AsyncIO(this, disk, writing, offset, hostbuf, bytes));
 	}
-	return TOS_E_OK;
+
+	if (bytes == 0)
+		return transfer(disk, writing, offset, NULL, 0);
+
+	memptr buf_end = buf + bytes - 1;
+	if (! ValidAtariAddr(buf, !writing, 1))
+		BUS_ERROR(buf);
+	if (! ValidAtariAddr(buf_end, !writing, 1))
+		BUS_ERROR(buf_end);
+	return transfer(disk, writing, offset, Atari2HostAddr(buf), bytes);
 }
 
 int32 XHDIDriver::XHInqTarget2(uint16 major, uint16 minor, lmemptr blocksize,
@@ -430,7 +480,19 @@ int32 XHDIDriver::dispatch(uint32 fncode)
 						getParameter(2), /* UWORD rwflag */
 						getParameter(3), /* ULONG recno */
 						getParameter(4), /* UWORD count */
-						getParameter(5)  /* void *buf */
+						getParameter(5), /* void *buf */
+						false
+						);
+				break;
+
+		case XHDI_ASYNC(10): ret = XHReadWrite(
+						getParameter(0), /* UWORD major */
+						getParameter(1), /* UWORD minor */
+						getParameter(2), /* UWORD rwflag */
+						getParameter(3), /* ULONG recno */
+						getParameter(4), /* UWORD count */
+						getParameter(5), /* void *buf */
+						true
 						);
 				break;
 
@@ -33,6 +33,12 @@
 #define IDE_START	16
 #define IDE_END		17
 
+/*
+ * An XHDI function number plus this returns an NF_ASYNC ticket
+ * instead of the result; only XHReadWrite (10) can be called so.
+ */
+#define XHDI_ASYNC(fn)	(0x100 + (fn))
+
 typedef memptr wmemptr;
 typedef memptr lmemptr;
 
@@ -62,12 +68,15 @@ private:
 	void init_disks(void);
 	void close_disks(void);
 
+	class AsyncIO;
+	int32 transfer(disk_t *disk, bool writing, off_t offset, uint8 *hostbuf, uint32 bytes);
+
 protected:
 	int32 XHDrvMap();
 	int32 XHInqDriver(uint16 bios_device, memptr name, memptr version,
 				memptr company, wmemptr ahdi_version, wmemptr maxIPL);
 	int32 XHReadWrite(uint16 major, uint16 minor, uint16 rwflag,
-				uint32 recno, uint16 count, memptr buf);
+				uint32 recno, uint16 count, memptr buf, bool async);
 	int32 XHInqTarget2(uint16 major, uint16 minor, lmemptr blocksize,
 				lmemptr device_flags, memptr product_name, uint16 stringlen);
 	int32 XHInqDev2(uint16 bios_device, wmemptr major, wmemptr minor,
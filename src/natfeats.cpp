@@ -9,6 +9,7 @@
 #include "natfeats.h"
 #include "nf_objs.h"
 #include "maptab.h"
+#include "nftrace.h"
 #ifdef OS_darwin
 #include <CoreFoundation/CoreFoundation.h>
 #endif
@@ -63,6 +64,8 @@ int32 nf_call(memptr stack, bool inSuper)
 		THROW(8);	// privilege exception
 	}
 
+	if (nftrace_flags | nftrace_dump_request)
+		return NFTraceCall(obj, idx, fncode);
 	return obj->dispatch(fncode);
 }
 
@@ -74,6 +77,17 @@ uint32 nf_getparameter(int i)
 	return ReadInt32(context + i*4);
 }
 
+/*
+ * For NatFeats that run a list of their own calls, like FVDI_BATCH,
+ * from one call of the guest.
+ */
+memptr nf_setparameters(memptr params)
+{
+	memptr old = context;
+	context = params;
+	return old;
+}
+
 
 void Atari2HostUtf8Copy(char *dst, memptr src, size_t count)
 {
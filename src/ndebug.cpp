@@ -53,6 +53,7 @@ extern "C" int vasprintf(char **, const char *, va_list);
 
 #include "parameters.h"
 #include "main.h"	/* QuitEmulator */
+#include "nftrace.h"
 
 
 #ifndef HAVE_STRDUP
@@ -154,11 +155,13 @@ static const char *strhelp[] = {"Help:\n",
 	" v X <addr> <value>   step forward until (<address>) = <value> (X=b,w,l)\n",
 	" V X <address>        step forward until (<address>) changed (X=b,w,l)\n",
 	" B <address>          toggle breakpoint on <address>\n",
+	" n [t|r]              dump NatFeat call statistics (t: toggle, r: reset)\n",
 #ifdef FULL_HISTORY
 	" H <lines>            show history of PC\n",
 #endif
 #ifdef FULLMMU
 	" u                    dump the MMU translation tables and state\n",
+	" U [r]                show MMU ATC statistics (r: and reset them)\n",
 #endif
 	NULL
 };
@@ -435,10 +438,10 @@ void ndebug::set_Sx(char **inl) {
 				(void) r;
 				break;
 			case 1:
-				regs.srp = readhex(inl);
+				mmu_set_srp(readhex(inl));
 				break;
 			case 2:
-				regs.urp = readhex(inl);
+				mmu_set_urp(readhex(inl));
 				break;
 			case 3:
 				regs.dtt0 = readhex(inl);
@@ -963,7 +966,24 @@ int ndebug::canon(FILE *f, uaecptr nextpc, uaecptr &nxdis, uaecptr &nxmem) {
 		case 'u':
 			mmu_dump_tables();
 			break;
+		case 'U':
+			mmu_dump_atc_stats(more_params(&inptr) && next_char(&inptr) == 'r');
+			break;
 #endif
+		case 'n':
+			if (more_params(&inptr)) {
+				switch (next_char(&inptr)) {
+					case 't':
+						NFTraceEnable(!(nftrace_flags & NFTRACE_ON));
+						bug("NatFeat statistics %s", (nftrace_flags & NFTRACE_ON) ? "on" : "off");
+						break;
+					case 'r':
+						NFTraceReset();
+						break;
+				}
+			} else
+				NFTraceDump(stderr);
+			break;
 		case 'q':
 			tp = 0;
 			break;
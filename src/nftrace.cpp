@@ -0,0 +1,277 @@
+/*
+ * nftrace.cpp - NatFeat call statistics and trace
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "parameters.h"
+#include "nftrace.h"
+#include "nf_objs.h"
+#include "SDL_compat.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <csignal>
+#ifdef HAVE_CLOCK_GETTIME
+# include <time.h>
+#elif defined(HAVE_GETTIMEOFDAY)
+# include <sys/time.h>
+#endif
+
+/* latency buckets: bucket i counts calls of 2^i to 2^(i+1)-1 ns */
+#define NUM_BUCKETS	32
+
+struct nfstat_t {
+	uint64 calls;
+	uint64 total;		/* ns */
+	uint64 max;			/* ns */
+	uint32 buckets[NUM_BUCKETS];
+};
+
+/* key: NatFeat index << 32 | function code */
+typedef std::map<uint64, nfstat_t> nfstats_t;
+
+/*
+ * A record of the trace file, in host byte order, after a header of
+ * "ARANFTR1", the uint32 number of NatFeats and their names, each as
+ * one length byte plus the characters.
+ */
+struct nftrace_record_t {
+	uint64 start;		/* ns since the trace was opened */
+	uint32 duration;	/* ns */
+	uint16 nf;			/* index of the NatFeat name */
+	uint16 reserved;
+	uint32 fncode;
+	int32 result;
+};
+
+volatile int nftrace_flags;
+volatile sig_atomic_t nftrace_dump_request;
+
+static nfstats_t stats;
+static FILE *trace_file;
+static uint64 trace_base;
+static uint64 collect_start;
+
+static uint64 now_ns(void)
+{
+#if defined(HAVE_CLOCK_GETTIME)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#elif defined(HAVE_GETTIMEOFDAY)
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64)tv.tv_sec * 1000000000 + (uint64)tv.tv_usec * 1000;
+#else
+	return (uint64)SDL_GetTicks() * 1000000;
+#endif
+}
+
+static int bucket_of(uint64 ns)
+{
+	int b = 0;
+	while (ns > 1 && b < NUM_BUCKETS - 1) {
+		ns >>= 1;
+		b++;
+	}
+	return b;
+}
+
+static void format_ns(char *buf, size_t size, uint64 ns)
+{
+	if (ns < 10000)
+		snprintf(buf, size, "%uns", (unsigned int)ns);
+	else if (ns < 10000000)
+		snprintf(buf, size, "%uus", (unsigned int)(ns / 1000));
+	else
+		snprintf(buf, size, "%ums", (unsigned int)(ns / 1000000));
+}
+
+static const char *nf_name(unsigned int idx)
+{
+	return idx < nf_objs_cnt ? nf_objects[idx]->name() : "?";
+}
+
+#ifdef SIGUSR1
+static void dump_signal(int /* sig */)
+{
+	nftrace_dump_request = 1;
+}
+#endif
+
+static void open_trace(const char *filename)
+{
+	trace_file = fopen(filename, "wb");
+	if (trace_file == NULL) {
+		panicbug("NatFeat trace: can't write %s", filename);
+		return;
+	}
+
+	fwrite("ARANFTR1", 8, 1, trace_file);
+	uint32 count = nf_objs_cnt;
+	fwrite(&count, sizeof(count), 1, trace_file);
+	for (unsigned int i = 0; i < nf_objs_cnt; i++) {
+		const char *name = nf_objects[i]->name();
+		uint8 len = (uint8)std::min(strlen(name), (size_t)255);
+		fwrite(&len, 1, 1, trace_file);
+		fwrite(name, len, 1, trace_file);
+	}
+	trace_base = now_ns();
+	infoprint("Tracing NatFeat calls to %s", filename);
+}
+
+/*
+ * The NatFeats must have been created before.
+ */
+bool NFTraceInit(void)
+{
+#ifdef SIGUSR1
+	signal(SIGUSR1, dump_signal);
+#endif
+	if (bx_options.nftrace.tracefile[0] != '\0')
+		open_trace(bx_options.nftrace.tracefile);
+	NFTraceEnable(bx_options.nftrace.enabled || trace_file != NULL);
+	return true;
+}
+
+void NFTraceExit(void)
+{
+#ifdef SIGUSR1
+	signal(SIGUSR1, SIG_DFL);
+#endif
+	if (!stats.empty()) {
+		const char *filename = bx_options.nftrace.output;
+		FILE *f = filename[0] ? fopen(filename, "w") : stderr;
+		if (f != NULL) {
+			NFTraceDump(f);
+			if (f != stderr) {
+				fclose(f);
+				infoprint("NatFeat statistics written to %s", filename);
+			}
+		}
+	}
+	if (trace_file != NULL) {
+		fclose(trace_file);
+		trace_file = NULL;
+	}
+	nftrace_flags = 0;
+	nftrace_dump_request = 0;
+	stats.clear();
+}
+
+void NFTraceEnable(bool enable)
+{
+	if (enable) {
+		if (!(nftrace_flags & NFTRACE_ON))
+			collect_start = now_ns();
+		nftrace_flags |= NFTRACE_ON;
+	} else {
+		nftrace_flags &= ~NFTRACE_ON;
+	}
+}
+
+void NFTraceReset(void)
+{
+	stats.clear();
+	collect_start = now_ns();
+}
+
+static bool by_total(const nfstats_t::value_type *a, const nfstats_t::value_type *b)
+{
+	return a->second.total > b->second.total;
+}
+
+/*
+ * Most expensive first; the histogram lists the non-empty
+ * buckets by their upper bound.
+ */
+void NFTraceDump(FILE *f)
+{
+	std::vector<const nfstats_t::value_type *> sorted;
+	uint64 calls = 0, total = 0;
+	for (nfstats_t::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+		sorted.push_back(&*it);
+		calls += it->second.calls;
+		total += it->second.total;
+	}
+	std::sort(sorted.begin(), sorted.end(), by_total);
+
+	fprintf(f, "# %llu NatFeat calls, %.3f ms host time in %.3f s%s\n",
+		(unsigned long long)calls, total / 1e6, (now_ns() - collect_start) / 1e9,
+		(nftrace_flags & NFTRACE_ON) ? "" : " (collection off)");
+	fprintf(f, "# %-16s %6s %10s %12s %9s %9s  histogram\n",
+		"natfeat", "fn", "calls", "total ms", "avg us", "max us");
+	for (size_t i = 0; i < sorted.size(); i++) {
+		uint64 key = sorted[i]->first;
+		const nfstat_t &s = sorted[i]->second;
+		fprintf(f, "%-18s %6u %10llu %12.3f %9.1f %9.1f ",
+			nf_name((unsigned int)(key >> 32)), (uint32)key, (unsigned long long)s.calls,
+			s.total / 1e6, s.total / 1e3 / s.calls, s.max / 1e3);
+		for (int b = 0; b < NUM_BUCKETS; b++) {
+			if (s.buckets[b] == 0)
+				continue;
+			char limit[16];
+			format_ns(limit, sizeof(limit), ((uint64)2 << b) - 1);
+			fprintf(f, " <%s:%u", limit, s.buckets[b]);
+		}
+		fprintf(f, "\n");
+	}
+	fflush(f);
+}
+
+int32 NFTraceCall(NF_Base *obj, unsigned int idx, uint32 fncode)
+{
+	if (nftrace_dump_request) {
+		nftrace_dump_request = 0;
+		NFTraceDump(stderr);
+	}
+	if (!(nftrace_flags & NFTRACE_ON))
+		return obj->dispatch(fncode);
+
+	uint64 start = now_ns();
+	int32 ret = obj->dispatch(fncode);
+	uint64 duration = now_ns() - start;
+
+	nfstat_t &s = stats[((uint64)idx << 32) | fncode];
+	s.calls++;
+	s.total += duration;
+	if (duration > s.max)
+		s.max = duration;
+	s.buckets[bucket_of(duration)]++;
+
+	if (trace_file != NULL) {
+		nftrace_record_t rec;
+		rec.start = start - trace_base;
+		rec.duration = duration > 0xffffffffULL ? 0xffffffff : (uint32)duration;
+		rec.nf = idx;
+		rec.reserved = 0;
+		rec.fncode = fncode;
+		rec.result = ret;
+		fwrite(&rec, sizeof(rec), 1, trace_file);
+	}
+
+	return ret;
+}
@@ -975,6 +975,7 @@ static void presave_disk()
 
 struct Config_Tag arafs_conf[]={
 	{ "symlinks", String_Tag, &bx_options.aranymfs.symlinks, sizeof(bx_options.aranymfs.symlinks), 0},
+	{ "Buffered", Bool_Tag, &bx_options.aranymfs.buffered, 0, 0},
 	HOSTFS_ENTRY("A", 0),
 	HOSTFS_ENTRY("B", 1),
 	HOSTFS_ENTRY("C", 2),
@@ -1013,6 +1014,7 @@ struct Config_Tag arafs_conf[]={
 static void preset_arafs()
 {
 	strcpy(bx_options.aranymfs.symlinks, "posix");
+	bx_options.aranymfs.buffered = false;
 	for(int i=0; i < HOSTFS_MAX_DRIVES; i++) {
 		bx_options.aranymfs.drive[i].rootPath[0] = '\0';
 		bx_options.aranymfs.drive[i].configPath[0] = '\0';
@@ -1252,6 +1254,8 @@ struct Config_Tag osmesa_conf[]={
 	{ "ChannelSize", Int_Tag, &OSMESA_CONF(channel_size), 0, 0},
 	{ "LibGL", String_Tag, &OSMESA_CONF(libgl), sizeof(OSMESA_CONF(libgl)), 0},
 	{ "LibOSMesa", String_Tag, &OSMESA_CONF(libosmesa), sizeof(OSMESA_CONF(libosmesa)), 0},
+	{ "DirectRender", Bool_Tag, &OSMESA_CONF(direct_render), 0, 0},
+	{ "Threaded", Bool_Tag, &OSMESA_CONF(threaded), 0, 0},
 	{ NULL , Error_Tag, NULL, 0, 0 }
 };
 
@@ -1259,6 +1263,8 @@ static void preset_osmesa() {
 	OSMESA_CONF(channel_size) = 0;
 	safe_strncpy(OSMESA_CONF(libgl), DEFAULT_OPENGL, sizeof(OSMESA_CONF(libgl)));
 	safe_strncpy(OSMESA_CONF(libosmesa), DEFAULT_OSMESA, sizeof(OSMESA_CONF(libosmesa)));
+	OSMESA_CONF(direct_render) = true;
+	OSMESA_CONF(threaded) = false;
 }
 
 static void postload_osmesa() {
@@ -1267,6 +1273,54 @@ static void postload_osmesa() {
 static void presave_osmesa() {
 }
 
+/*************************************************************************/
+#define PROFILER_CONF(x) bx_options.profiler.x
+
+struct Config_Tag profiler_conf[]={
+	{ "Enabled", Bool_Tag, &PROFILER_CONF(enabled), 0, 0},
+	{ "Rate", Int_Tag, &PROFILER_CONF(rate), 0, 0},
+	{ "Output", Path_Tag, PROFILER_CONF(output), sizeof(PROFILER_CONF(output)), 0},
+	{ "Format", String_Tag, PROFILER_CONF(format), sizeof(PROFILER_CONF(format)), 0},
+	{ "Symbols", Path_Tag, PROFILER_CONF(symbols), sizeof(PROFILER_CONF(symbols)), 0},
+	{ NULL , Error_Tag, NULL, 0, 0 }
+};
+
+static void preset_profiler() {
+	PROFILER_CONF(enabled) = false;
+	PROFILER_CONF(rate) = 1000;
+	safe_strncpy(PROFILER_CONF(output), "aranym.prof", sizeof(PROFILER_CONF(output)));
+	safe_strncpy(PROFILER_CONF(format), "collapsed", sizeof(PROFILER_CONF(format)));
+	PROFILER_CONF(symbols)[0] = '\0';
+}
+
+static void postload_profiler() {
+}
+
+static void presave_profiler() {
+}
+
+/*************************************************************************/
+#define NFTRACE_CONF(x) bx_options.nftrace.x
+
+struct Config_Tag nftrace_conf[]={
+	{ "Enabled", Bool_Tag, &NFTRACE_CONF(enabled), 0, 0},
+	{ "Output", Path_Tag, NFTRACE_CONF(output), sizeof(NFTRACE_CONF(output)), 0},
+	{ "TraceFile", Path_Tag, NFTRACE_CONF(tracefile), sizeof(NFTRACE_CONF(tracefile)), 0},
+	{ NULL , Error_Tag, NULL, 0, 0 }
+};
+
+static void preset_nftrace() {
+	NFTRACE_CONF(enabled) = false;
+	NFTRACE_CONF(output)[0] = '\0';
+	NFTRACE_CONF(tracefile)[0] = '\0';
+}
+
+static void postload_nftrace() {
+}
+
+static void presave_nftrace() {
+}
+
 /*************************************************************************/
 #define PARALLEL_CONF(x) bx_options.parallel.x
 
@@ -1321,6 +1375,7 @@ struct Config_Tag natfeat_conf[]={
 	{ "CDROM", String_Tag, &NATFEAT_CONF(cdrom_driver), sizeof(NATFEAT_CONF(cdrom_driver)), 0},
 	{ "Vdi", String_Tag, &NATFEAT_CONF(vdi_driver), sizeof(NATFEAT_CONF(vdi_driver)), 0},
 	{ "HOSTEXEC", Bool_Tag, &NATFEAT_CONF(hostexec_enabled), 0, 0},
+	{ "RingDir", Path_Tag, NATFEAT_CONF(ring_dir), sizeof(NATFEAT_CONF(ring_dir)), 0},
 	{ NULL , Error_Tag, NULL, 0, 0 }
 };
 
@@ -1328,6 +1383,7 @@ static void preset_natfeat() {
   safe_strncpy(NATFEAT_CONF(cdrom_driver), "sdl", sizeof(NATFEAT_CONF(cdrom_driver)));
   safe_strncpy(NATFEAT_CONF(vdi_driver), "soft", sizeof(NATFEAT_CONF(vdi_driver)));
   NATFEAT_CONF(hostexec_enabled) = false;
+  NATFEAT_CONF(ring_dir)[0] = '\0';
 }
 
 static void postload_natfeat()
@@ -1345,11 +1401,13 @@ static void presave_natfeat() {
 
 struct Config_Tag nfvdi_conf[]={
 	{ "UseHostMouseCursor", Bool_Tag,  &NFVDI_CONF(use_host_mouse_cursor), 0, 0},
+	{ "BlitCache", Int_Tag,  &NFVDI_CONF(blit_cache), 0, 0},
 	{ NULL , Error_Tag, NULL, 0, 0 }
 };
 
 static void preset_nfvdi() {
 	NFVDI_CONF(use_host_mouse_cursor) = false;
+	NFVDI_CONF(blit_cache) = 0;
 }
 
 static void postload_nfvdi() {
@@ -1611,6 +1669,8 @@ static struct Config_Section const all_sections[] = {
 	{ "[NFVDI]",      nfvdi_conf,    false, preset_nfvdi, postload_nfvdi, presave_nfvdi },
 	{ "[AUDIO]",      audio_conf,    false, preset_audio, postload_audio, presave_audio },
 	{ "[JOYSTICKS]",  joysticks_conf,false, preset_joysticks, postload_joysticks, presave_joysticks },
+	{ "[PROFILER]",   profiler_conf, false, preset_profiler, postload_profiler, presave_profiler },
+	{ "[NFTRACE]",    nftrace_conf, false, preset_nftrace, postload_nftrace, presave_nftrace },
 	{ "[USERCONF]",   user_conf,     false, 0, 0, 0 },
 	{ "cmdline",      cmdline_conf,  false, 0, 0, 0 },
 	{ 0, 0, false, 0, 0, 0 }
@@ -0,0 +1,215 @@
+/*
+ * profiler.cpp - sampling profiler for guest code
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "sysdeps.h"
+#include "cpu_emulation.h"
+#include "parameters.h"
+#include "profiler.h"
+#include "SDL_compat.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Histogram key: guest PC plus the state the CPU was in;
+ * bit 32 is the supervisor bit, bit 33 is set while STOPped.
+ */
+#define KEY_SUPER	(1ULL << 32)
+#define KEY_STOPPED	(1ULL << 33)
+
+typedef std::map<uint64, uint32> histogram_t;
+typedef std::map<uaecptr, std::string> symbols_t;
+
+static histogram_t histogram;
+static symbols_t symbols;
+static uint32 total_samples;
+static SDL_TimerID profiler_timer;
+
+static Uint32 profiler_callback(Uint32 interval, void * /* param */)
+{
+	SPCFLAGS_SET( SPCFLAG_PROFILE );
+	return interval;
+}
+
+/*
+ * The symbol file is in the output format of nm,
+ * e.g. "m68k-atari-mint-nm -n mint040.prg > mint.sym",
+ * with addresses already relocated to where the program runs.
+ */
+static void load_symbols(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if (f == NULL) {
+		panicbug("Profiler: can't open symbol file %s", filename);
+		return;
+	}
+
+	char line[1024];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		unsigned long addr;
+		char type;
+		char name[sizeof(line)];
+
+		if (sscanf(line, "%lx %c %1023s", &addr, &type, name) != 3)
+			continue;
+		/* only code symbols */
+		if (type != 't' && type != 'T' && type != 'w' && type != 'W')
+			continue;
+		symbols[(uaecptr)addr] = name;
+	}
+	fclose(f);
+	D(bug("Profiler: %u symbols loaded from %s", (unsigned int)symbols.size(), filename));
+}
+
+static std::string symbolize(uaecptr pc)
+{
+	char buf[32];
+
+	symbols_t::const_iterator it = symbols.upper_bound(pc);
+	if (it != symbols.begin()) {
+		--it;
+		return it->second;
+	}
+	snprintf(buf, sizeof(buf), "0x%08x", pc);
+	return buf;
+}
+
+static const char *mode_name(uint64 key)
+{
+	if (key & KEY_STOPPED)
+		return "stop";
+	return (key & KEY_SUPER) ? "super" : "user";
+}
+
+/*
+ * Folded stacks, one line per "mode;symbol", as understood by
+ * flamegraph.pl, speedscope and pprof's collapsed importer.
+ */
+static void write_collapsed(FILE *f)
+{
+	std::map<std::string, uint32> folded;
+
+	for (histogram_t::const_iterator it = histogram.begin(); it != histogram.end(); ++it) {
+		std::string frame = mode_name(it->first);
+		frame += ";";
+		frame += symbolize((uaecptr)it->first);
+		folded[frame] += it->second;
+	}
+	for (std::map<std::string, uint32>::const_iterator it = folded.begin(); it != folded.end(); ++it)
+		fprintf(f, "%s %u\n", it->first.c_str(), it->second);
+}
+
+static bool by_count(const std::pair<uint64, uint32> &a, const std::pair<uint64, uint32> &b)
+{
+	return a.second > b.second;
+}
+
+/*
+ * Human readable per-address histogram, most frequent first.
+ */
+static void write_histogram(FILE *f)
+{
+	std::vector<std::pair<uint64, uint32> > sorted(histogram.begin(), histogram.end());
+	std::sort(sorted.begin(), sorted.end(), by_count);
+
+	fprintf(f, "# %u samples at %d Hz\n", total_samples, bx_options.profiler.rate);
+	fprintf(f, "#  samples      %%  mode   address   symbol\n");
+	for (size_t i = 0; i < sorted.size(); i++) {
+		uaecptr pc = (uaecptr)sorted[i].first;
+		std::string sym = symbolize(pc);
+		symbols_t::const_iterator it = symbols.upper_bound(pc);
+
+		fprintf(f, "%10u %6.2f  %-5s  %08x  %s", sorted[i].second,
+			sorted[i].second * 100.0 / total_samples, mode_name(sorted[i].first), pc, sym.c_str());
+		if (it != symbols.begin()) {
+			--it;
+			fprintf(f, "+0x%x", pc - it->first);
+		}
+		fprintf(f, "\n");
+	}
+}
+
+bool ProfilerInit(void)
+{
+	if (!bx_options.profiler.enabled)
+		return true;
+
+	int rate = bx_options.profiler.rate;
+	if (rate < 1 || rate > 1000) {
+		panicbug("Profiler: sample rate %d Hz out of range 1-1000", rate);
+		return false;
+	}
+	if (bx_options.profiler.symbols[0] != '\0')
+		load_symbols(bx_options.profiler.symbols);
+
+	histogram.clear();
+	total_samples = 0;
+	profiler_timer = SDL_AddTimer(1000 / rate, profiler_callback, NULL);
+	if (profiler_timer == 0) {
+		panicbug("Profiler: can't create timer: %s", SDL_GetError());
+		return false;
+	}
+	infoprint("Profiling guest code at %d Hz", rate);
+	return true;
+}
+
+void ProfilerExit(void)
+{
+	if (profiler_timer == 0)
+		return;
+	SDL_RemoveTimer(profiler_timer);
+	profiler_timer = (SDL_TimerID)0;
+	SPCFLAGS_CLEAR( SPCFLAG_PROFILE );
+
+	const char *filename = bx_options.profiler.output;
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) {
+		panicbug("Profiler: can't write %s", filename);
+		return;
+	}
+	if (strcasecmp(bx_options.profiler.format, "histogram") == 0)
+		write_histogram(f);
+	else
+		write_collapsed(f);
+	fclose(f);
+	infoprint("Profiler: %u samples written to %s", total_samples, filename);
+
+	histogram.clear();
+	symbols.clear();
+}
+
+void ProfilerSample(uaecptr pc, bool super, bool stopped)
+{
+	uint64 key = pc;
+	if (super)
+		key |= KEY_SUPER;
+	if (stopped)
+		key |= KEY_STOPPED;
+	histogram[key]++;
+	total_samples++;
+}
@@ -141,6 +141,8 @@ static inline bool ValidAddr(memptr addr, bool write, uint32 len) { return valid
 
 // Helper functions for usual memory operations
 static inline uint8 *Atari2HostAddr(memptr addr) {return phys_get_real_address(addr);}
+// Host address of len bytes of ST-RAM, FastRAM or VideoRAM, or NULL; checked in all builds
+static inline uint8 *Atari2HostBlock(memptr addr, uint32 len, bool write) {return phys_get_real_block(addr, len, write);}
 
 
 // From newcpu.cpp
@@ -37,15 +37,47 @@
 #define DBG_MMU_VERBOSE	1
 #define DBG_MMU_SANITY	1
 
+/*
+ * The atc counters shown by the debugger's 'U' command sit on the
+ * hot path of every translation, so they are only kept on request.
+ */
+#ifndef MMU_ATC_STATS
+#define MMU_ATC_STATS	DEBUG
+#endif
+#if MMU_ATC_STATS
+#define ATC_STAT(x)		(atc_stats.x++)
+#else
+#define ATC_STAT(x)		((void)0)
+#endif
+
 #ifdef FULLMMU
 
 mmu_atc_l1_array atc_l1[2];
 mmu_atc_l1_array *current_atc;
-struct mmu_atc_line atc_l2[2][ATC_L2_SIZE];
+struct mmu_atc_l2_line atc_l2[2][ATC_L2_SETS][ATC_L2_WAYS];
+struct mmu_atc_stats atc_stats;
+
+/*
+ * Second level lines are valid if they were filled after the last flush
+ * affecting them: atc_gen_global is bumped by PFLUSHA, atc_gen_local also by
+ * PFLUSHAN. Non global lines must further belong to the current root pointer
+ * context and be newer than the context itself.
+ */
+static uae_u32 atc_epoch = 1;
+static uae_u32 atc_gen_global = 1;
+static uae_u32 atc_gen_local = 1;
+
+struct mmu_atc_context {
+	uae_u32 root;
+	uae_u32 gen;		/* 0 if unused */
+	uae_u32 last_used;
+};
+
+static struct mmu_atc_context atc_ctx[2][ATC_CONTEXTS];
+static uae_u8 atc_cur_ctx[2];
+static uae_u32 atc_ctx_clock;
 
-# ifdef ATC_STATS
-static unsigned int mmu_atc_hits[ATC_L2_SIZE];
-# endif
+static void mmu_atc_l2_wipe(void);
 
 
 static void mmu_dump_ttr(const char * label, uae_u32 ttr)
@@ -260,17 +292,53 @@ static void mmu_dump_table(const char * label, uaecptr root_ptr)
 /* {{{ mmu_dump_atc */
 void mmu_dump_atc(void)
 {
+	int i, j, k;
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < ATC_L2_SETS; j++) {
+			for (k = 0; k < ATC_L2_WAYS; k++) {
+				struct mmu_atc_l2_line *e = &atc_l2[i][j][k];
+				if (e->line.tag == 0x8000 || e->gen == 0)
+					continue;
+				D(bug("ATC[%02d.%d] G=%d TT=%d M=%d WP=%d VD=%d VI=%d tag=%08x ctx=%d gen=%u --> phys=%08x",
+					j, k, e->line.global, e->line.tt, e->line.modified,
+					e->line.write_protect, e->line.valid_data, e->line.valid_inst,
+					e->line.tag, e->ctx, e->gen, e->line.phys));
+			}
+		}
+	}
+}
+/* }}} */
+
+/* {{{ mmu_dump_atc_stats */
+void mmu_dump_atc_stats(bool reset)
+{
+	uae_u64 lookups = atc_stats.l2_hits + atc_stats.l2_misses;
 	int i, j;
+
+	bug("ATC: L1 %d x 4 lines, L2 %d sets x %d ways, %d contexts",
+		ATC_L1_SIZE, ATC_L2_SETS, ATC_L2_WAYS, ATC_CONTEXTS);
+#if !MMU_ATC_STATS
+	bug("ATC: counters not compiled in, build with MMU_ATC_STATS=1");
+#endif
+	bug("ATC: L1 misses: %llu (L1 hits are not counted)",
+		(unsigned long long)atc_stats.l1_misses);
+	bug("ATC: L2 hits: %llu  misses (table walks): %llu  hit rate: %.2f%%",
+		(unsigned long long)atc_stats.l2_hits, (unsigned long long)atc_stats.l2_misses,
+		lookups ? atc_stats.l2_hits * 100.0 / lookups : 0.0);
+	bug("ATC: page flushes: %llu  full flushes: %llu",
+		(unsigned long long)atc_stats.flushes, (unsigned long long)atc_stats.flushes_all);
+	bug("ATC: root pointer switches: %llu  found in atc: %llu",
+		(unsigned long long)atc_stats.root_switches, (unsigned long long)atc_stats.root_reuses);
 	for (i = 0; i < 2; i++) {
-		for (j = 0; j < ATC_L2_SIZE; j++) {
-			if (atc_l2[i][j].tag == 0x8000)
+		for (j = 0; j < ATC_CONTEXTS; j++) {
+			if (atc_ctx[i][j].gen == 0)
 				continue;
-			D(bug("ATC[%02d] G=%d TT=%d M=%d WP=%d VD=%d VI=%d tag=%08x --> phys=%08x",
-				j, atc_l2[i][j].global, atc_l2[i][j].tt, atc_l2[i][j].modified,
-				atc_l2[i][j].write_protect, atc_l2[i][j].valid_data, atc_l2[i][j].valid_inst,
-				atc_l2[i][j].tag, atc_l2[i][j].phys));
+			bug("ATC: %s context %d: root=%08x%s", i ? "super" : "user", j,
+				atc_ctx[i][j].root, j == atc_cur_ctx[i] ? " (current)" : "");
 		}
 	}
+	if (reset)
+		memset(&atc_stats, 0, sizeof(atc_stats));
 }
 /* }}} */
 
@@ -324,6 +392,146 @@ static void mmu_bus_error(uaecptr addr, int fc, int write, int size)
 	THROW(2);
 }
 
+/*
+ * Start a new flush generation. On the (very unlikely) wrap around
+ * all lines are invalidated the hard way.
+ */
+static uae_u32 mmu_atc_new_generation(void)
+{
+	if (unlikely(++atc_epoch == 0))
+		mmu_atc_l2_wipe();
+	return atc_epoch;
+}
+
+static ALWAYS_INLINE bool mmu_atc_l2_valid(const struct mmu_atc_l2_line *e, int super)
+{
+	if (e->line.global)
+		return e->gen >= atc_gen_global;
+	return e->ctx == atc_cur_ctx[super] && e->gen >= atc_gen_local &&
+		e->gen >= atc_ctx[super][e->ctx].gen;
+}
+
+/*
+ * Find the line for an address in the second level atc, moving it to the
+ * front of its set.
+ */
+static struct mmu_atc_line *mmu_atc_l2_lookup(uaecptr addr, int super)
+{
+	struct mmu_atc_l2_line *set = atc_l2[super][ATC_L2_INDEX(addr)];
+	uae_u16 tag = ATC_TAG(addr);
+	int i;
+
+	for (i = 0; i < ATC_L2_WAYS; i++) {
+		if (set[i].line.tag == tag && mmu_atc_l2_valid(&set[i], super)) {
+			if (i > 0) {
+				struct mmu_atc_l2_line hit = set[i];
+				memmove(&set[1], &set[0], i * sizeof(*set));
+				set[0] = hit;
+			}
+			ATC_STAT(l2_hits);
+			return &set[0].line;
+		}
+	}
+	ATC_STAT(l2_misses);
+	return NULL;
+}
+
+/*
+ * Allocate a line for an address in the second level atc, replacing
+ * the least recently used line of its set. The caller fills it.
+ */
+static struct mmu_atc_line *mmu_atc_l2_alloc(uaecptr addr, int super)
+{
+	struct mmu_atc_l2_line *set = atc_l2[super][ATC_L2_INDEX(addr)];
+
+	memmove(&set[1], &set[0], (ATC_L2_WAYS - 1) * sizeof(*set));
+	set[0].line.tag = 0x8000;
+	set[0].gen = atc_epoch;
+	set[0].ctx = atc_cur_ctx[super];
+	return &set[0].line;
+}
+
+static struct mmu_atc_line *mmu_atc_l2_get(uaecptr addr, int super)
+{
+	struct mmu_atc_line *l = mmu_atc_l2_lookup(addr, super);
+
+	if (l == NULL)
+		l = mmu_atc_l2_alloc(addr, super);
+	return l;
+}
+
+static void mmu_atc_l2_flush(uaecptr addr, int super, bool global)
+{
+	struct mmu_atc_l2_line *set = atc_l2[super][ATC_L2_INDEX(addr)];
+	uae_u16 tag = ATC_TAG(addr);
+	int i;
+
+	/* entries of other contexts are flushed, too */
+	for (i = 0; i < ATC_L2_WAYS; i++) {
+		if (set[i].line.tag == tag && (global || !set[i].line.global))
+			set[i].line.tag = 0x8000;
+	}
+}
+
+static void mmu_atc_l2_wipe(void)
+{
+	struct mmu_atc_l2_line *e = atc_l2[0][0];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(atc_l2) / sizeof(*e); e++, i++) {
+		e->line.tag = 0x8000;
+		e->gen = 0;
+	}
+	for (i = 0; i < 2; i++)
+		memset(atc_ctx[i], 0, sizeof(atc_ctx[i]));
+	atc_epoch = atc_gen_global = atc_gen_local = 1;
+	atc_ctx_clock = 0;
+	atc_ctx[0][atc_cur_ctx[0]].root = regs.urp;
+	atc_ctx[0][atc_cur_ctx[0]].gen = 1;
+	atc_ctx[1][atc_cur_ctx[1]].root = regs.srp;
+	atc_ctx[1][atc_cur_ctx[1]].gen = 1;
+}
+
+static void mmu_flush_atc_l1(int super)
+{
+	struct mmu_atc_line *l = atc_l1[super][0][0];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(atc_l1[super]) / sizeof(*l); l++, i++)
+		l->tag = 0x8000;
+}
+
+/*
+ * Switch the atc to the context of the current URP or SRP. A root pointer
+ * seen recently gets its old lines back, unless they have been flushed
+ * meanwhile; otherwise the least recently used context is recycled.
+ */
+static void mmu_select_context(int super)
+{
+	uae_u32 root = super ? regs.srp : regs.urp;
+	struct mmu_atc_context *c = atc_ctx[super];
+	int i, victim = 0;
+
+	ATC_STAT(root_switches);
+	for (i = 0; i < ATC_CONTEXTS; i++) {
+		if (c[i].gen != 0 && c[i].root == root) {
+			ATC_STAT(root_reuses);
+			victim = i;
+			goto found;
+		}
+		if (c[i].last_used < c[victim].last_used)
+			victim = i;
+	}
+	c[victim].root = root;
+	c[victim].gen = mmu_atc_new_generation();
+found:
+	c[victim].last_used = ++atc_ctx_clock;
+	atc_cur_ctx[super] = victim;
+
+	/* the first level atc isn't tagged */
+	mmu_flush_atc_l1(super);
+}
+
 /*
  * Update the atc line for a given address by doing a mmu lookup.
  */
@@ -400,12 +608,13 @@ static ALWAYS_INLINE bool
 mmu_fill_atc_l1(uaecptr addr, int super, int data, int write,
 				struct mmu_atc_line *l1)
 {
-	int idx = ATC_L2_INDEX(addr);
-	int tag = ATC_TAG(addr);
-	struct mmu_atc_line *l = &atc_l2[super][idx];
+	struct mmu_atc_line *l;
 	uaecptr phys_addr;
 
-	if (l->tag != tag) {
+	ATC_STAT(l1_misses);
+	l = mmu_atc_l2_lookup(addr, super);
+	if (l == NULL) {
+		l = mmu_atc_l2_alloc(addr, super);
 	restart:
 		mmu_fill_atc_l2(addr, super, data, write, l);
 	}
@@ -450,7 +659,7 @@ uaecptr mmu_translate(uaecptr addr, int super, int data, int write)
 {
 	struct mmu_atc_line *l;
 
-	l = &atc_l2[super][ATC_L2_INDEX(addr)];
+	l = mmu_atc_l2_get(addr, super);
 	mmu_fill_atc_l2(addr, super, data, write, l);
 	if (!(data ? l->valid_data : l->valid_inst))
 	{
@@ -540,9 +749,58 @@ static uaecptr REGPARAM2 mmu_lookup_pagetable(uaecptr addr, int super, int write
 	return desc;
 }
 
+/*
+ * Fast path for accesses crossing a page: if both pages are in the level 1
+ * atc, access the two host pages directly, without setting up the fault
+ * handling of the split access.
+ */
+static ALWAYS_INLINE bool mmu_get_crossing(uaecptr addr, int size, int data, uae_u32 *val)
+{
+	struct mmu_atc_line *cl1, *cl2;
+	uaecptr addr2 = (addr + size - 1) & ~0xfff;
+	uae_u8 *p1, *p2;
+	uae_u32 res = 0;
+	int i, n;
+
+	if (!mmu_lookup(addr, data, 0, &cl1) || !mmu_lookup(addr2, data, 0, &cl2))
+		return false;
+	p1 = mmu_get_real_address(addr, cl1);
+	p2 = mmu_get_real_address(addr2, cl2);
+	n = addr2 - addr;
+	for (i = 0; i < n; i++)
+		res = (res << 8) | do_get_mem_byte(p1 + i);
+	for (; i < size; i++)
+		res = (res << 8) | do_get_mem_byte(p2 + i - n);
+	*val = res;
+	return true;
+}
+
+static ALWAYS_INLINE bool mmu_put_crossing(uaecptr addr, uae_u32 val, int size, int data)
+{
+	struct mmu_atc_line *cl1, *cl2;
+	uaecptr addr2 = (addr + size - 1) & ~0xfff;
+	uae_u8 *p1, *p2;
+	int i, n;
+
+	if (!mmu_lookup(addr, data, 1, &cl1) || !mmu_lookup(addr2, data, 1, &cl2))
+		return false;
+	p1 = mmu_get_real_address(addr, cl1);
+	p2 = mmu_get_real_address(addr2, cl2);
+	n = addr2 - addr;
+	for (i = 0; i < n; i++)
+		do_put_mem_byte(p1 + i, val >> ((size - 1 - i) * 8));
+	for (; i < size; i++)
+		do_put_mem_byte(p2 + i - n, val >> ((size - 1 - i) * 8));
+	return true;
+}
+
 uae_u16 mmu_get_word_unaligned(uaecptr addr, int data)
 {
 	uae_u16 res;
+	uae_u32 val;
+
+	if (likely(mmu_get_crossing(addr, 2, data, &val)))
+		return val;
 
 	res = (uae_u16)mmu_get_byte(addr, data, sz_word) << 8;
 	SAVE_EXCEPTION;
@@ -564,6 +822,9 @@ uae_u32 mmu_get_long_unaligned(uaecptr addr, int data)
 {
 	uae_u32 res;
 
+	if (likely(mmu_get_crossing(addr, 4, data, &res)))
+		return res;
+
 	if (likely(!(addr & 1))) {
 		res = (uae_u32)mmu_get_word(addr, data, sz_long) << 16;
 		SAVE_EXCEPTION;
@@ -666,6 +927,9 @@ uae_u64 mmu_get_quad_slow(uaecptr addr, int super, int data,
 
 REGPARAM2 void mmu_put_long_unaligned(uaecptr addr, uae_u32 val, int data)
 {
+	if (likely(mmu_put_crossing(addr, val, 4, data)))
+		return;
+
 	SAVE_EXCEPTION;
 	TRY(prb) {
 		if (likely(!(addr & 1))) {
@@ -693,6 +957,9 @@ REGPARAM2 void mmu_put_long_unaligned(uaecptr addr, uae_u32 val, int data)
 
 REGPARAM2 void mmu_put_word_unaligned(uaecptr addr, uae_u16 val, int data)
 {
+	if (likely(mmu_put_crossing(addr, val, 2, data)))
+		return;
+
 	SAVE_EXCEPTION;
 	TRY(prb) {
 		mmu_put_byte(addr, val >> 8, data, sz_word);
@@ -977,7 +1244,7 @@ void mmu_op(uae_u32 opcode, uae_u16 extra)
 			uae_u32 desc;
 			bool data = (regs.dfc & 3) != 2;
 
-			l = &atc_l2[super][ATC_L2_INDEX(addr)];
+			l = mmu_atc_l2_get(addr, super);
 			desc = mmu_fill_atc_l2(addr, super, data, write, l);
 			if (!(data ? l->valid_data : l->valid_inst))
 				regs.mmusr = MMU_MMUSR_B;
@@ -1018,15 +1285,10 @@ void mmu_flush_atc(uaecptr addr, bool super, bool global)
 			l += ATC_L1_SIZE;
 		}
 	}
-	l = atc_l2[super];
-	i = ATC_L2_INDEX(addr);
-	if (global || !l[i].global)
-		l[i].tag = 0x8000;
-	if (regs.mmu_pagesize_8k) {
-		i ^= 1;
-		if (global || !l[i].global)
-			l[i].tag = 0x8000;
-	}
+	mmu_atc_l2_flush(addr, super, global);
+	if (regs.mmu_pagesize_8k)
+		mmu_atc_l2_flush(addr ^ 0x1000, super, global);
+	ATC_STAT(flushes);
 }
 
 void mmu_flush_atc_all(bool global)
@@ -1040,11 +1302,10 @@ void mmu_flush_atc_all(bool global)
 			l->tag = 0x8000;
 	}
 
-	l = atc_l2[0];
-	for (i = 0; i < sizeof(atc_l2) / sizeof(*l); l++, i++) {
-		if (global || !l->global)
-			l->tag = 0x8000;
-	}
+	atc_gen_local = mmu_atc_new_generation();
+	if (global)
+		atc_gen_global = atc_gen_local;
+	ATC_STAT(flushes_all);
 }
 
 void mmu_reset(void)
@@ -1055,6 +1316,27 @@ void mmu_reset(void)
 	regs.itt0 = regs.itt1 = 0;
 	regs.dtt0 = regs.dtt1 = 0;
 	regs.mmusr = 0;
+
+	memset(atc_ctx, 0, sizeof(atc_ctx));
+	atc_ctx_clock = 0;
+	mmu_select_context(0);
+	mmu_select_context(1);
+}
+
+void mmu_set_urp(uae_u32 val)
+{
+	if (regs.urp == val)
+		return;
+	regs.urp = val;
+	mmu_select_context(0);
+}
+
+void mmu_set_srp(uae_u32 val)
+{
+	if (regs.srp == val)
+		return;
+	regs.srp = val;
+	mmu_select_context(1);
 }
 
 
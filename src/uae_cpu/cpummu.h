@@ -147,12 +147,64 @@ typedef struct mmu_atc_line mmu_atc_l1_array[2][2][ATC_L1_SIZE];
 extern mmu_atc_l1_array atc_l1[2];
 extern mmu_atc_l1_array *current_atc;
 
+/*
+ * second level atc cache, set associative with ATC_L2_WAYS lines per set,
+ * most recently used line first. Both values can be set at configure time.
+ * Lines are tagged with the root pointer they were translated with, and with
+ * the flush generation they were filled in, so switching URP/SRP and PFLUSHA
+ * don't need to touch the whole cache.
+ */
+#ifndef ATC_L2_SIZE_LOG
 #define ATC_L2_SIZE_LOG		12
+#endif
+#ifndef ATC_L2_WAYS
+#define ATC_L2_WAYS			4
+#endif
 #define ATC_L2_SIZE			(1 << ATC_L2_SIZE_LOG)
 
-#define ATC_L2_INDEX(addr)	((((addr) >> 12) ^ ((addr) >> (32 - ATC_L2_SIZE_LOG))) % ATC_L2_SIZE)
+#if ATC_L2_WAYS == 1
+#define ATC_L2_WAYS_LOG		0
+#elif ATC_L2_WAYS == 2
+#define ATC_L2_WAYS_LOG		1
+#elif ATC_L2_WAYS == 4
+#define ATC_L2_WAYS_LOG		2
+#else
+#error "ATC_L2_WAYS must be 1, 2 or 4"
+#endif
+
+#define ATC_L2_SETS_LOG		(ATC_L2_SIZE_LOG - ATC_L2_WAYS_LOG)
+#define ATC_L2_SETS			(1 << ATC_L2_SETS_LOG)
+
+/* the index must hold the address bits 12-17 not covered by the tag */
+#if ATC_L2_SETS_LOG < 6 || ATC_L2_SETS_LOG > 14
+#error "ATC_L2_SIZE_LOG - log2(ATC_L2_WAYS) must be in the range 6..14"
+#endif
+
+#define ATC_L2_INDEX(addr)	((((addr) >> 12) ^ ((addr) >> (32 - ATC_L2_SETS_LOG))) % ATC_L2_SETS)
+
+/* number of root pointers per URP/SRP remembered in the atc */
+#define ATC_CONTEXTS		8
+
+struct mmu_atc_l2_line {
+	struct mmu_atc_line line;
+	uae_u32 gen;			/* flush generation when filled */
+	uae_u8 ctx;				/* root pointer context */
+};
 
-extern struct mmu_atc_line atc_l2[2][ATC_L2_SIZE];
+extern struct mmu_atc_l2_line atc_l2[2][ATC_L2_SETS][ATC_L2_WAYS];
+
+struct mmu_atc_stats {
+	uae_u64 l1_misses;
+	uae_u64 l2_hits;
+	uae_u64 l2_misses;		/* page table walks */
+	uae_u64 flushes;		/* PFLUSH of a single page */
+	uae_u64 flushes_all;	/* PFLUSHA, PFLUSHAN, TC changes */
+	uae_u64 root_switches;	/* URP/SRP changes */
+	uae_u64 root_reuses;	/* ... that found the root pointer in the atc */
+};
+
+extern struct mmu_atc_stats atc_stats;
+extern void mmu_dump_atc_stats(bool reset);
 
 /*
  * lookup address in the level 1 atc cache,
@@ -222,6 +274,21 @@ static inline void mmu_set_mmusr(uae_u32 val)
 	regs.mmusr = val;
 }
 
+#ifdef FULLMMU
+extern void REGPARAM2 mmu_set_urp(uae_u32 val);
+extern void REGPARAM2 mmu_set_srp(uae_u32 val);
+#else
+static inline void mmu_set_urp(uae_u32 val)
+{
+	regs.urp = val;
+}
+
+static inline void mmu_set_srp(uae_u32 val)
+{
+	regs.srp = val;
+}
+#endif
+
 #define FC_DATA		(regs.s ? 5 : 1)
 #define FC_INST		(regs.s ? 6 : 2)
 
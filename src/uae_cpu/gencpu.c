@@ -628,21 +628,33 @@ static void genmovemel (uae_u16 opcode)
 {
     char getcode1[100];
     char getcode2[100];
+    char blkcode[100];
     int size = table68k[opcode].size == sz_long ? 4 : 2;
 	
     if (table68k[opcode].size == sz_long) {
 		strcpy (getcode1, "");
 		strcpy (getcode2, "get_long(srca)");
+		strcpy (blkcode, "do_get_mem_long((uae_u32 *)blk)");
     } else {
 		strcpy (getcode1, "(uae_s32)(uae_s16)");
 		strcpy (getcode2, "get_word(srca)");
+		strcpy (blkcode, "do_get_mem_word((uae_u16 *)blk)");
     }
 
     printf ("\tuae_u16 mask = %s;\n", gen_nextiword ());
     printf ("\tunsigned int dmask = mask & 0xff, amask = (mask >> 8) & 0xff;\n");
     genamode (table68k[opcode].dmode, "dstreg", table68k[opcode].size, "src", GENA_GETV_FETCH_ALIGN, GENA_MOVEM_NO_INC, XLATE_LOG);
     start_brace ();
-    printf("\n#ifdef FULLMMU\n");
+    /* the whole register list in one go, if it's plain RAM */
+    printf ("\tuae_u8 *blk = get_real_block(srca, (movem_count[dmask] + movem_count[amask]) * %d, 0);\n", size);
+    printf ("\tif (blk) {\n");
+    printf ("\t\tsrca += (movem_count[dmask] + movem_count[amask]) * %d;\n", size);
+    printf ("\t\twhile (dmask) { m68k_dreg(regs, movem_index1[dmask]) = %s%s; blk += %d; dmask = movem_next[dmask]; }\n",
+	    getcode1, blkcode, size);
+    printf ("\t\twhile (amask) { m68k_areg(regs, movem_index1[amask]) = %s%s; blk += %d; amask = movem_next[amask]; }\n",
+	    getcode1, blkcode, size);
+    printf ("\t} else {\n");
+    printf("#ifdef FULLMMU\n");
     printf ("\twhile (dmask) { m68k_dreg(regs, movem_index1[dmask]) = %s%s; srca += %d; dmask = movem_next[dmask]; }\n",
 	    getcode1, getcode2, size);
     printf ("\twhile (amask) { m68k_areg(regs, movem_index1[amask]) = %s%s; srca += %d; amask = movem_next[amask]; }\n",
@@ -653,6 +665,7 @@ static void genmovemel (uae_u16 opcode)
     printf ("\twhile (amask) { m68k_areg(regs, movem_index1[amask]) = %sphys_%s; srca += %d; amask = movem_next[amask]; }\n",
 	    getcode1, getcode2, size);
     printf("#endif\n");
+    printf ("\t}\n");
 
     if (table68k[opcode].dmode == Aipi)
 	printf ("\tm68k_areg(regs, dstreg) = srca;\n");
@@ -661,12 +674,15 @@ static void genmovemel (uae_u16 opcode)
 static void genmovemle (uae_u16 opcode)
 {
     char putcode[100];
+    char blkcode[100];
     int size = table68k[opcode].size == sz_long ? 4 : 2;
 
     if (table68k[opcode].size == sz_long) {
 	strcpy (putcode, "put_long(srca,");
+	strcpy (blkcode, "do_put_mem_long((uae_u32 *)blk,");
     } else {
 	strcpy (putcode, "put_word(srca,");
+	strcpy (blkcode, "do_put_mem_word((uae_u16 *)blk,");
     }
 
     printf ("\tuae_u16 mask = %s;\n", gen_nextiword ());
@@ -677,6 +693,16 @@ static void genmovemle (uae_u16 opcode)
     start_brace ();
     if (table68k[opcode].dmode == Apdi) {
 	printf ("\tuae_u16 amask = mask & 0xff, dmask = (mask >> 8) & 0xff;\n");
+	printf ("\tuae_u32 len = (movem_count[dmask] + movem_count[amask]) * %d;\n", size);
+	printf ("\tuae_u8 *blk = get_real_block(srca - len, len, 1);\n");
+	printf ("\tif (blk) {\n");
+	printf ("\t\tsrca -= len;\n");
+	printf ("\t\tblk += len;\n");
+	printf ("\t\twhile (amask) { blk -= %d; %s m68k_areg(regs, movem_index2[amask])); amask = movem_next[amask]; }\n",
+		size, blkcode);
+	printf ("\t\twhile (dmask) { blk -= %d; %s m68k_dreg(regs, movem_index2[dmask])); dmask = movem_next[dmask]; }\n",
+		size, blkcode);
+	printf ("\t} else {\n");
 	printf("#ifdef FULLMMU\n");
 	printf ("\twhile (amask) { srca -= %d; %s m68k_areg(regs, movem_index2[amask])); amask = movem_next[amask]; }\n",
 		size, putcode);
@@ -688,9 +714,17 @@ static void genmovemle (uae_u16 opcode)
 	printf ("\twhile (dmask) { srca -= %d; phys_%s m68k_dreg(regs, movem_index2[dmask])); dmask = movem_next[dmask]; }\n",
 		size, putcode);
 	printf("#endif\n");
+	printf ("\t}\n");
 	printf ("\tm68k_areg(regs, dstreg) = srca;\n");
     } else {
 	printf ("\tuae_u16 dmask = mask & 0xff, amask = (mask >> 8) & 0xff;\n");
+	printf ("\tuae_u8 *blk = get_real_block(srca, (movem_count[dmask] + movem_count[amask]) * %d, 1);\n", size);
+	printf ("\tif (blk) {\n");
+	printf ("\t\twhile (dmask) { %s m68k_dreg(regs, movem_index1[dmask])); blk += %d; dmask = movem_next[dmask]; }\n",
+		blkcode, size);
+	printf ("\t\twhile (amask) { %s m68k_areg(regs, movem_index1[amask])); blk += %d; amask = movem_next[amask]; }\n",
+		blkcode, size);
+	printf ("\t} else {\n");
 	printf("#ifdef FULLMMU\n");
 	printf ("\twhile (dmask) { %s m68k_dreg(regs, movem_index1[dmask])); srca += %d; dmask = movem_next[dmask]; }\n",
 		putcode, size);
@@ -702,9 +736,28 @@ static void genmovemle (uae_u16 opcode)
 	printf ("\twhile (amask) { phys_%s m68k_areg(regs, movem_index1[amask])); srca += %d; amask = movem_next[amask]; }\n",
 		putcode, size);
 	printf("#endif\n");
+	printf ("\t}\n");
     }
 }
 
+/*
+ * MOVE16 of an aligned line, which never crosses a page: a plain 16 byte
+ * host copy (a single vector load/store) if both lines are in RAM.
+ */
+static void genmove16 (const char *src, const char *dst)
+{
+    printf ("\tuae_u8 *m16s = get_real_block(%s, 16, 0);\n", src);
+    printf ("\tuae_u8 *m16d = m16s ? get_real_block(%s, 16, 1) : NULL;\n", dst);
+    printf ("\tif (m16d)\n");
+    printf ("\t\tmemcpy(m16d, m16s, 16);\n");
+    printf ("\telse {\n");
+    printf ("\tput_long(%s, get_long(%s));\n", dst, src);
+    printf ("\tput_long(%s+4, get_long(%s+4));\n", dst, src);
+    printf ("\tput_long(%s+8, get_long(%s+8));\n", dst, src);
+    printf ("\tput_long(%s+12, get_long(%s+12));\n", dst, src);
+    printf ("\t}\n");
+}
+
 static void duplicate_carry (void)
 {
     printf ("\tCOPY_CARRY();\n");
@@ -2384,10 +2437,7 @@ static void gen_opcode (unsigned long int opcode)
 	     printf ("\tuaecptr mems = m68k_areg(regs, srcreg) & ~15, memd;\n");
 	     printf ("\tdstreg = (%s >> 12) & 7;\n", gen_nextiword());
 	     printf ("\tmemd = m68k_areg(regs, dstreg) & ~15;\n");
-	     printf ("\tput_long(memd, get_long(mems));\n");
-	     printf ("\tput_long(memd+4, get_long(mems+4));\n");
-	     printf ("\tput_long(memd+8, get_long(mems+8));\n");
-	     printf ("\tput_long(memd+12, get_long(mems+12));\n");
+	     genmove16 ("mems", "memd");
 	     printf ("\tif (srcreg != dstreg)\n");
 	     printf ("\tm68k_areg(regs, srcreg) += 16;\n");
 	     printf ("\tm68k_areg(regs, dstreg) += 16;\n");
@@ -2397,10 +2447,7 @@ static void gen_opcode (unsigned long int opcode)
 	     genamode (curi->dmode, "dstreg", curi->size, "memd", GENA_GETV_NO_FETCH, GENA_MOVEM_MOVE16, XLATE_LOG);
 	     printf ("\tmemsa &= ~15;\n");
 	     printf ("\tmemda &= ~15;\n");
-	     printf ("\tput_long(memda, get_long(memsa));\n");
-	     printf ("\tput_long(memda+4, get_long(memsa+4));\n");
-	     printf ("\tput_long(memda+8, get_long(memsa+8));\n");
-	     printf ("\tput_long(memda+12, get_long(memsa+12));\n");
+	     genmove16 ("memsa", "memda");
 	     if ((opcode & 0xfff8) == 0xf600)
                  printf ("\tm68k_areg(regs, srcreg) += 16;\n");
 	     else if ((opcode & 0xfff8) == 0xf608)
@@ -188,6 +188,53 @@ static inline bool phys_valid_address(uaecptr addr, bool write, int sz)
 static inline bool phys_valid_address(uaecptr, bool, int) { return true; }
 #endif
 
+/*
+ * Whether len bytes at addr lie in ST-RAM, FastRAM or VideoRAM. Unlike
+ * test_ram_boundary() this holds for any length, and it is checked in
+ * the builds without memory checks (NOCHECKBOUNDARY) as well: the host
+ * pointers of phys_get_real_block() are used without further checks,
+ * some of them on other threads for as long as a guest ring or job
+ * lives.
+ */
+static ALWAYS_INLINE bool phys_block_in_ram(uaecptr addr, uae_u32 len, bool write)
+{
+	uae_u64 end = (uae_u64)addr + len;
+
+	// the first two longwords of ST-RAM shadow the ROM
+	if (addr >= (write ? 8U : 0U) && end <= STRAM_END)
+		return true;
+	if (addr >= FastRAM_BEGIN && end <= (uae_u64)FastRAM_BEGIN + FastRAM_SIZE)
+		return true;
+#ifdef FIXED_VIDEORAM
+	uae_u64 vram = ARANYMVRAMSTART;
+#else
+	uae_u64 vram = VideoRAMBase;
+#endif
+	return addr >= vram && end <= vram + ARANYMVRAMSIZE;
+}
+
+/*
+ * Host address of a block of len bytes if it is all plain RAM, so MOVEM
+ * and MOVE16 can transfer it in one go. Returns NULL if the block touches
+ * the hardware register window or is not accessible; the caller then uses
+ * single accesses, which handle both.
+ */
+static ALWAYS_INLINE uae_u8 *phys_get_real_block(uaecptr addr, uae_u32 len, bool write)
+{
+	uaecptr end = addr + len - 1;
+
+	if (unlikely(end < addr || end >= 0xff000000))
+		return NULL;
+	if (unlikely(addr <= 0x00ffffff && end >= 0x00f00000))
+		return NULL;
+	if (unlikely(!phys_block_in_ram(addr, len, write)))
+		return NULL;
+	// the start only, for the protection of the first 2k
+	if (unlikely(!phys_valid_address(addr, write, 1)))
+		return NULL;
+	return phys_get_real_address(addr);
+}
+
 static inline uae_u64 phys_get_quad(uaecptr addr)
 {
 #ifdef ARAM_PAGE_CHECK
@@ -497,6 +544,28 @@ static ALWAYS_INLINE void put_byte(uaecptr addr, uae_u8 val)
 	mmu_put_byte(addr, val, 1, sz_byte);
 }
 
+/*
+ * Translate a block of len bytes within one page with a single lookup,
+ * for MOVEM and MOVE16. Returns NULL unless the page is already in the
+ * level 1 atc; the caller then falls back to single accesses, which
+ * do the table search and raise the access fault if needed.
+ */
+static ALWAYS_INLINE uae_u8 *mmu_get_real_block(uaecptr addr, uae_u32 len, int data, int write)
+{
+	struct mmu_atc_line *cl;
+
+	if (unlikely((addr ^ (addr + len - 1)) & ~0xfff))
+		return NULL;
+	if (likely(mmu_lookup(addr, data, write, &cl)))
+		return mmu_get_real_address(addr, cl);
+	return NULL;
+}
+
+static ALWAYS_INLINE uae_u8 *get_real_block(uaecptr addr, uae_u32 len, int write)
+{
+	return mmu_get_real_block(addr, len, 1, write);
+}
+
 static inline uae_u8 *get_real_address(uaecptr addr, int write, int sz)
 {
 	(void)sz;
@@ -586,6 +655,7 @@ static inline bool valid_address(uaecptr addr, bool write, int sz)
 #  define put_word(a,b)			phys_put_word(a,b)
 #  define put_byte(a,b)			phys_put_byte(a,b)
 #  define get_real_address(a,w,s)	phys_get_real_address(a)
+#  define get_real_block(a,l,w)		phys_get_real_block(a,l,w)
 
 #define valid_address(a,w,s)		phys_valid_address(a,w,s)
 #endif
@@ -47,6 +47,7 @@
 #include "fpu/fpu.h"
 #include "natfeats.h"
 #include "disasm-glue.h"
+#include "profiler.h"
 
 #include <cstdlib>
 
@@ -82,6 +83,7 @@ int imm8_table[] = { 8,1,2,3,4,5,6,7 };
 int movem_index1[256];
 int movem_index2[256];
 int movem_next[256];
+int movem_count[256];
 
 #ifdef FLIGHT_RECORDER
 
@@ -223,6 +225,9 @@ void init_m68k (void)
 	movem_index1[i] = j;
 	movem_index2[i] = 7-j;
 	movem_next[i] = i & (~(1 << j));
+	movem_count[i] = 0;
+	for (j = 0 ; j < 8 ; j++)
+		movem_count[i] += (i >> j) & 1;
     }
     fpu_init (CPUType == 4);
 }
@@ -694,8 +699,8 @@ int m68k_move2c (int regno, uae_u32 *regp)
 	 case 0x803: regs.msp = *regp; if (regs.m == 1) m68k_areg(regs, 7) = regs.msp; break;
 	 case 0x804: regs.isp = *regp; if (regs.m == 0) m68k_areg(regs, 7) = regs.isp; break;
 	 case 0x805: mmu_set_mmusr(*regp); break;
-	 case 0x806: regs.urp = *regp & MMU_ROOT_PTR_ADDR_MASK; break;
-	 case 0x807: regs.srp = *regp & MMU_ROOT_PTR_ADDR_MASK; break;
+	 case 0x806: mmu_set_urp(*regp & MMU_ROOT_PTR_ADDR_MASK); break;
+	 case 0x807: mmu_set_srp(*regp & MMU_ROOT_PTR_ADDR_MASK); break;
 	 default:
 	    op_illg (0x4E7B);
 	    return 0;
@@ -1345,6 +1350,15 @@ static void do_trace (void)
 	}														\
 }
 
+#define SERVE_PROFILER()									\
+{															\
+	if (SPCFLAGS_TEST( SPCFLAG_PROFILE )) {					\
+		SPCFLAGS_CLEAR( SPCFLAG_PROFILE );					\
+		ProfilerSample(m68k_getpc(), regs.s,				\
+			SPCFLAGS_TEST( SPCFLAG_STOP ) != 0);			\
+	}														\
+}
+
 int m68k_do_specialties(void)
 {
 	SERVE_INTERNAL_IRQ();
@@ -1359,6 +1373,7 @@ int m68k_do_specialties(void)
 	if ((m68k_execute_depth == 0) && SPCFLAGS_TEST( SPCFLAG_JIT_EXEC_RETURN ))
 		SPCFLAGS_CLEAR( SPCFLAG_JIT_EXEC_RETURN );
 #endif
+	SERVE_PROFILER();
 	/*n_spcinsns++;*/
 	if (SPCFLAGS_TEST( SPCFLAG_DOTRACE )) {
 		Exception (9,last_trace_ad);
@@ -1390,6 +1405,7 @@ int m68k_do_specialties(void)
 		// give unused time slices back to OS
 		SleepAndWait();
 
+		SERVE_PROFILER();
 		SERVE_INTERNAL_IRQ();
 		SERVE_VBL_MFP(true);
 		if (SPCFLAGS_TEST( SPCFLAG_BRK ))
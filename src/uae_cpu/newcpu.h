@@ -53,6 +53,7 @@ extern int imm8_table[];
 extern int movem_index1[256];
 extern int movem_index2[256];
 extern int movem_next[256];
+extern int movem_count[256];
 
 extern int broken_in;
 
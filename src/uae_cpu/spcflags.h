@@ -27,6 +27,7 @@ enum {
 #endif
 	SPCFLAG_VBL			= 0x100,
 	SPCFLAG_MFP			= 0x200,
+	SPCFLAG_PROFILE		= 0x400,
 	SPCFLAG_INT3		= 0x800,
 	SPCFLAG_INT5		= 0x1000,
 	SPCFLAG_SCC		= 0x2000,
@@ -44,6 +45,7 @@ enum {
 					| SPCFLAG_INT5
 					| SPCFLAG_SCC
 					| SPCFLAG_MFP
+					| SPCFLAG_PROFILE
 					,
 
 	SPCFLAG_ALL_BUT_EXEC_RETURN	= SPCFLAG_ALL & ~SPCFLAG_JIT_EXEC_RETURN
@@ -0,0 +1,168 @@
+/*
+ * vdibench.cpp - benchmark of the fVDI monochrome expansion kernels
+ *
+ * Copyright (c) 2026 ARAnyM developer team (see AUTHORS)
+ *
+ * This file is part of the ARAnyM project which builds a new and powerful
+ * TOS/FreeMiNT compatible virtual machine running on almost any hardware.
+ *
+ * ARAnyM is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ARAnyM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ARAnyM; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Runs every kernel of natfeat/nfvdi_expand.cpp that the host CPU
+ * supports over rows of random bits, checks that the SIMD variants
+ * draw exactly what the scalar code does, and reports pixels/second:
+ *
+ *   vdibench                 all depths, modes and variants
+ *   vdibench -w 37 -r 100    odd widths exercise the scalar tails
+ */
+
+#include "sysdeps.h"
+#include "natfeat/nfvdi_expand.cpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <sys/time.h>
+#include <vector>
+
+static const char *variants[] = { "scalar", "sse2", "avx2" };
+#define NUM_VARIANTS ((int)(sizeof(variants) / sizeof(variants[0])))
+
+static const char *modes[] = { "replace", "trans", "xor", "erase" };
+
+static uint32 rng_state = 1;
+
+static uint32 rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/*
+ * The destination starts out as noise,
+ * so every mode has something to keep or invert.
+ */
+static void noise(std::vector<uint8> &dst)
+{
+	rng_state = 1;
+	for (size_t i = 0; i < dst.size(); i++)
+		dst[i] = rng();
+}
+
+static void run(ExpandRowFunc expandRow, int bpp, int width, int rows,
+	const std::vector<uint16> &bits, std::vector<uint8> &dst)
+{
+	int words = (width + 15) >> 4;
+	int pitch = width * bpp;
+	uint32 fg = 0x12345678, bg = 0x9abcdef0;
+
+	for (int j = 0; j < rows; j++)
+		expandRow(&dst[j * pitch], &bits[j * words], width, fg, bg);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: vdibench [options]\n"
+		"  -w width  pixels per row (default 640)\n"
+		"  -h rows   rows per pass (default 480)\n"
+		"  -r count  passes timed per kernel (default 50)\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int width = 640;
+	int rows = 480;
+	int repeat = 50;
+	int c;
+
+	while ((c = getopt(argc, argv, "w:h:r:")) != -1) {
+		switch (c) {
+		case 'w':
+			width = atoi(optarg);
+			break;
+		case 'h':
+			rows = atoi(optarg);
+			break;
+		case 'r':
+			repeat = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (width < 1 || rows < 1 || repeat < 1 || optind != argc)
+		usage();
+
+	printf("default variant: %s, %d x %d pixels x %d passes\n",
+		getExpandRowVariant(), width, rows, repeat);
+
+	int words = (width + 15) >> 4;
+	std::vector<uint16> bits(words * rows);
+	for (size_t i = 0; i < bits.size(); i++)
+		bits[i] = rng();
+
+	int failed = 0;
+	static const int depths[] = { 1, 2, 4 };
+	for (int d = 0; d < 3; d++) {
+		int bpp = depths[d];
+		std::vector<uint8> ref(width * rows * bpp);
+		std::vector<uint8> dst(ref.size());
+
+		for (int mode = 1; mode <= 4; mode++) {
+			setExpandRowVariant("scalar");
+			noise(ref);
+			run(getExpandRow(bpp, mode), bpp, width, rows, bits, ref);
+
+			for (int v = 0; v < NUM_VARIANTS; v++) {
+				if (!setExpandRowVariant(variants[v]))
+					continue;
+				ExpandRowFunc expandRow = getExpandRow(bpp, mode);
+
+				noise(dst);
+				run(expandRow, bpp, width, rows, bits, dst);
+				bool ok = dst == ref;
+				if (!ok)
+					failed++;
+
+				double elapsed = now();
+				for (int r = 0; r < repeat; r++)
+					run(expandRow, bpp, width, rows, bits, dst);
+				elapsed = now() - elapsed;
+
+				double pixels = (double)repeat * width * rows;
+				printf("%2d bit %-7s %-6s: ", bpp * 8, modes[mode - 1], variants[v]);
+				if (elapsed <= 0)
+					printf("below timer resolution");
+				else
+					printf("%8.1f Mpixels/s", pixels / elapsed / 1e6);
+				printf("%s\n", ok ? "" : "  MISMATCH");
+			}
+		}
+	}
+	return failed ? 1 : 0;
+}